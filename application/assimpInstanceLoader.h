@@ -2,9 +2,7 @@
 #include "../glframework/core.h"
 #include "../glframework/object.h"
 
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/postprocess.h"
+#include "meshCache.h"
 
 #include "../glframework/mesh/instancedMesh.h"
 #include "../glframework/texture.h"
@@ -12,33 +10,10 @@
 class AssimpInstanceLoader {
 public:
 
-	static Object* load(const std::string& path, int instanceCount);
+	// One simplified LOD per ratio of the triangles is generated for every mesh
+	static Object* load(const std::string& path, int instanceCount, const std::vector<float>& lodRatios = {});
 
 private:
 
-	static void processNode(
-		aiNode* ainode, 
-		Object* parent, 
-		const aiScene* scene, 
-		const std::string& rootPath,
-		int instanceCount
-		);
-
-	static InstancedMesh* processMesh(
-		aiMesh* aimesh, 
-		const aiScene* scene,
-		const std::string& rootPath,
-		int instanceCount
-		);
-	
-	static Texture* processTexture(
-		const aiMaterial* aimat,
-		const aiTextureType& type,
-		const aiScene* scene,
-		const std::string& rootPath
-	);
-
-
-	static glm::mat4 getMat4f(aiMatrix4x4 value);
-
+	static InstancedMesh* processMesh(const MeshCache& cache, uint32_t index, int instanceCount);
 };
\ No newline at end of file
@@ -2,9 +2,7 @@
 #include "../glframework/core.h"
 #include "../glframework/object.h"
 
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/postprocess.h"
+#include "meshCache.h"
 
 #include "../glframework/mesh/mesh.h"
 #include "../glframework/texture.h"
@@ -12,31 +10,10 @@
 class AssimpLoader {
 public:
 
-	static Object* load(const std::string& path);
+	// One simplified LOD per ratio of the triangles is generated for every mesh
+	static Object* load(const std::string& path, const std::vector<float>& lodRatios = {});
 
 private:
 
-	static void processNode(
-		aiNode* ainode, 
-		Object* parent, 
-		const aiScene* scene, 
-		const std::string& rootPath
-		);
-
-	static Mesh* processMesh(
-		aiMesh* aimesh, 
-		const aiScene* scene,
-		const std::string& rootPath
-		);
-	
-	static Texture* processTexture(
-		const aiMaterial* aimat,
-		const aiTextureType& type,
-		const aiScene* scene,
-		const std::string& rootPath
-	);
-
-
-	static glm::mat4 getMat4f(aiMatrix4x4 value);
-
+	static Mesh* processMesh(const MeshCache& cache, uint32_t index);
 };
\ No newline at end of file
@@ -0,0 +1,1033 @@
+#include "benchmark.h"
+#include "../../glframework/grass/grassField.h"
+#include "../../glframework/grass/grassFieldBuilder.h"
+#include "../../glframework/renderer/renderQueue.h"
+#include "../../glframework/transform/transformSystem.h"
+#include "../../glframework/tools/allocationCounter.h"
+#include "../../glframework/tools/meshOptimizer.h"
+#include "../../glframework/tools/mipmapGenerator.h"
+#include "../../glframework/tools/blockCompressor.h"
+#include "../../glframework/tools/textureAtlas.h"
+#include "../../glframework/culling/depthPyramid.h"
+#include "../../glframework/material/grassInstanceMaterial.h"
+#include "../stb_image.h"
+#include "../../glframework/object.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+
+bool Benchmark::run(const std::string& name) {
+
+	if (name == "grassField") {
+		grassField();
+	}
+	else if (name == "grassFieldBuilder") {
+		grassFieldBuilder();
+	}
+	else if (name == "renderQueue") {
+		renderQueue();
+	}
+	else if (name == "transformSystem") {
+		transformSystem();
+	}
+	else if (name == "sceneTraversal") {
+		sceneTraversal();
+	}
+	else if (name == "vertexCache") {
+		vertexCache();
+	}
+	else if (name == "textureFiltering") {
+		textureFiltering();
+	}
+	else if (name == "textureCompression") {
+		return textureCompression();
+	}
+	else if (name == "textureAtlas") {
+		textureAtlas();
+	}
+	else if (name == "occlusion") {
+		return occlusion();
+	}
+	else {
+		std::cout << "Error: Unknown benchmark " << name << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void Benchmark::grassField() {
+
+	// Same spacing as the demo field, side length grows with the blade count
+	const int sides[] = { 300, 1000, 2000, 3163 };
+	const float spacing = 0.2f;
+	const int frames = 240;
+
+	// grassNew.obj is not loaded without a context, use a blade sized box
+	const glm::vec3 bladeMin{ -0.1f, 0.0f, -0.1f };
+	const glm::vec3 bladeMax{ 0.1f, 0.6f, 0.1f };
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	std::printf("%10s %8s %12s %12s %10s %10s\n", "blades", "chunks", "drawn/frame", "culled/frame", "cull ms", "build ms");
+
+	for (int side : sides) {
+
+		std::vector<glm::mat4> matrices;
+		GrassFieldBuilder(side, side, spacing).generate(matrices);
+
+		GrassField field(16.0f);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		field.build(matrices, bladeMin, bladeMax);
+		auto end = std::chrono::high_resolution_clock::now();
+		float buildTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+		// Walk along the field edge looking across it
+		float extent = side * spacing;
+		double drawn = 0.0, culled = 0.0, cullTime = 0.0;
+
+		for (int i = 0; i < frames; i++) {
+
+			float t = (float)i / (frames - 1);
+			glm::vec3 eye{ extent * t, 1.7f, -1.0f };
+			glm::vec3 target = eye + glm::vec3(0.5f, -0.2f, 1.0f);
+			glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+			field.cull(projection * view, 0.1f);
+
+			const GrassCullStats& stats = field.getStats();
+			drawn += stats.mDrawnInstances;
+			culled += stats.mCulledInstances;
+			cullTime += stats.mCullTime;
+		}
+
+		std::printf("%10zu %8zu %12.0f %12.0f %10.4f %10.1f\n",
+			matrices.size(),
+			field.getChunks().size(),
+			drawn / frames,
+			culled / frames,
+			cullTime / frames,
+			buildTime);
+	}
+}
+
+void Benchmark::grassFieldBuilder() {
+
+	const int sides[] = { 1000, 2000, 3163, 4000 };
+	const float spacing = 0.2f;
+
+	// Powers of two, then every hardware thread
+	unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	std::printf("%10s %8s %10s %8s %10s\n", "blades", "threads", "ms", "speedup", "same field");
+
+	for (int side : sides) {
+
+		std::vector<glm::mat4> matrices;
+		float singleTime = 0.0f;
+		double reference = 0.0;
+
+		for (unsigned int threads : threadCounts) {
+
+			GrassFieldBuilder builder(side, side, spacing, 1234);
+			builder.setThreadCount(threads);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			builder.generate(matrices);
+			auto end = std::chrono::high_resolution_clock::now();
+			float time = std::chrono::duration<float, std::milli>(end - start).count();
+
+			// Order dependent checksum, must not change with the thread count
+			double checksum = 0.0;
+			for (size_t i = 0; i < matrices.size(); i++) {
+				checksum += matrices[i][0].x * (double)(i % 1024 + 1);
+			}
+
+			if (threads == 1) {
+				singleTime = time;
+				reference = checksum;
+			}
+
+			std::printf("%10zu %8u %10.1f %8.2f %10s\n",
+				matrices.size(),
+				threads,
+				time,
+				singleTime / time,
+				checksum == reference ? "yes" : "NO");
+		}
+	}
+}
+
+void Benchmark::renderQueue() {
+
+	const size_t counts[] = { 1000, 10000, 100000, 1000000 };
+	const int repeats = 20;
+
+	std::printf("%10s %12s %12s %8s %10s\n", "draws", "radix ms", "stable ms", "speedup", "same order");
+
+	std::mt19937_64 random(1234);
+
+	for (size_t count : counts) {
+
+		// Few shaders and textures, many materials and depths like a loaded scene
+		std::vector<RenderItem> source(count);
+		for (auto& item : source) {
+
+			uint64_t state = ((random() % 12) << 32) | ((random() % 64) << 16) | (random() % 4096);
+			item.mKey = (state << 24) | (random() & 0xFFFFFF);
+		}
+
+		std::vector<RenderItem> items, scratch, reference;
+		double radixTime = 0.0, stdTime = 0.0;
+
+		for (int i = 0; i < repeats; i++) {
+
+			items = source;
+			auto start = std::chrono::high_resolution_clock::now();
+			RenderQueue::radixSort(items, scratch);
+			auto end = std::chrono::high_resolution_clock::now();
+			radixTime += std::chrono::duration<double, std::milli>(end - start).count();
+
+			reference = source;
+			start = std::chrono::high_resolution_clock::now();
+			std::stable_sort(reference.begin(), reference.end(), [](const RenderItem& a, const RenderItem& b) {
+				return a.mKey < b.mKey;
+			});
+			end = std::chrono::high_resolution_clock::now();
+			stdTime += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		bool same = true;
+		for (size_t i = 0; i < count; i++) {
+			same = same && items[i].mKey == reference[i].mKey;
+		}
+
+		std::printf("%10zu %12.3f %12.3f %8.2f %10s\n",
+			count,
+			radixTime / repeats,
+			stdTime / repeats,
+			stdTime / radixTime,
+			same ? "yes" : "NO");
+	}
+}
+
+// Scene node before TransformSystem, every world matrix request walks the parent chain
+struct RecursiveNode {
+	glm::vec3 mPosition{ 0.0f };
+	glm::vec3 mAngles{ 0.0f };
+	glm::vec3 mScale{ 1.0f };
+	RecursiveNode* mParent{ nullptr };
+
+	glm::mat4 getModelMatrix() const {
+
+		glm::mat4 parentMatrix{ 1.0f };
+		if (mParent != nullptr) {
+			parentMatrix = mParent->getModelMatrix();
+		}
+
+		glm::mat4 transform = glm::scale(glm::mat4(1.0f), mScale);
+		transform = glm::rotate(transform, glm::radians(mAngles.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		transform = glm::rotate(transform, glm::radians(mAngles.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		transform = glm::rotate(transform, glm::radians(mAngles.z), glm::vec3(0.0f, 0.0f, 1.0f));
+
+		return parentMatrix * glm::translate(glm::mat4(1.0f), mPosition) * transform;
+	}
+};
+
+void Benchmark::transformSystem() {
+
+	const size_t nodeCount = 100000;
+	const int frames = 10;
+
+	// Wide: 4 children per node, depth 9. Deep: chains of 32 like nested model nodes
+	struct Shape {
+		const char* mName;
+		size_t mBranch;
+		size_t mChain;
+	};
+	const Shape shapes[] = { { "wide", 4, 0 }, { "deep", 0, 32 } };
+
+	std::printf("%6s %8s %14s %14s %14s %10s\n", "tree", "nodes", "recursive ms", "flat all ms", "flat 1% ms", "max error");
+
+	for (const Shape& shape : shapes) {
+
+		auto parentOf = [&](size_t i) -> int64_t {
+
+			if (i == 0) {
+				return -1;
+			}
+			if (shape.mBranch > 0) {
+				return (int64_t)((i - 1) / shape.mBranch);
+			}
+			return i % shape.mChain == 0 ? 0 : (int64_t)i - 1;
+		};
+
+		// Children are created before their parents get linked, the system has to reorder once
+		std::vector<RecursiveNode> nodes(nodeCount);
+		TransformSystem system;
+		std::vector<TransformSystem::Handle> handles(nodeCount);
+
+		for (size_t i = nodeCount; i-- > 0;) {
+			handles[i] = system.create();
+		}
+
+		for (size_t i = 0; i < nodeCount; i++) {
+
+			glm::vec3 position{ (float)(i % 7) * 0.1f, 0.2f, (float)(i % 5) * -0.1f };
+			glm::vec3 angles{ (float)(i % 3), (float)(i % 11), 0.5f };
+
+			nodes[i].mPosition = position;
+			nodes[i].mAngles = angles;
+			system.setPosition(handles[i], position);
+			system.setAngles(handles[i], angles);
+
+			int64_t parent = parentOf(i);
+			if (parent >= 0) {
+				nodes[i].mParent = &nodes[parent];
+				system.setParent(handles[i], handles[parent]);
+			}
+		}
+		system.update();
+
+		// 1 Recursive, every node asks for its world matrix once per frame
+		double recursiveTime = 0.0;
+		std::vector<glm::mat4> reference(nodeCount);
+		for (int frame = 0; frame < frames; frame++) {
+
+			nodes[0].mAngles.y += 1.0f;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < nodeCount; i++) {
+				reference[i] = nodes[i].getModelMatrix();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			recursiveTime += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		// 2 Flat, the root moves so every world matrix is rebuilt
+		double allTime = 0.0;
+		for (int frame = 0; frame < frames; frame++) {
+
+			system.setAngles(handles[0], system.getAngles(handles[0]) + glm::vec3(0.0f, 1.0f, 0.0f));
+
+			auto start = std::chrono::high_resolution_clock::now();
+			system.update();
+			auto end = std::chrono::high_resolution_clock::now();
+			allTime += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		float maxError = 0.0f;
+		for (size_t i = 0; i < nodeCount; i++) {
+
+			const glm::mat4& world = system.getWorldMatrix(handles[i]);
+			for (int c = 0; c < 4; c++) {
+				maxError = std::max(maxError, glm::length(world[c] - reference[i][c]));
+			}
+		}
+
+		// 3 Flat, one percent of the leaves move
+		double sparseTime = 0.0;
+		for (int frame = 0; frame < frames; frame++) {
+
+			for (size_t i = nodeCount - 1; i > nodeCount - 1 - nodeCount / 100; i--) {
+				system.setPosition(handles[i], system.getPosition(handles[i]) + glm::vec3(0.01f));
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			system.update();
+			auto end = std::chrono::high_resolution_clock::now();
+			sparseTime += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		std::printf("%6s %8zu %14.2f %14.2f %14.2f %10.2e\n",
+			shape.mName,
+			nodeCount,
+			recursiveTime / frames,
+			allTime / frames,
+			sparseTime / frames,
+			maxError);
+	}
+}
+
+// Traversal before forEachDescendant, the children vector was copied at every node
+static void countCopying(Object* obj, ObjectType type, size_t& count) {
+
+	if (obj->getType() == type) {
+		count++;
+	}
+
+	std::vector<Object*> children = obj->getChildren();
+	for (size_t i = 0; i < children.size(); i++) {
+
+		countCopying(children[i], type, count);
+	}
+}
+
+void Benchmark::sceneTraversal() {
+
+	// Loaded model shape: a few levels of nodes, instanced meshes only at some leaves
+	const size_t sizes[] = { 1000, 10000, 100000 };
+	const int walks = 20;
+
+	std::printf("%8s %12s %12s %12s %12s %16s\n", "nodes", "copy ms", "visit ms", "copy allocs", "visit allocs", "zero allocations");
+
+	for (size_t size : sizes) {
+
+		std::vector<Object*> nodes;
+		nodes.reserve(size);
+		nodes.push_back(new Object());
+
+		for (size_t i = 1; i < size; i++) {
+
+			Object* parent = nodes[(i - 1) / 6];
+			Object* node = new Object();
+			parent->addChild(node);
+			nodes.push_back(node);
+		}
+
+		size_t copyCount = 0, visitCount = 0;
+
+		size_t allocations = AllocationCounter::getCount();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < walks; i++) {
+			countCopying(nodes[0], ObjectType::Object, copyCount);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		double copyTime = std::chrono::duration<double, std::milli>(end - start).count() / walks;
+		size_t copyAllocations = (AllocationCounter::getCount() - allocations) / walks;
+
+		allocations = AllocationCounter::getCount();
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < walks; i++) {
+			nodes[0]->forEachDescendant(ObjectType::Object, [&](Object*) {
+				visitCount++;
+			});
+		}
+		end = std::chrono::high_resolution_clock::now();
+		double visitTime = std::chrono::duration<double, std::milli>(end - start).count() / walks;
+		size_t visitAllocations = (AllocationCounter::getCount() - allocations) / walks;
+
+		std::printf("%8zu %12.3f %12.3f %12zu %12zu %16s\n",
+			size,
+			copyTime,
+			visitTime,
+			copyAllocations,
+			visitAllocations,
+			visitAllocations == 0 && visitCount == copyCount ? "yes" : "NO");
+
+		for (Object* node : nodes) {
+			delete node;
+		}
+	}
+}
+
+void Benchmark::vertexCache() {
+
+	struct TestMesh {
+		std::string mName;
+		std::vector<float> mPositions;
+		std::vector<uint32_t> mIndices;
+	};
+
+	std::vector<TestMesh> meshes;
+	std::mt19937 random(7);
+
+	// 1 Grids with triangles in random order, the worst case for the cache
+	for (int side : { 16, 100, 300 }) {
+
+		TestMesh mesh;
+		mesh.mName = "grid " + std::to_string(side);
+		for (int y = 0; y <= side; y++) {
+			for (int x = 0; x <= side; x++) {
+				mesh.mPositions.insert(mesh.mPositions.end(), { (float)x, (float)y, 0.0f });
+			}
+		}
+
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+
+				uint32_t a = y * (side + 1) + x, b = a + 1, c = a + side + 1, d = c + 1;
+				triangles.push_back({ a, b, c });
+				triangles.push_back({ c, b, d });
+			}
+		}
+		std::shuffle(triangles.begin(), triangles.end(), random);
+
+		for (const auto& triangle : triangles) {
+			mesh.mIndices.insert(mesh.mIndices.end(), triangle.begin(), triangle.end());
+		}
+		meshes.push_back(mesh);
+	}
+
+	// 2 Sphere in Geometry::createSphere order, rows of a latitude band
+	{
+		TestMesh mesh;
+		mesh.mName = "sphere 60";
+		const int lines = 60;
+		for (int i = 0; i <= lines; i++) {
+			for (int j = 0; j <= lines; j++) {
+
+				float phi = i * glm::pi<float>() / lines;
+				float theta = j * 2 * glm::pi<float>() / lines;
+				mesh.mPositions.insert(mesh.mPositions.end(), { std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) });
+			}
+		}
+		for (int i = 0; i < lines; i++) {
+			for (int j = 0; j < lines; j++) {
+
+				uint32_t p1 = i * (lines + 1) + j, p2 = p1 + lines + 1, p3 = p1 + 1, p4 = p2 + 1;
+				mesh.mIndices.insert(mesh.mIndices.end(), { p1, p2, p3, p3, p2, p4 });
+			}
+		}
+		meshes.push_back(mesh);
+	}
+
+	std::printf("FIFO cache of %u vertices\n", MeshOptimizer::CacheSize);
+	std::printf("%10s %10s %12s %12s %12s %12s %10s %10s\n", "mesh", "triangles", "source ACMR", "tipsify", "+overdraw", "+fetch", "ATVR", "ms");
+
+	for (TestMesh& mesh : meshes) {
+
+		uint32_t vertexCount = (uint32_t)(mesh.mPositions.size() / 3);
+		size_t indexCount = mesh.mIndices.size();
+
+		VertexCacheStats source = MeshOptimizer::analyze(mesh.mIndices.data(), indexCount, vertexCount);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::vector<uint32_t> clusters;
+		MeshOptimizer::optimizeVertexCache(mesh.mIndices.data(), indexCount, vertexCount, MeshOptimizer::CacheSize, &clusters);
+		VertexCacheStats tipsify = MeshOptimizer::analyze(mesh.mIndices.data(), indexCount, vertexCount);
+
+		MeshOptimizer::optimizeOverdraw(mesh.mIndices.data(), indexCount, mesh.mPositions.data(), clusters);
+		VertexCacheStats overdraw = MeshOptimizer::analyze(mesh.mIndices.data(), indexCount, vertexCount);
+
+		std::vector<uint32_t> remap;
+		MeshOptimizer::optimizeVertexFetch(mesh.mIndices.data(), indexCount, vertexCount, remap);
+		MeshOptimizer::remapStream(mesh.mPositions.data(), 3, remap);
+		VertexCacheStats fetch = MeshOptimizer::analyze(mesh.mIndices.data(), indexCount, vertexCount);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		double time = std::chrono::duration<double, std::milli>(end - start).count();
+
+		std::printf("%10s %10zu %12.3f %12.3f %12.3f %12.3f %4.2f->%4.2f %10.2f\n",
+			mesh.mName.c_str(),
+			indexCount / 3,
+			source.mAcmr,
+			tipsify.mAcmr,
+			overdraw.mAcmr,
+			fetch.mAcmr,
+			source.mAtvr,
+			fetch.mAtvr,
+			time);
+	}
+}
+
+void Benchmark::textureFiltering() {
+
+	// 1 Mip chain generation on one worker, noise is the worst case for neither filter
+	std::mt19937 random(11);
+	std::uniform_int_distribution<int> byte(0, 255);
+
+	std::printf("%10s %12s %12s\n", "size", "box ms", "kaiser ms");
+	for (int size : { 512, 1024, 2048 }) {
+
+		std::vector<unsigned char> texels((size_t)size * size * 4);
+		for (auto& texel : texels) {
+			texel = (unsigned char)byte(random);
+		}
+
+		double times[2];
+		for (int i = 0; i < 2; i++) {
+
+			std::vector<MipLevel> levels;
+			auto start = std::chrono::high_resolution_clock::now();
+			MipmapGenerator::generate(texels.data(), size, size, i == 0 ? MipmapFilter::Box : MipmapFilter::Kaiser, levels);
+			auto end = std::chrono::high_resolution_clock::now();
+			times[i] = std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		std::printf("%10d %12.2f %12.2f\n", size, times[0], times[1]);
+	}
+
+	// 2 Texel traffic of a 1024^2 RGBA8 texture repeated every meter over the ground, like the
+	// grass diffuse at uvScale 1. Each 8x8 pixel tile fetches the 64 byte lines (4x4 texels) its
+	// samples touch once, a rough stand-in for the texture cache
+	struct Mode {
+		const char* mName;
+		bool mMipmaps;
+		bool mTrilinear;
+		int mAnisotropy;
+	};
+	const Mode modes[] = {
+		{ "nearest", false, false, 1 },
+		{ "bilinear", true, false, 1 },
+		{ "trilinear", true, true, 1 },
+		{ "aniso 4x", true, true, 4 },
+		{ "aniso 16x", true, true, 16 },
+	};
+
+	const int width = 1280, height = 720, tile = 8;
+	const int textureSize = 1024;
+	const int maxLevel = MipmapGenerator::getLevelCount(textureSize, textureSize) - 1;
+	const float eyeHeight = 1.0f, fieldDepth = 60.0f;
+	const float tanHalfFov = tanf(glm::radians(60.0f) * 0.5f);
+	const float aspect = (float)width / height;
+
+	std::printf("\n%10s %10s %14s %12s %12s\n", "view", "sampler", "texels/pixel", "MB/frame", "texel step");
+
+	for (float pitchDegrees : { 4.0f, 30.0f }) {
+
+		float pitch = glm::radians(pitchDegrees);
+		glm::vec3 forward{ 0.0f, -sinf(pitch), -cosf(pitch) };
+		glm::vec3 up{ 0.0f, cosf(pitch), -sinf(pitch) };
+		glm::vec3 right{ 1.0f, 0.0f, 0.0f };
+
+		// Texel position of the ground under a pixel, false for sky or beyond the field
+		auto project = [&](float px, float py, glm::vec2& texel) {
+
+			float ndcX = (px / width * 2.0f - 1.0f) * tanHalfFov * aspect;
+			float ndcY = (1.0f - py / height * 2.0f) * tanHalfFov;
+			glm::vec3 ray = forward + right * ndcX + up * ndcY;
+			if (ray.y >= 0.0f) {
+				return false;
+			}
+
+			float t = eyeHeight / -ray.y;
+			glm::vec2 ground{ ray.x * t, ray.z * t };
+			if (-ground.y > fieldDepth) {
+				return false;
+			}
+
+			texel = ground * (float)textureSize;
+			return true;
+		};
+
+		for (const Mode& mode : modes) {
+
+			double texels = 0.0, lines = 0.0, sharpness = 0.0;
+			size_t pixels = 0;
+			std::vector<uint64_t> tileLines;
+
+			for (int ty = 0; ty < height; ty += tile) {
+				for (int tx = 0; tx < width; tx += tile) {
+
+					tileLines.clear();
+					for (int y = ty; y < ty + tile; y++) {
+						for (int x = tx; x < tx + tile; x++) {
+
+							glm::vec2 center, nextX, nextY;
+							if (!project(x + 0.5f, y + 0.5f, center) || !project(x + 1.5f, y + 0.5f, nextX) || !project(x + 0.5f, y + 1.5f, nextY)) {
+								continue;
+							}
+
+							// 2.1 Footprint axes in base level texels, like the hardware derivatives
+							glm::vec2 dx = nextX - center, dy = nextY - center;
+							float major = std::max(glm::length(dx), glm::length(dy));
+							float minor = std::max(std::min(glm::length(dx), glm::length(dy)), 1e-6f);
+							glm::vec2 axis = glm::length(dx) >= glm::length(dy) ? dx : dy;
+
+							int probes = std::min((int)std::ceil(major / minor), mode.mAnisotropy);
+							float lod = mode.mMipmaps ? glm::clamp(std::log2(std::max(major / probes, 1.0f)), 0.0f, (float)maxLevel) : 0.0f;
+
+							// 2.2 Every probe fetches 2x2 on one or two levels, nearest a single texel
+							int firstLevel = mode.mTrilinear ? (int)lod : (int)(lod + 0.5f);
+							int levelCount = mode.mTrilinear && firstLevel < maxLevel ? 2 : 1;
+							int footprint = mode.mMipmaps ? 2 : 1;
+
+							for (int p = 0; p < probes; p++) {
+
+								glm::vec2 probe = center + axis * ((p + 0.5f) / probes - 0.5f);
+								for (int level = firstLevel; level < firstLevel + levelCount; level++) {
+
+									int levelSize = textureSize >> level;
+									glm::vec2 uv = probe / (float)(1 << level);
+									int u0 = (int)std::floor(uv.x - (footprint - 1) * 0.5f);
+									int v0 = (int)std::floor(uv.y - (footprint - 1) * 0.5f);
+
+									for (int v = v0; v < v0 + footprint; v++) {
+										for (int u = u0; u < u0 + footprint; u++) {
+
+											uint64_t wu = (uint64_t)(((u % levelSize) + levelSize) % levelSize);
+											uint64_t wv = (uint64_t)(((v % levelSize) + levelSize) % levelSize);
+											tileLines.push_back(((uint64_t)level << 40) | ((wv >> 2) << 20) | (wu >> 2));
+											texels += 1.0;
+										}
+									}
+								}
+							}
+
+							// Texels of the sampled level per pixel along the shorter axis, above 1 aliases, below 1 blurs
+							sharpness += minor / std::pow(2.0f, lod);
+							pixels++;
+						}
+					}
+
+					std::sort(tileLines.begin(), tileLines.end());
+					lines += (double)(std::unique(tileLines.begin(), tileLines.end()) - tileLines.begin());
+				}
+			}
+
+			std::printf("%8.0f deg %10s %14.2f %12.2f %12.2f\n",
+				pitchDegrees,
+				mode.mName,
+				pixels > 0 ? texels / pixels : 0.0,
+				lines * 64.0 / (1024.0 * 1024.0),
+				pixels > 0 ? sharpness / pixels : 0.0);
+		}
+	}
+}
+
+bool Benchmark::textureCompression() {
+
+	struct Image {
+		const char* mName;
+		int mWidth;
+		int mHeight;
+		std::vector<unsigned char> mTexels;
+		bool mChecked;	// noise has no structure to keep, it is reported only
+	};
+	std::vector<Image> images;
+
+	// 1 Synthetic 1024^2 sources: smooth color, a hard edged mask and noise as the worst case
+	const int size = 1024;
+	std::mt19937 random(21);
+	std::uniform_int_distribution<int> byte(0, 255);
+
+	Image gradient{ "gradient", size, size, std::vector<unsigned char>((size_t)size * size * 4), true };
+	Image mask{ "mask", size, size, std::vector<unsigned char>((size_t)size * size * 4), true };
+	Image noise{ "noise", size, size, std::vector<unsigned char>((size_t)size * size * 4), false };
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+
+			size_t i = ((size_t)y * size + x) * 4;
+			float u = (float)x / size, v = (float)y / size;
+			gradient.mTexels[i + 0] = (unsigned char)(255.0f * u);
+			gradient.mTexels[i + 1] = (unsigned char)(255.0f * (0.5f + 0.5f * sinf(v * 12.0f)));
+			gradient.mTexels[i + 2] = (unsigned char)(255.0f * u * v);
+			gradient.mTexels[i + 3] = (unsigned char)(255.0f * v);
+
+			// Blade shaped stripes, 0 outside like the alpha == 0 discard expects
+			float blade = fabsf(fmodf(u * 16.0f, 1.0f) - 0.5f) * 2.0f;
+			unsigned char value = blade < 1.0f - v ? (unsigned char)(255.0f * (1.0f - blade)) : 0;
+			mask.mTexels[i + 0] = mask.mTexels[i + 1] = mask.mTexels[i + 2] = value;
+			mask.mTexels[i + 3] = 255;
+
+			for (int c = 0; c < 4; c++) {
+				noise.mTexels[i + c] = (unsigned char)byte(random);
+			}
+		}
+	}
+	images.push_back(std::move(gradient));
+	images.push_back(std::move(mask));
+	images.push_back(std::move(noise));
+
+	int width, height, channels;
+	unsigned char* grassMask = stbi_load("assets/textures/grassMask.png", &width, &height, &channels, STBI_rgb_alpha);
+	bool shippedMask = grassMask != nullptr;
+	if (shippedMask) {
+
+		images.push_back({ "grassMask", width, height, std::vector<unsigned char>(grassMask, grassMask + (size_t)width * height * 4), true });
+		stbi_image_free(grassMask);
+	}
+	else {
+		std::printf("Error: assets/textures/grassMask.png not found\n");
+	}
+
+	// 2 Round trip through the reference decoder, error over the channels the format keeps.
+	// Checked images must stay above the PSNR floor, BC4 masks must keep every alpha == 0 discard
+	struct Format {
+		const char* mName;
+		TextureFormat mFormat;
+		int mChannels;
+		double mMinPsnr;
+		bool mKeepsZero;
+	};
+	const Format formats[] = {
+		{ "bc1", TextureFormat::Bc1, 3, 35.0, false },
+		{ "bc3", TextureFormat::Bc3, 4, 35.0, false },
+		{ "bc4", TextureFormat::Bc4, 1, 40.0, true },
+		{ "bc7", TextureFormat::Bc7, 4, 45.0, false },
+	};
+
+	bool passed = true;
+	std::printf("%10s %6s %8s %10s %8s %8s %6s %10s %6s\n", "image", "format", "ratio", "encode ms", "rmse", "psnr", "max", "zero flips", "check");
+	for (const Image& image : images) {
+		for (const Format& format : formats) {
+
+			std::vector<uint8_t> blocks;
+			auto start = std::chrono::high_resolution_clock::now();
+			BlockCompressor::compress(image.mTexels.data(), image.mWidth, image.mHeight, format.mFormat, blocks);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			std::vector<unsigned char> decoded;
+			BlockCompressor::decompress(blocks.data(), image.mWidth, image.mHeight, format.mFormat, decoded);
+
+			double squared = 0.0;
+			int maxError = 0;
+			size_t zeroFlips = 0;
+			size_t texels = (size_t)image.mWidth * image.mHeight;
+			for (size_t i = 0; i < texels; i++) {
+				for (int c = 0; c < format.mChannels; c++) {
+
+					int error = std::abs((int)image.mTexels[i * 4 + c] - (int)decoded[i * 4 + c]);
+					squared += (double)error * error;
+					maxError = std::max(maxError, error);
+				}
+
+				// Texels whose discard decision changes on the red channel
+				zeroFlips += (image.mTexels[i * 4] == 0) != (decoded[i * 4] == 0) ? 1 : 0;
+			}
+
+			double rmse = std::sqrt(squared / ((double)texels * format.mChannels));
+			double psnr = rmse > 0.0 ? 20.0 * std::log10(255.0 / rmse) : 99.0;
+			double ratio = (double)BlockCompressor::getSize(TextureFormat::Rgba8, image.mWidth, image.mHeight) / blocks.size();
+
+			bool failed = (image.mChecked && psnr < format.mMinPsnr) || (format.mKeepsZero && zeroFlips != 0);
+			passed &= !failed;
+
+			std::printf("%10s %6s %7.1fx %10.1f %8.2f %8.2f %6d %10zu %6s\n",
+				image.mName,
+				format.mName,
+				ratio,
+				std::chrono::duration<double, std::milli>(end - start).count(),
+				rmse,
+				psnr,
+				maxError,
+				zeroFlips,
+				!image.mChecked && !format.mKeepsZero ? "-" : failed ? "FAIL" : "ok");
+		}
+	}
+
+	// 3 The shipped mask in the format the grass uploads it with, read at level 0 by the discard
+	if (shippedMask) {
+
+		const Image& image = images.back();
+		std::vector<uint8_t> blocks;
+		std::vector<unsigned char> decoded;
+		BlockCompressor::compress(image.mTexels.data(), image.mWidth, image.mHeight, GrassInstanceMaterial::MaskFormat, blocks);
+		BlockCompressor::decompress(blocks.data(), image.mWidth, image.mHeight, GrassInstanceMaterial::MaskFormat, decoded);
+
+		size_t zeroFlips = 0;
+		for (size_t i = 0; i < (size_t)image.mWidth * image.mHeight; i++) {
+			zeroFlips += (image.mTexels[i * 4] == 0) != (decoded[i * 4] == 0) ? 1 : 0;
+		}
+
+		std::printf("grassMask as uploaded: %zu zero flips %s\n", zeroFlips, zeroFlips == 0 ? "ok" : "FAIL");
+		passed &= zeroFlips == 0;
+	}
+	else {
+		passed = false;
+	}
+
+	return passed;
+}
+
+void Benchmark::textureAtlas() {
+
+	// Power of two sizes like model textures, and arbitrary ones like UI and decal images
+	std::mt19937 random(31);
+	std::uniform_int_distribution<int> exponent(6, 10);
+	std::uniform_int_distribution<int> side(16, 700);
+
+	std::printf("%8s %8s %12s %8s %10s %10s\n", "images", "sizes", "atlas", "fill", "pack ms", "overlaps");
+	for (int count : { 4, 16, 64, 256 }) {
+		for (int powers = 1; powers >= 0; powers--) {
+
+			TextureAtlas atlas(16384, 4);
+			size_t area = 0;
+			for (int i = 0; i < count; i++) {
+
+				int width = powers ? 1 << exponent(random) : side(random);
+				int height = powers ? 1 << exponent(random) : side(random);
+				atlas.add(width, height);
+				area += (size_t)width * height;
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			bool packed = atlas.pack();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			// Padded rects must stay apart and inside
+			size_t overlaps = 0;
+			for (int i = 0; i < count && packed; i++) {
+
+				const AtlasRect& a = atlas.getRect(i);
+				if (a.mX < 4 || a.mY < 4 || a.mX + a.mWidth + 4 > atlas.getWidth() || a.mY + a.mHeight + 4 > atlas.getHeight()) {
+					overlaps++;
+				}
+				for (int j = i + 1; j < count; j++) {
+
+					const AtlasRect& b = atlas.getRect(j);
+					if (a.mX - 4 < b.mX + b.mWidth + 4 && b.mX - 4 < a.mX + a.mWidth + 4 &&
+						a.mY - 4 < b.mY + b.mHeight + 4 && b.mY - 4 < a.mY + a.mHeight + 4) {
+						overlaps++;
+					}
+				}
+			}
+
+			char size[32];
+			std::snprintf(size, sizeof(size), "%dx%d", atlas.getWidth(), atlas.getHeight());
+			std::printf("%8d %8s %12s %7.1f%% %10.3f %10zu\n",
+				count,
+				powers ? "pow2" : "odd",
+				packed ? size : "failed",
+				packed ? 100.0 * area / ((double)atlas.getWidth() * atlas.getHeight()) : 0.0,
+				std::chrono::duration<double, std::milli>(end - start).count(),
+				overlaps);
+		}
+	}
+}
+
+// Corners and the 12 triangles of a box
+static void boxTriangles(const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3 corners[8], uint32_t indices[36]) {
+
+	for (int i = 0; i < 8; i++) {
+		corners[i] = glm::vec3(
+			(i & 1) ? boundsMax.x : boundsMin.x,
+			(i & 2) ? boundsMax.y : boundsMin.y,
+			(i & 4) ? boundsMax.z : boundsMin.z);
+	}
+
+	const uint32_t faces[6][4] = {
+		{ 0, 2, 6, 4 }, { 1, 5, 7, 3 },		// -x +x
+		{ 0, 4, 5, 1 }, { 2, 3, 7, 6 },		// -y +y
+		{ 0, 1, 3, 2 }, { 4, 6, 7, 5 }		// -z +z
+	};
+
+	for (int f = 0; f < 6; f++) {
+
+		const uint32_t* q = faces[f];
+		uint32_t* out = indices + f * 6;
+		out[0] = q[0]; out[1] = q[1]; out[2] = q[2];
+		out[3] = q[0]; out[4] = q[2]; out[5] = q[3];
+	}
+}
+
+bool Benchmark::occlusion() {
+
+	// Demo sized field, a row of houses between the camera path and most of the blades
+	const int side = 1000;
+	const float spacing = 0.2f;
+	const int frames = 120;
+	const glm::vec3 bladeMin{ -0.1f, 0.0f, -0.1f };
+	const glm::vec3 bladeMax{ 0.1f, 0.6f, 0.1f };
+	const float margin = 0.1f;
+
+	std::vector<glm::mat4> matrices;
+	GrassFieldBuilder(side, side, spacing).generate(matrices);
+	GrassField field(16.0f);
+	field.build(matrices, bladeMin, bladeMax);
+
+	float extent = side * spacing;
+	std::vector<std::pair<glm::vec3, glm::vec3>> houses;
+	for (float x = 4.0f; x < extent; x += 22.0f) {
+		houses.push_back({ glm::vec3(x, 0.0f, 6.0f), glm::vec3(x + 14.0f, 7.0f, 16.0f) });
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	std::printf("%10s %10s %10s %10s %8s %10s %10s %10s\n",
+		"pyramid", "in view", "occluded", "truth", "false", "raster ms", "build ms", "cull ms");
+
+	bool passed = true;
+	const int resolutions[][2] = { { 128, 64 }, { 256, 128 }, { 512, 256 } };
+	for (const auto& resolution : resolutions) {
+
+		DepthPyramid pyramid(resolution[0], resolution[1]);
+		DepthPyramid scratch(resolution[0], resolution[1]);
+
+		double inView = 0.0, occluded = 0.0, truth = 0.0, rasterTime = 0.0, buildTime = 0.0, cullTime = 0.0;
+		size_t falseCulls = 0;
+
+		for (int i = 0; i < frames; i++) {
+
+			// 1 Same walk as grassField, along the edge looking across
+			float t = (float)i / (frames - 1);
+			glm::vec3 eye{ extent * t, 1.7f, -1.0f };
+			glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(0.5f, -0.1f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 viewProjection = projection * view;
+
+			// 2 Occluders
+			pyramid.clear();
+			for (const auto& house : houses) {
+
+				glm::vec3 corners[8];
+				uint32_t indices[36];
+				boxTriangles(house.first, house.second, corners, indices);
+				pyramid.rasterize(corners, indices, 36, viewProjection);
+			}
+			pyramid.build();
+
+			field.cull(viewProjection, margin, &pyramid);
+
+			const GrassCullStats& stats = field.getStats();
+			inView += stats.mVisibleChunks + stats.mOccludedChunks;
+			occluded += stats.mOccludedChunks;
+			rasterTime += pyramid.getStats().mRasterTime;
+			buildTime += pyramid.getStats().mBuildTime;
+			cullTime += stats.mCullTime;
+
+			// 3 Reference: a chunk is hidden when none of its pixels passes the depth test.
+			// A culled chunk with a passing pixel is a false cull
+			Frustum frustum;
+			frustum.setFromMatrix(viewProjection);
+			for (const auto& chunk : field.getChunks()) {
+
+				glm::vec3 chunkMin = chunk.mBoundsMin - glm::vec3(margin);
+				glm::vec3 chunkMax = chunk.mBoundsMax + glm::vec3(margin);
+				if (!frustum.intersectsBox(chunkMin, chunkMax)) {
+					continue;
+				}
+
+				glm::vec3 corners[8];
+				uint32_t indices[36];
+				boxTriangles(chunkMin, chunkMax, corners, indices);
+				scratch.clear();
+				scratch.rasterize(corners, indices, 36, viewProjection);
+
+				bool visible = false;
+				for (int y = 0; y < scratch.getHeight() && !visible; y++) {
+					for (int x = 0; x < scratch.getWidth() && !visible; x++) {
+						visible = scratch.getDepth(0, x, y) < pyramid.getDepth(0, x, y);
+					}
+				}
+
+				if (!visible) {
+					truth++;
+				}
+				else if (pyramid.isOccluded(chunkMin, chunkMax, viewProjection)) {
+					falseCulls++;
+				}
+			}
+		}
+
+		char size[32];
+		std::snprintf(size, sizeof(size), "%dx%d", resolution[0], resolution[1]);
+		std::printf("%10s %10.1f %10.1f %10.1f %8zu %10.4f %10.4f %10.4f\n",
+			size,
+			inView / frames,
+			occluded / frames,
+			truth / frames,
+			falseCulls,
+			rasterTime / frames,
+			buildTime / frames,
+			cullTime / frames);
+
+		// A culled chunk with a visible pixel is a wrong image, not a slower one
+		passed &= falseCulls == 0;
+	}
+
+	return passed;
+}
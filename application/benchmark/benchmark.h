@@ -0,0 +1,43 @@
+#pragma once
+#include "../../glframework/core.h"
+
+// Headless measurements, run before any window or GL context is created
+class Benchmark {
+public:
+
+	// Returns false when name is not a known benchmark or a checked one fails
+	static bool run(const std::string& name);
+
+	// Chunk culling of fields from 90k to 10M blades along a camera path
+	static void grassField();
+
+	// Parallel field generation from 1M to 16M blades over thread counts
+	static void grassFieldBuilder();
+
+	// Radix sort of render queue keys against std::stable_sort from 1k to 1M draws
+	static void renderQueue();
+
+	// World matrices of a 100k node hierarchy, flat TransformSystem against the recursive parent walk
+	static void transformSystem();
+
+	// Copying recursive walk against Object::forEachDescendant, time and heap allocations per walk
+	static void sceneTraversal();
+
+	// ACMR and ATVR of shuffled grids and a sphere through every MeshOptimizer stage
+	static void vertexCache();
+
+	// CPU mip chain filters, and modeled texel traffic of the world mapped grass diffuse
+	// at grazing and steep views for every sampler setting
+	static void textureFiltering();
+
+	// BC1/BC3/BC4/BC7 encode time, size and decode round trip error of synthetic images
+	// and the grass mask. Fails below the PSNR floor of a format or on a BC4 discard flip
+	static bool textureCompression();
+
+	// Atlas packing of odd sized image sets: atlas size, fill, pack time and overlap check
+	static void textureAtlas();
+
+	// Grass chunks behind a row of houses through the software depth pyramid at several
+	// resolutions, checked against a per pixel depth test of every chunk box. Fails on any false cull
+	static bool occlusion();
+};
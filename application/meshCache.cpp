@@ -0,0 +1,878 @@
+#include "meshCache.h"
+#include "../glframework/tools/tools.h"
+#include "stb_image.h"
+
+#include "assimp/Importer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+
+static const char MeshCacheMagic[8] = { 'G', 'R', 'M', 'C', 'A', 'C', 'H', 'E' };
+
+std::vector<MeshLoadReport> MeshCache::mReports{};
+
+MeshCache::MeshCache() {}
+
+MeshCache::~MeshCache() {}
+
+uint64_t MeshCache::hashFile(const std::string& path, bool& found) {
+
+	// FNV-1a 64 over the source bytes
+	uint64_t hash = 14695981039346656037ull;
+
+	MappedFile source;
+	found = source.open(path);
+	if (!found) {
+		return hash;
+	}
+
+	const uint8_t* data = source.getData();
+	size_t size = source.getSize();
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool MeshCache::load(const std::string& path, unsigned int importFlags, unsigned int optimizeFlags, const std::vector<float>& lodRatios) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mPath = path;
+	std::size_t lastIndex = path.find_last_of("//");
+	mRootPath = path.substr(0, lastIndex + 1);
+
+	MeshLoadReport report;
+	report.mPath = path;
+
+	bool found = false;
+	mSourceHash = hashFile(path, found);
+	mImportFlags = importFlags;
+	mOptimizeFlags = optimizeFlags;
+
+	mLodRatios.clear();
+	for (size_t i = 0; i < lodRatios.size() && i < MaxMeshLods; i++) {
+		mLodRatios.push_back(glm::clamp(lodRatios[i], 0.0f, 1.0f));
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	// 1 Map a cache written from this exact source
+	std::string cachePath = getCachePath(path);
+	report.mCacheHit = map(cachePath);
+
+	if (report.mCacheHit) {
+		report.mImportTime = mHeader->mImportTime;
+		report.mCacheSize = mFile.getSize();
+	}
+	else {
+
+		// 2 Import and keep the serialized scene for this run
+		if (!import(path, report.mImportTime)) {
+			return false;
+		}
+		report.mCacheSize = mBuffer.size();
+
+		// 3 Write it for the next run, a read only folder only costs the speedup
+		auto writeStart = std::chrono::high_resolution_clock::now();
+
+		std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(mBuffer.data()), (std::streamsize)mBuffer.size());
+		if (!file.good()) {
+			std::cout << "Warning: Mesh cache " << cachePath << " could not be written" << std::endl;
+		}
+
+		auto writeEnd = std::chrono::high_resolution_clock::now();
+		report.mWriteTime = std::chrono::duration<float, std::milli>(writeEnd - writeStart).count();
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	report.mLoadTime = std::chrono::duration<float, std::milli>(end - start).count();
+	report.mSourceCache = mHeader->mSourceCache;
+	report.mOptimizedCache = mHeader->mOptimizedCache;
+
+	// 4 LOD levels summed over the meshes that own them
+	report.mLods.resize(mHeader->mLodCount);
+	for (uint32_t i = 0; i < mHeader->mLodCount; i++) {
+		report.mLods[i].mRatio = mHeader->mLodRatios[i];
+	}
+
+	// 5 Distinct images share a rect between materials
+	report.mAtlasWidth = mHeader->mAtlasWidth;
+	report.mAtlasHeight = mHeader->mAtlasHeight;
+	for (uint32_t i = 0; i < mHeader->mMaterialCount; i++) {
+
+		const AtlasRect& rect = mMaterials[i].mAtlasRect;
+		bool first = rect.mWidth > 0;
+		for (uint32_t j = 0; j < i && first; j++) {
+			first = mMaterials[j].mAtlasRect.mX != rect.mX || mMaterials[j].mAtlasRect.mY != rect.mY;
+		}
+		report.mAtlasImages += first ? 1 : 0;
+	}
+
+	for (uint32_t i = 0; i < mHeader->mSourceMeshCount; i++) {
+
+		const CachedMesh& mesh = mMeshes[i];
+		report.mTriangles += mesh.mIndexCount / 3;
+
+		for (uint32_t j = 0; j < mesh.mLodCount && j < mHeader->mLodCount; j++) {
+
+			const CachedMesh& lod = mMeshes[mesh.mFirstLod + j];
+			report.mLods[j].mTriangles += lod.mIndexCount / 3;
+			report.mLods[j].mError = std::max(report.mLods[j].mError, lod.mError);
+		}
+	}
+
+	if (report.mCacheHit) {
+		std::cout << "MeshCache " << path << ": mapped in " << report.mLoadTime
+			<< " ms, Assimp import took " << report.mImportTime << " ms" << std::endl;
+	}
+	else {
+		std::cout << "MeshCache " << path << ": imported in " << report.mImportTime
+			<< " ms, cache written in " << report.mWriteTime << " ms" << std::endl;
+	}
+
+	std::cout << "MeshCache " << path << ": ACMR " << report.mSourceCache.mAcmr << " -> " << report.mOptimizedCache.mAcmr
+		<< ", ATVR " << report.mSourceCache.mAtvr << " -> " << report.mOptimizedCache.mAtvr << std::endl;
+
+	for (const MeshLodReport& lod : report.mLods) {
+		std::cout << "MeshCache " << path << ": LOD " << lod.mRatio << " " << report.mTriangles << " -> " << lod.mTriangles
+			<< " triangles, error " << lod.mError << std::endl;
+	}
+
+	if (report.mAtlasImages > 0) {
+		std::cout << "MeshCache " << path << ": " << report.mAtlasImages << " diffuse textures in a "
+			<< report.mAtlasWidth << "x" << report.mAtlasHeight << " atlas" << std::endl;
+	}
+
+	mReports.push_back(report);
+	return true;
+}
+
+bool MeshCache::map(const std::string& cachePath) {
+
+	if (!mFile.open(cachePath)) {
+		return false;
+	}
+
+	if (!attach(mFile.getData(), mFile.getSize())) {
+		mFile.close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshCache::attach(const uint8_t* data, size_t size) {
+
+	mHeader = nullptr;
+	if (size < sizeof(MeshCacheHeader)) {
+		return false;
+	}
+
+	// 1 Same format, source and import
+	const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(data);
+	if (std::memcmp(header->mMagic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0 ||
+		header->mVersion != MeshCacheVersion ||
+		header->mImportFlags != mImportFlags ||
+		header->mOptimizeFlags != mOptimizeFlags ||
+		header->mLodCount != mLodRatios.size() ||
+		std::memcmp(header->mLodRatios, mLodRatios.data(), mLodRatios.size() * sizeof(float)) != 0 ||
+		header->mSourceMeshCount > header->mMeshCount ||
+		header->mSourceHash != mSourceHash ||
+		header->mFileSize != size) {
+		return false;
+	}
+
+	// 2 Every section inside the file, a truncated write fails here
+	auto inside = [size](uint64_t offset, uint64_t count, uint64_t stride) {
+		return offset <= size && count <= (size - offset) / stride;
+	};
+
+	if (!inside(header->mNodeOffset, header->mNodeCount, sizeof(CachedNode)) ||
+		!inside(header->mMeshRefOffset, header->mMeshRefCount, sizeof(uint32_t)) ||
+		!inside(header->mMeshOffset, header->mMeshCount, sizeof(CachedMesh)) ||
+		!inside(header->mMaterialOffset, header->mMaterialCount, sizeof(CachedMaterial)) ||
+		!inside(header->mVertexOffset, header->mVertexSize, 1) ||
+		!inside(header->mIndexOffset, header->mIndexSize, 1) ||
+		!inside(header->mBlobOffset, header->mBlobSize, 1)) {
+		return false;
+	}
+
+	mNodes = reinterpret_cast<const CachedNode*>(data + header->mNodeOffset);
+	mMeshRefs = reinterpret_cast<const uint32_t*>(data + header->mMeshRefOffset);
+	mMeshes = reinterpret_cast<const CachedMesh*>(data + header->mMeshOffset);
+	mMaterials = reinterpret_cast<const CachedMaterial*>(data + header->mMaterialOffset);
+	mVertices = data + header->mVertexOffset;
+	mIndices = data + header->mIndexOffset;
+	mBlob = data + header->mBlobOffset;
+
+	// 3 References between sections
+	for (uint32_t i = 0; i < header->mNodeCount; i++) {
+
+		const CachedNode& node = mNodes[i];
+		if (node.mParent >= (int32_t)i || node.mFirstMesh + (uint64_t)node.mMeshCount > header->mMeshRefCount) {
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->mMeshRefCount; i++) {
+		if (mMeshRefs[i] >= header->mSourceMeshCount) {
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->mMeshCount; i++) {
+
+		const CachedMesh& mesh = mMeshes[i];
+		VertexLayout layout;
+		if (!VertexLayout::decode(mesh.mLayout, layout) ||
+			(mesh.mIndexType != GL_UNSIGNED_SHORT && mesh.mIndexType != GL_UNSIGNED_INT) ||
+			mesh.mVertexOffset + (uint64_t)mesh.mVertexCount * layout.getStride() > header->mVertexSize ||
+			mesh.mIndexOffset + (uint64_t)mesh.mIndexCount * IndexLayout::getSize(mesh.mIndexType) > header->mIndexSize ||
+			mesh.mMaterial >= header->mMaterialCount ||
+			mesh.mFirstLod + (uint64_t)mesh.mLodCount > header->mMeshCount) {
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->mMaterialCount; i++) {
+
+		for (const CachedTexture* texture : { &mMaterials[i].mDiffuse, &mMaterials[i].mSpecular }) {
+			if ((uint64_t)texture->mNameOffset + texture->mNameLength > header->mBlobSize ||
+				texture->mDataOffset + texture->mDataSize > header->mBlobSize) {
+				return false;
+			}
+		}
+
+		const AtlasRect& rect = mMaterials[i].mAtlasRect;
+		if (rect.mWidth > 0 && (rect.mX < 0 || rect.mY < 0 || rect.mHeight <= 0 ||
+			(uint64_t)rect.mX + rect.mWidth > header->mAtlasWidth ||
+			(uint64_t)rect.mY + rect.mHeight > header->mAtlasHeight)) {
+			return false;
+		}
+	}
+
+	mHeader = header;
+	return true;
+}
+
+void MeshCache::collectNodes(const aiNode* ainode, int32_t parent, std::vector<const aiNode*>& nodes, std::vector<int32_t>& parents) {
+
+	int32_t index = (int32_t)nodes.size();
+	nodes.push_back(ainode);
+	parents.push_back(parent);
+
+	for (unsigned int i = 0; i < ainode->mNumChildren; i++) {
+		collectNodes(ainode->mChildren[i], index, nodes, parents);
+	}
+}
+
+bool MeshCache::import(const std::string& path, float& importTime) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, mImportFlags);
+
+	// Check whether readfile succeed
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		return false;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	importTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+	// 1 Nodes parents first
+	std::vector<const aiNode*> ainodes;
+	std::vector<int32_t> parents;
+	collectNodes(scene->mRootNode, -1, ainodes, parents);
+
+	std::vector<CachedNode> nodes(ainodes.size());
+	std::vector<uint32_t> meshRefs;
+	for (size_t i = 0; i < ainodes.size(); i++) {
+
+		const aiNode* ainode = ainodes[i];
+		CachedNode& node = nodes[i];
+		node.mParent = parents[i];
+		node.mFirstMesh = (uint32_t)meshRefs.size();
+		node.mMeshCount = ainode->mNumMeshes;
+		meshRefs.insert(meshRefs.end(), ainode->mMeshes, ainode->mMeshes + ainode->mNumMeshes);
+
+		const aiMatrix4x4& value = ainode->mTransformation;
+		glm::mat4 localMatrix(
+			value.a1, value.a2, value.a3, value.a4,
+			value.b1, value.b2, value.b3, value.b4,
+			value.c1, value.c2, value.c3, value.c4,
+			value.d1, value.d2, value.d3, value.d4
+		);
+
+		glm::vec3 position, eulerAngle, scale;
+		Tools::decompose(localMatrix, position, eulerAngle, scale);
+		std::memcpy(node.mPosition, &position, sizeof(node.mPosition));
+		std::memcpy(node.mAngles, &eulerAngle, sizeof(node.mAngles));
+		std::memcpy(node.mScale, &scale, sizeof(node.mScale));
+	}
+
+	// 2 Every mesh packed in its smallest layout, 4 byte aligned, LODs after all source meshes.
+	// Uvs of atlas materials are moved into their rect once simplified and optimized
+	uint32_t atlasWidth = 0, atlasHeight = 0;
+	std::vector<AtlasRect> atlasRects = planAtlas(scene, atlasWidth, atlasHeight);
+
+	auto remapUvs = [&](uint32_t material, std::vector<float>& meshUvs) {
+
+		if (atlasRects[material].mWidth == 0) {
+			return;
+		}
+
+		glm::vec4 transform = TextureAtlas::getUvTransform(atlasRects[material], atlasWidth, atlasHeight);
+		for (size_t v = 0; v < meshUvs.size(); v += 2) {
+			meshUvs[v] = meshUvs[v] * transform.x + transform.z;
+			meshUvs[v + 1] = meshUvs[v + 1] * transform.y + transform.w;
+		}
+	};
+
+	uint32_t sourceMeshCount = scene->mNumMeshes;
+	std::vector<CachedMesh> meshes(sourceMeshCount);
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+
+	std::vector<float> positions, normals, uvs, colors;
+	std::vector<uint32_t> meshIndices;
+	VertexCacheStats sourceCache, optimizedCache;
+	size_t totalTriangles = 0, totalVertices = 0;
+
+	std::vector<float> lodPositions, lodNormals, lodUvs, lodColors;
+	std::vector<uint32_t> lodIndices, lodRemap;
+	for (unsigned int i = 0; i < sourceMeshCount; i++) {
+
+		const aiMesh* aimesh = scene->mMeshes[i];
+		uint32_t vertexCount = aimesh->mNumVertices;
+		bool hasColors = aimesh->HasVertexColors(0);
+
+		positions.resize((size_t)vertexCount * 3);
+		normals.resize((size_t)vertexCount * 3);
+		uvs.resize((size_t)vertexCount * 2);
+		colors.resize(hasColors ? (size_t)vertexCount * 3 : 0);
+
+		for (uint32_t v = 0; v < vertexCount; v++) {
+
+			positions[(size_t)v * 3] = aimesh->mVertices[v].x;
+			positions[(size_t)v * 3 + 1] = aimesh->mVertices[v].y;
+			positions[(size_t)v * 3 + 2] = aimesh->mVertices[v].z;
+
+			normals[(size_t)v * 3] = aimesh->mNormals[v].x;
+			normals[(size_t)v * 3 + 1] = aimesh->mNormals[v].y;
+			normals[(size_t)v * 3 + 2] = aimesh->mNormals[v].z;
+
+			// number 0 uvs are texture uv
+			uvs[(size_t)v * 2] = aimesh->mTextureCoords[0] ? aimesh->mTextureCoords[0][v].x : 0.0f;
+			uvs[(size_t)v * 2 + 1] = aimesh->mTextureCoords[0] ? aimesh->mTextureCoords[0][v].y : 0.0f;
+
+			if (hasColors) {
+				colors[(size_t)v * 3] = aimesh->mColors[0][v].r;
+				colors[(size_t)v * 3 + 1] = aimesh->mColors[0][v].g;
+				colors[(size_t)v * 3 + 2] = aimesh->mColors[0][v].b;
+			}
+		}
+
+		meshIndices.clear();
+		for (unsigned int f = 0; f < aimesh->mNumFaces; f++) {
+
+			const aiFace& face = aimesh->mFaces[f];
+			meshIndices.insert(meshIndices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+		}
+
+		// 2.1 Every LOD simplified from the source, so errors are measured against it.
+		// Collapses keep attributes exact and pay for moving them, so the wind weight in color survives
+		VertexStreams streams;
+		streams.mPositions = positions.data();
+		streams.mNormals = normals.data();
+		streams.mUvs = uvs.data();
+		streams.mColors = hasColors ? colors.data() : nullptr;
+		streams.mVertexCount = vertexCount;
+
+		meshes[i].mFirstLod = (uint32_t)meshes.size();
+		meshes[i].mLodCount = (uint32_t)mLodRatios.size();
+
+		for (float ratio : mLodRatios) {
+
+			size_t target = (size_t)(meshIndices.size() / 3 * ratio) * 3;
+			float error = MeshSimplifier::simplify(
+				streams,
+				meshIndices.data(),
+				meshIndices.size(),
+				target,
+				std::numeric_limits<float>::max(),
+				lodIndices);
+
+			// Only the vertices the LOD still reads, in first use order
+			lodRemap.assign(vertexCount, 0xFFFFFFFF);
+			lodPositions.clear();
+			lodNormals.clear();
+			lodUvs.clear();
+			lodColors.clear();
+			for (uint32_t& index : lodIndices) {
+
+				if (lodRemap[index] == 0xFFFFFFFF) {
+
+					lodRemap[index] = (uint32_t)(lodPositions.size() / 3);
+					lodPositions.insert(lodPositions.end(), &positions[(size_t)index * 3], &positions[(size_t)index * 3] + 3);
+					lodNormals.insert(lodNormals.end(), &normals[(size_t)index * 3], &normals[(size_t)index * 3] + 3);
+					lodUvs.insert(lodUvs.end(), &uvs[(size_t)index * 2], &uvs[(size_t)index * 2] + 2);
+					if (hasColors) {
+						lodColors.insert(lodColors.end(), &colors[(size_t)index * 3], &colors[(size_t)index * 3] + 3);
+					}
+				}
+				index = lodRemap[index];
+			}
+
+			optimize(lodIndices, lodPositions, lodNormals, lodUvs, lodColors);
+			remapUvs(aimesh->mMaterialIndex, lodUvs);
+
+			CachedMesh lod = appendMesh(lodIndices, lodPositions, lodNormals, lodUvs, lodColors, atlasRects[aimesh->mMaterialIndex].mWidth > 0, vertices, indices);
+			lod.mMaterial = aimesh->mMaterialIndex;
+			lod.mError = error;
+			meshes.push_back(lod);
+		}
+
+		// 2.2 Triangle and vertex order for the post-transform cache, measured on both sides
+		size_t triangles = meshIndices.size() / 3;
+		VertexCacheStats before = MeshOptimizer::analyze(meshIndices.data(), meshIndices.size(), vertexCount);
+		optimize(meshIndices, positions, normals, uvs, colors);
+		VertexCacheStats after = MeshOptimizer::analyze(meshIndices.data(), meshIndices.size(), vertexCount);
+
+		sourceCache.mAcmr += before.mAcmr * triangles;
+		sourceCache.mAtvr += before.mAtvr * vertexCount;
+		optimizedCache.mAcmr += after.mAcmr * triangles;
+		optimizedCache.mAtvr += after.mAtvr * vertexCount;
+		totalTriangles += triangles;
+		totalVertices += vertexCount;
+
+		remapUvs(aimesh->mMaterialIndex, uvs);
+		CachedMesh mesh = appendMesh(meshIndices, positions, normals, uvs, colors, atlasRects[aimesh->mMaterialIndex].mWidth > 0, vertices, indices);
+		mesh.mMaterial = aimesh->mMaterialIndex;
+		mesh.mFirstLod = meshes[i].mFirstLod;
+		mesh.mLodCount = meshes[i].mLodCount;
+		meshes[i] = mesh;
+	}
+
+	if (totalTriangles > 0) {
+		sourceCache.mAcmr /= totalTriangles;
+		optimizedCache.mAcmr /= totalTriangles;
+	}
+	if (totalVertices > 0) {
+		sourceCache.mAtvr /= totalVertices;
+		optimizedCache.mAtvr /= totalVertices;
+	}
+
+	// 3 Diffuse and specular references, names and embedded texels go to the blob
+	std::vector<uint8_t> blob;
+	auto appendBlob = [&blob](const void* data, size_t size) {
+
+		uint64_t offset = blob.size();
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		blob.insert(blob.end(), bytes, bytes + size);
+		return offset;
+	};
+
+	auto cacheTexture = [&](const aiMaterial* aimat, aiTextureType type) {
+
+		CachedTexture texture;
+
+		aiString aipath;
+		aimat->Get(AI_MATKEY_TEXTURE(type, 0), aipath);
+		if (!aipath.length) {
+			return texture;
+		}
+
+		texture.mNameOffset = (uint32_t)appendBlob(aipath.C_Str(), aipath.length);
+		texture.mNameLength = aipath.length;
+
+		// Check if fbx has texture
+		const aiTexture* aitexture = scene->GetEmbeddedTexture(aipath.C_Str());
+		if (aitexture) {
+
+			texture.mKind = (uint32_t)CachedTextureKind::Embedded;
+			texture.mWidth = aitexture->mWidth;
+			texture.mHeight = aitexture->mHeight;
+			texture.mDataSize = aitexture->mHeight == 0 ? aitexture->mWidth : aitexture->mWidth * aitexture->mHeight * 4;
+			texture.mDataOffset = appendBlob(aitexture->pcData, texture.mDataSize);
+		}
+		else {
+			texture.mKind = (uint32_t)CachedTextureKind::File;
+		}
+
+		return texture;
+	};
+
+	std::vector<CachedMaterial> materials(scene->mNumMaterials);
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+
+		materials[i].mDiffuse = cacheTexture(scene->mMaterials[i], aiTextureType_DIFFUSE);
+		materials[i].mSpecular = cacheTexture(scene->mMaterials[i], aiTextureType_SPECULAR);
+		materials[i].mAtlasRect = atlasRects[i];
+	}
+
+	// 4 Lay the sections out, 8 byte aligned
+	MeshCacheHeader header;
+	std::memcpy(header.mMagic, MeshCacheMagic, sizeof(MeshCacheMagic));
+	header.mVersion = MeshCacheVersion;
+	header.mImportFlags = mImportFlags;
+	header.mOptimizeFlags = mOptimizeFlags;
+	header.mSourceHash = mSourceHash;
+	header.mNodeCount = (uint32_t)nodes.size();
+	header.mMeshRefCount = (uint32_t)meshRefs.size();
+	header.mMeshCount = (uint32_t)meshes.size();
+	header.mMaterialCount = (uint32_t)materials.size();
+	header.mVertexSize = vertices.size();
+	header.mIndexSize = indices.size();
+	header.mBlobSize = blob.size();
+	header.mImportTime = importTime;
+	header.mSourceCache = sourceCache;
+	header.mOptimizedCache = optimizedCache;
+	header.mLodCount = (uint32_t)mLodRatios.size();
+	std::memcpy(header.mLodRatios, mLodRatios.data(), mLodRatios.size() * sizeof(float));
+	header.mSourceMeshCount = sourceMeshCount;
+	header.mAtlasWidth = atlasWidth;
+	header.mAtlasHeight = atlasHeight;
+
+	mBuffer.clear();
+	mBuffer.resize(sizeof(MeshCacheHeader));
+
+	auto appendSection = [this](const void* data, size_t size) {
+
+		mBuffer.resize((mBuffer.size() + 7) & ~(size_t)7);
+		uint64_t offset = mBuffer.size();
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+		return offset;
+	};
+
+	header.mNodeOffset = appendSection(nodes.data(), nodes.size() * sizeof(CachedNode));
+	header.mMeshRefOffset = appendSection(meshRefs.data(), meshRefs.size() * sizeof(uint32_t));
+	header.mMeshOffset = appendSection(meshes.data(), meshes.size() * sizeof(CachedMesh));
+	header.mMaterialOffset = appendSection(materials.data(), materials.size() * sizeof(CachedMaterial));
+	header.mVertexOffset = appendSection(vertices.data(), vertices.size());
+	header.mIndexOffset = appendSection(indices.data(), indices.size());
+	header.mBlobOffset = appendSection(blob.data(), blob.size());
+	header.mFileSize = mBuffer.size();
+
+	std::memcpy(mBuffer.data(), &header, sizeof(MeshCacheHeader));
+
+	return attach(mBuffer.data(), mBuffer.size());
+}
+
+CachedMesh MeshCache::appendMesh(
+	const std::vector<uint32_t>& indices,
+	const std::vector<float>& positions,
+	const std::vector<float>& normals,
+	const std::vector<float>& uvs,
+	const std::vector<float>& colors,
+	bool atlasUvs,
+	std::vector<uint8_t>& vertices,
+	std::vector<uint8_t>& indexData) {
+
+	uint32_t vertexCount = (uint32_t)(positions.size() / 3);
+
+	VertexStreams streams;
+	streams.mPositions = positions.data();
+	streams.mNormals = normals.data();
+	streams.mUvs = uvs.data();
+	streams.mColors = colors.empty() ? nullptr : colors.data();
+	streams.mVertexCount = vertexCount;
+
+	VertexLayout layout = VertexLayout::choose(streams);
+	if (atlasUvs) {
+		layout.mUv = UvFormat::Float2;
+	}
+	GLenum indexType = IndexLayout::choose(vertexCount);
+
+	CachedMesh mesh;
+	mesh.mVertexCount = vertexCount;
+	mesh.mIndexCount = (uint32_t)indices.size();
+	mesh.mLayout = layout.encode();
+	mesh.mIndexType = indexType;
+
+	if (vertexCount > 0) {
+
+		glm::vec3 boundingMin{ std::numeric_limits<float>::max() };
+		glm::vec3 boundingMax{ -std::numeric_limits<float>::max() };
+		for (uint32_t v = 0; v < vertexCount; v++) {
+
+			glm::vec3 position{ positions[(size_t)v * 3], positions[(size_t)v * 3 + 1], positions[(size_t)v * 3 + 2] };
+			boundingMin = glm::min(boundingMin, position);
+			boundingMax = glm::max(boundingMax, position);
+		}
+
+		std::memcpy(mesh.mBoundingMin, &boundingMin, sizeof(mesh.mBoundingMin));
+		std::memcpy(mesh.mBoundingMax, &boundingMax, sizeof(mesh.mBoundingMax));
+	}
+
+	mesh.mVertexOffset = (vertices.size() + 3) & ~(size_t)3;
+	vertices.resize(mesh.mVertexOffset + (size_t)vertexCount * layout.getStride());
+	layout.pack(streams, vertices.data() + mesh.mVertexOffset);
+
+	mesh.mIndexOffset = (indexData.size() + 3) & ~(size_t)3;
+	indexData.resize(mesh.mIndexOffset + (size_t)mesh.mIndexCount * IndexLayout::getSize(indexType));
+	IndexLayout::pack(indices.data(), mesh.mIndexCount, indexType, indexData.data() + mesh.mIndexOffset);
+
+	return mesh;
+}
+
+void MeshCache::optimize(
+	std::vector<uint32_t>& indices,
+	std::vector<float>& positions,
+	std::vector<float>& normals,
+	std::vector<float>& uvs,
+	std::vector<float>& colors) const {
+
+	uint32_t vertexCount = (uint32_t)(positions.size() / 3);
+
+	// 1 Triangles, clusters are only needed for the overdraw pass
+	std::vector<uint32_t> clusters;
+	if (mOptimizeFlags & MeshOptimizer::VertexCache) {
+
+		bool overdraw = (mOptimizeFlags & MeshOptimizer::Overdraw) != 0;
+		MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertexCount, MeshOptimizer::CacheSize, overdraw ? &clusters : nullptr);
+
+		if (overdraw) {
+			MeshOptimizer::optimizeOverdraw(indices.data(), indices.size(), positions.data(), clusters);
+		}
+	}
+
+	// 2 Vertices in the order the triangles first read them
+	if (mOptimizeFlags & MeshOptimizer::VertexFetch) {
+
+		std::vector<uint32_t> remap;
+		MeshOptimizer::optimizeVertexFetch(indices.data(), indices.size(), vertexCount, remap);
+
+		MeshOptimizer::remapStream(positions.data(), 3, remap);
+		MeshOptimizer::remapStream(normals.data(), 3, remap);
+		MeshOptimizer::remapStream(uvs.data(), 2, remap);
+		if (!colors.empty()) {
+			MeshOptimizer::remapStream(colors.data(), 3, remap);
+		}
+	}
+}
+
+Geometry* MeshCache::createGeometry(uint32_t index) const {
+
+	const CachedMesh& mesh = mMeshes[index];
+
+	VertexLayout layout;
+	VertexLayout::decode(mesh.mLayout, layout);
+
+	return new Geometry(
+		layout,
+		mVertices + mesh.mVertexOffset,
+		mesh.mVertexCount,
+		mIndices + mesh.mIndexOffset,
+		mesh.mIndexCount,
+		mesh.mIndexType,
+		glm::vec3(mesh.mBoundingMin[0], mesh.mBoundingMin[1], mesh.mBoundingMin[2]),
+		glm::vec3(mesh.mBoundingMax[0], mesh.mBoundingMax[1], mesh.mBoundingMax[2]));
+}
+
+std::vector<GeometryLod> MeshCache::createLods(uint32_t index) const {
+
+	const CachedMesh& mesh = mMeshes[index];
+
+	std::vector<GeometryLod> lods(mesh.mLodCount);
+	for (uint32_t i = 0; i < mesh.mLodCount; i++) {
+
+		lods[i].mGeometry = createGeometry(mesh.mFirstLod + i);
+		lods[i].mError = mMeshes[mesh.mFirstLod + i].mError;
+	}
+
+	return lods;
+}
+
+std::vector<AtlasRect> MeshCache::planAtlas(const aiScene* scene, uint32_t& width, uint32_t& height) const {
+
+	std::vector<AtlasRect> rects(scene->mNumMaterials);
+	width = height = 0;
+
+	// 1 Materials whose every mesh samples inside the unit square, repeating uvs need their own texture
+	std::vector<uint8_t> inside(scene->mNumMaterials, 1);
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+
+		const aiMesh* aimesh = scene->mMeshes[i];
+		const aiVector3D* uvs = aimesh->mTextureCoords[0];
+		for (unsigned int v = 0; uvs != nullptr && v < aimesh->mNumVertices && inside[aimesh->mMaterialIndex]; v++) {
+
+			if (uvs[v].x < -0.001f || uvs[v].x > 1.001f || uvs[v].y < -0.001f || uvs[v].y > 1.001f) {
+				inside[aimesh->mMaterialIndex] = 0;
+			}
+		}
+	}
+
+	// 2 One image per distinct diffuse. A specular map would need the same layout, its material is left out,
+	// and so are raw embedded texels, which are BGRA
+	const int maxImage = MeshAtlasSize - 2 * MeshAtlasPadding;
+	TextureAtlas atlas(MeshAtlasSize, MeshAtlasPadding);
+	std::map<std::string, int> images;
+	std::vector<int> materialImages(scene->mNumMaterials, -1);
+
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+
+		const aiMaterial* aimat = scene->mMaterials[i];
+		aiString diffuse, specular;
+		aimat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), diffuse);
+		aimat->Get(AI_MATKEY_TEXTURE(aiTextureType_SPECULAR, 0), specular);
+		if (!inside[i] || !diffuse.length || specular.length) {
+			continue;
+		}
+
+		auto found = images.find(diffuse.C_Str());
+		if (found != images.end()) {
+			materialImages[i] = found->second;
+			continue;
+		}
+
+		int imageWidth = 0, imageHeight = 0, channels;
+		const aiTexture* aitexture = scene->GetEmbeddedTexture(diffuse.C_Str());
+		bool known = aitexture != nullptr ?
+			aitexture->mHeight == 0 && stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(aitexture->pcData), (int)aitexture->mWidth, &imageWidth, &imageHeight, &channels) :
+			stbi_info((mRootPath + diffuse.C_Str()).c_str(), &imageWidth, &imageHeight, &channels);
+
+		if (known && imageWidth <= maxImage && imageHeight <= maxImage) {
+
+			materialImages[i] = atlas.add(imageWidth, imageHeight);
+			images[diffuse.C_Str()] = materialImages[i];
+		}
+	}
+
+	// 3 An atlas of one image only adds padding
+	if (images.size() < 2 || !atlas.pack()) {
+		return rects;
+	}
+
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+		if (materialImages[i] >= 0) {
+			rects[i] = atlas.getRect(materialImages[i]);
+		}
+	}
+
+	width = (uint32_t)atlas.getWidth();
+	height = (uint32_t)atlas.getHeight();
+	return rects;
+}
+
+Texture* MeshCache::createDiffuse(const CachedMaterial& material, unsigned int unit) const {
+
+	if (material.mAtlasRect.mWidth > 0) {
+		return createAtlas(unit);
+	}
+	return createTexture(material.mDiffuse, unit);
+}
+
+Texture* MeshCache::createAtlas(unsigned int unit) const {
+
+	if (mAtlas != nullptr || mHeader == nullptr || mHeader->mAtlasWidth == 0) {
+		return mAtlas;
+	}
+
+	// 1 An earlier load of the same model already requested it
+	std::string key = mPath + ".atlas";
+	mAtlas = Texture::findTexture(key);
+	if (mAtlas != nullptr) {
+		return mAtlas;
+	}
+
+	// 2 Every packed image once, embedded ones copied out of the mapping the worker outlives
+	struct AtlasSource {
+		AtlasRect mRect{};
+		std::string mPath{};
+		std::vector<unsigned char> mEncoded{};	// empty for a file
+	};
+	std::vector<AtlasSource> sources;
+
+	for (uint32_t i = 0; i < mHeader->mMaterialCount; i++) {
+
+		const CachedMaterial& material = mMaterials[i];
+		bool first = material.mAtlasRect.mWidth > 0;
+		for (uint32_t j = 0; j < i && first; j++) {
+			first = mMaterials[j].mAtlasRect.mX != material.mAtlasRect.mX || mMaterials[j].mAtlasRect.mY != material.mAtlasRect.mY;
+		}
+		if (!first) {
+			continue;
+		}
+
+		const CachedTexture& texture = material.mDiffuse;
+		std::string name(reinterpret_cast<const char*>(mBlob + texture.mNameOffset), texture.mNameLength);
+
+		AtlasSource source;
+		source.mRect = material.mAtlasRect;
+		if ((CachedTextureKind)texture.mKind == CachedTextureKind::Embedded) {
+			source.mPath = name;
+			source.mEncoded.assign(mBlob + texture.mDataOffset, mBlob + texture.mDataOffset + texture.mDataSize);
+		}
+		else {
+			source.mPath = mRootPath + name;
+		}
+		sources.push_back(std::move(source));
+	}
+
+	// 3 Decoded and blitted on a TextureLoader worker, which flips rows like for single textures
+	int atlasWidth = (int)mHeader->mAtlasWidth, atlasHeight = (int)mHeader->mAtlasHeight;
+	TextureBuilder build = [sources = std::move(sources), atlasWidth, atlasHeight](std::vector<unsigned char>& texels, int& width, int& height) {
+
+		texels.assign((size_t)atlasWidth * atlasHeight * 4, 0);
+		width = atlasWidth;
+		height = atlasHeight;
+
+		for (const AtlasSource& source : sources) {
+
+			int imageWidth = 0, imageHeight = 0, channels;
+			unsigned char* image = !source.mEncoded.empty() ?
+				stbi_load_from_memory(source.mEncoded.data(), (int)source.mEncoded.size(), &imageWidth, &imageHeight, &channels, STBI_rgb_alpha) :
+				stbi_load(source.mPath.c_str(), &imageWidth, &imageHeight, &channels, STBI_rgb_alpha);
+
+			// A changed source keeps its rect gray until the cache is rebuilt
+			if (image == nullptr || imageWidth != source.mRect.mWidth || imageHeight != source.mRect.mHeight) {
+
+				std::cout << "Error: Atlas texture failed to load - " << source.mPath << std::endl;
+				std::vector<unsigned char> gray((size_t)source.mRect.mWidth * source.mRect.mHeight * 4, 128);
+				TextureAtlas::blit(source.mRect, MeshAtlasPadding, gray.data(), atlasWidth, texels);
+			}
+			else {
+				TextureAtlas::blit(source.mRect, MeshAtlasPadding, image, atlasWidth, texels);
+			}
+			stbi_image_free(image);
+		}
+		return true;
+	};
+
+	// 4 Filtered and uploaded like any other texture
+	mAtlas = Texture::createTextureFromBuilder(key, unit, std::move(build));
+	return mAtlas;
+}
+
+Texture* MeshCache::createTexture(const CachedTexture& texture, unsigned int unit) const {
+
+	std::string name(reinterpret_cast<const char*>(mBlob + texture.mNameOffset), texture.mNameLength);
+
+	switch ((CachedTextureKind)texture.mKind) {
+	case CachedTextureKind::File:
+		return Texture::createTexture(mRootPath + name, unit);
+	case CachedTextureKind::Embedded:
+		return Texture::createTextureFromMemory(
+			name,
+			unit,
+			const_cast<uint8_t*>(mBlob + texture.mDataOffset),
+			texture.mWidth,
+			texture.mHeight);
+	default:
+		return nullptr;
+	}
+}
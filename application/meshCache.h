@@ -0,0 +1,284 @@
+#pragma once
+#include "../glframework/core.h"
+#include "../glframework/object.h"
+#include "../glframework/geometry.h"
+#include "../glframework/mesh/mesh.h"
+#include "../glframework/texture.h"
+#include "../glframework/tools/mappedFile.h"
+#include "../glframework/tools/meshOptimizer.h"
+#include "../glframework/tools/meshSimplifier.h"
+#include "../glframework/tools/textureAtlas.h"
+
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include <cstdint>
+
+// Binary image of an Assimp import, written next to the source as <source>.meshcache.
+// Every section is a flat array of the structs below, addressed by byte offsets from the file start:
+//   header | nodes | node mesh refs | meshes | materials | vertices | indices | blob (names, embedded textures)
+// Simplified LODs are meshes of their own, stored after every source mesh.
+// Diffuse textures of materials whose meshes stay inside the unit square share one atlas,
+// the uvs of those meshes are remapped to their rect at import
+static const uint32_t MeshCacheVersion = 6;
+
+static const uint32_t MaxMeshLods = 4;
+
+static const int MeshAtlasSize = 4096;
+static const int MeshAtlasPadding = 4;
+
+enum class CachedTextureKind : uint32_t {
+	None = 0,
+	File = 1,		// path relative to the model folder
+	Embedded = 2	// encoded or raw texels in the blob
+};
+
+struct CachedTexture {
+	uint32_t mKind{ 0 };
+	uint32_t mNameOffset{ 0 };	// in the blob
+	uint32_t mNameLength{ 0 };
+	uint32_t mWidth{ 0 };		// Assimp convention, height 0 means mWidth bytes of an encoded image
+	uint32_t mHeight{ 0 };
+	uint32_t mDataSize{ 0 };
+	uint64_t mDataOffset{ 0 };	// in the blob
+};
+
+struct CachedMaterial {
+	CachedTexture mDiffuse{};
+	CachedTexture mSpecular{};
+	AtlasRect mAtlasRect{};			// of the diffuse, width 0 when it keeps its own texture
+};
+
+// Vertices are stored packed in their VertexLayout, ready for upload
+struct CachedMesh {
+	uint64_t mVertexOffset{ 0 };	// bytes into the vertex section
+	uint64_t mIndexOffset{ 0 };		// bytes into the index section
+	uint32_t mVertexCount{ 0 };
+	uint32_t mIndexCount{ 0 };
+	uint32_t mMaterial{ 0 };
+	uint32_t mLayout{ 0 };			// VertexLayout::encode
+	uint32_t mIndexType{ 0 };		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t mFirstLod{ 0 };		// into the meshes
+	uint32_t mLodCount{ 0 };
+	float mError{ 0.0f };			// simplification error of a LOD, mesh units
+	float mBoundingMin[3]{};
+	float mBoundingMax[3]{};
+};
+
+// Nodes are stored parents first, in the order the importer walked them
+struct CachedNode {
+	int32_t mParent{ -1 };
+	uint32_t mFirstMesh{ 0 };		// into the node mesh refs
+	uint32_t mMeshCount{ 0 };
+	float mPosition[3]{};
+	float mAngles[3]{};				// degrees
+	float mScale[3]{};
+};
+
+struct MeshCacheHeader {
+	char mMagic[8]{};
+	uint32_t mVersion{ 0 };
+	uint32_t mImportFlags{ 0 };
+	uint64_t mSourceHash{ 0 };
+	uint64_t mFileSize{ 0 };
+
+	uint32_t mNodeCount{ 0 };
+	uint32_t mMeshRefCount{ 0 };
+	uint32_t mMeshCount{ 0 };
+	uint32_t mMaterialCount{ 0 };
+	uint64_t mVertexSize{ 0 };		// bytes
+	uint64_t mIndexSize{ 0 };		// bytes
+	uint64_t mBlobSize{ 0 };
+
+	uint64_t mNodeOffset{ 0 };
+	uint64_t mMeshRefOffset{ 0 };
+	uint64_t mMeshOffset{ 0 };
+	uint64_t mMaterialOffset{ 0 };
+	uint64_t mVertexOffset{ 0 };
+	uint64_t mIndexOffset{ 0 };
+	uint64_t mBlobOffset{ 0 };
+
+	float mImportTime{ 0.0f };		// ms spent in Assimp when the cache was written
+	uint32_t mOptimizeFlags{ 0 };	// MeshOptimizer::Flags
+
+	// Post-transform cache of all meshes, weighted by triangles, before and after optimizing
+	VertexCacheStats mSourceCache{};
+	VertexCacheStats mOptimizedCache{};
+
+	// Triangle ratio of every generated LOD, finest first
+	uint32_t mLodCount{ 0 };
+	float mLodRatios[MaxMeshLods]{};
+	uint32_t mSourceMeshCount{ 0 };	// meshes of the model, their LODs follow
+
+	uint32_t mAtlasWidth{ 0 };		// 0 without an atlas
+	uint32_t mAtlasHeight{ 0 };
+};
+
+static_assert(sizeof(CachedTexture) == 32, "CachedTexture layout");
+static_assert(sizeof(CachedMesh) == 72, "CachedMesh layout");
+static_assert(sizeof(CachedNode) == 48, "CachedNode layout");
+static_assert(sizeof(CachedMaterial) == 80, "CachedMaterial layout");
+static_assert(sizeof(MeshCacheHeader) == 184, "MeshCacheHeader layout");
+
+// One LOD level summed over the meshes of a model
+struct MeshLodReport {
+	float mRatio{ 1.0f };			// requested
+	uint32_t mTriangles{ 0 };		// reached
+	float mError{ 0.0f };			// worst mesh, mesh units
+};
+
+// One model load of this run, both paths are timed so they can be compared
+struct MeshLoadReport {
+	std::string mPath{};
+	bool mCacheHit{ false };
+	float mLoadTime{ 0.0f };	// ms, hash + map or import + write
+	float mImportTime{ 0.0f };	// ms, Assimp import of this run or the one that wrote the cache
+	float mWriteTime{ 0.0f };	// ms, 0 on a hit
+	VertexCacheStats mSourceCache{};
+	VertexCacheStats mOptimizedCache{};
+	size_t mCacheSize{ 0 };		// bytes
+	uint32_t mTriangles{ 0 };	// source meshes
+	std::vector<MeshLodReport> mLods{};
+	uint32_t mAtlasImages{ 0 };	// diffuse textures packed into the atlas
+	uint32_t mAtlasWidth{ 0 };
+	uint32_t mAtlasHeight{ 0 };
+};
+
+class MeshCache {
+public:
+	MeshCache();
+	~MeshCache();
+
+	// Flags both Assimp loaders import with, part of the cache key so their cache files stay interchangeable
+	static const unsigned int DefaultImportFlags = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices;
+	static const unsigned int DefaultOptimizeFlags = MeshOptimizer::VertexCache | MeshOptimizer::Overdraw | MeshOptimizer::VertexFetch;
+
+	// Map the cache of path, imports with Assimp and rewrites the cache when it is missing
+	// or was written from another source file, import or optimize flags, LOD ratios or format version.
+	// Every mesh gets one simplified LOD per ratio of its triangles, at most MaxMeshLods
+	bool load(const std::string& path, unsigned int importFlags, unsigned int optimizeFlags, const std::vector<float>& lodRatios = {});
+
+	// Rebuild the node hierarchy under a new root, createMesh(meshIndex) makes one Mesh
+	template<typename MeshFactory>
+	Object* instantiate(MeshFactory&& createMesh) const;
+
+	const CachedMesh& getMesh(uint32_t index) const { return mMeshes[index]; }
+	const CachedMaterial& getMaterial(uint32_t index) const { return mMaterials[index]; }
+
+	// Geometry of one mesh, uploaded straight from the mapping
+	Geometry* createGeometry(uint32_t index) const;
+
+	// Simplified geometries of one mesh, finest first
+	std::vector<GeometryLod> createLods(uint32_t index) const;
+
+	// nullptr for a material without that texture
+	Texture* createTexture(const CachedTexture& texture, unsigned int unit) const;
+
+	// Diffuse of a material, the shared atlas when the material was packed into it
+	Texture* createDiffuse(const CachedMaterial& material, unsigned int unit) const;
+
+	// Shared atlas of the model, requested once. Its images are decoded and blitted on a TextureLoader worker
+	Texture* createAtlas(unsigned int unit) const;
+
+	static std::string getCachePath(const std::string& path) { return path + ".meshcache"; }
+
+	// Every load of this run, printed as they happen
+	static const std::vector<MeshLoadReport>& getReports() { return mReports; }
+
+private:
+	bool map(const std::string& cachePath);
+
+	// Import with Assimp, optimize every mesh and serialize into mBuffer
+	bool import(const std::string& path, float& importTime);
+
+	// Pack one mesh at the end of the vertex and index sections, colors may be empty.
+	// Atlas uvs keep Float2, half floats step 1/2048 near 1 and would round them across texels
+	static CachedMesh appendMesh(
+		const std::vector<uint32_t>& indices,
+		const std::vector<float>& positions,
+		const std::vector<float>& normals,
+		const std::vector<float>& uvs,
+		const std::vector<float>& colors,
+		bool atlasUvs,
+		std::vector<uint8_t>& vertices,
+		std::vector<uint8_t>& indexData);
+
+	// Reorder triangles and vertices of one mesh in place, streams hold 3 floats per vertex
+	// (2 for uvs), colors may be empty
+	void optimize(
+		std::vector<uint32_t>& indices,
+		std::vector<float>& positions,
+		std::vector<float>& normals,
+		std::vector<float>& uvs,
+		std::vector<float>& colors) const;
+
+	// Atlas rect of every material, none when fewer than two diffuse images qualify or they do not fit
+	std::vector<AtlasRect> planAtlas(const aiScene* scene, uint32_t& width, uint32_t& height) const;
+
+	// Point the section views at data, false when it is not a complete cache of this source
+	bool attach(const uint8_t* data, size_t size);
+
+	static void collectNodes(const aiNode* ainode, int32_t parent, std::vector<const aiNode*>& nodes, std::vector<int32_t>& parents);
+
+	static uint64_t hashFile(const std::string& path, bool& found);
+
+private:
+	MappedFile mFile{};
+	std::vector<uint8_t> mBuffer{};	// fresh import, used when the cache file cannot be mapped back
+
+	std::string mPath{};
+	std::string mRootPath{};
+	uint64_t mSourceHash{ 0 };
+	unsigned int mImportFlags{ 0 };
+	unsigned int mOptimizeFlags{ 0 };
+	std::vector<float> mLodRatios{};
+
+	const MeshCacheHeader* mHeader{ nullptr };
+	const CachedNode* mNodes{ nullptr };
+	const uint32_t* mMeshRefs{ nullptr };
+	const CachedMesh* mMeshes{ nullptr };
+	const CachedMaterial* mMaterials{ nullptr };
+	const uint8_t* mVertices{ nullptr };
+	const uint8_t* mIndices{ nullptr };
+	const uint8_t* mBlob{ nullptr };
+
+	mutable Texture* mAtlas{ nullptr };
+
+	static std::vector<MeshLoadReport> mReports;
+};
+
+template<typename MeshFactory>
+Object* MeshCache::instantiate(MeshFactory&& createMesh) const {
+
+	Object* root = new Object();
+	if (mHeader == nullptr) {
+		return root;
+	}
+
+	// Parents come first, so every parent exists when its children are linked
+	std::vector<Object*> objects(mHeader->mNodeCount, nullptr);
+	for (uint32_t i = 0; i < mHeader->mNodeCount; i++) {
+
+		const CachedNode& cached = mNodes[i];
+
+		// 1 Generate node and link parent
+		Object* node = new Object();
+		(cached.mParent >= 0 ? objects[cached.mParent] : root)->addChild(node);
+		objects[i] = node;
+
+		// 2 Local transformation, decomposed when the cache was written
+		node->setPosition(glm::vec3(cached.mPosition[0], cached.mPosition[1], cached.mPosition[2]));
+		node->setAngleX(cached.mAngles[0]);
+		node->setAngleY(cached.mAngles[1]);
+		node->setAngleZ(cached.mAngles[2]);
+		node->setScale(glm::vec3(cached.mScale[0], cached.mScale[1], cached.mScale[2]));
+
+		// 3 Meshes before child nodes, like the importer order
+		for (uint32_t j = 0; j < cached.mMeshCount; j++) {
+
+			node->addChild(createMesh(mMeshRefs[cached.mFirstMesh + j]));
+		}
+	}
+
+	return root;
+}
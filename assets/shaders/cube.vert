@@ -4,9 +4,17 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 uvw;
 
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
 
 out vec2 uv;
 out vec3 normal;
@@ -5,10 +5,15 @@ out vec4 FragColor;
 in vec2 uv;
 in vec3 normal;
 
-
-uniform float near;
-uniform float far;
-
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
 
 void main()
 {
@@ -7,6 +7,16 @@ in vec3 normal;
 in vec3 worldPosition;
 in vec2 worldXZ;
 
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
 uniform float opacity;
 
 uniform float uvScale;
@@ -18,13 +28,14 @@ uniform float cloudUVScale;
 uniform float cloudSpeed;
 uniform float cloudLerp;
 
-uniform float time;
 uniform vec3 windDirection;
 
-// 1 Texture
-uniform sampler2D sampler;
-uniform sampler2D opacityMask;
-uniform sampler2D cloudMask;
+// 1 Texture, diffuse layers in one array, opacity and cloud masks in a single channel one
+uniform sampler2DArray grassTextures;
+uniform sampler2DArray grassMasks;
+uniform int diffuseLayer;
+uniform int opacityLayer;
+uniform int cloudLayer;
 
 
 // 2 Lighting
@@ -44,9 +55,9 @@ struct DirectionalLight{
 	vec3 direction;
 	vec3 color;
 	float specularIntensity;
+	float intensity;
 };
 
-uniform DirectionalLight directionalLight;
 
 // 2.3 Point light
 struct PointLight{
@@ -60,16 +71,15 @@ struct PointLight{
 };
 
 // 2.4 Ambient light
-uniform vec3 ambientColor;
+layout(std140, binding = 1) uniform LightBlock {
+	DirectionalLight directionalLight;
+	vec3 ambientColor;
+};
 
 // 3 Material
 uniform float shiness;
 
-// 4 Camera
-uniform vec3 cameraPosition;
-
-
-// 5 Diffuse
+// 4 Diffuse
 vec3 calculateDiffuse(vec3 lightColor, vec3 objectColor, vec3 lightDir, vec3 normal){
 
 	float diffuse = clamp(dot(-lightDir, normal), 0.0f, 1.0f);
@@ -78,69 +88,69 @@ vec3 calculateDiffuse(vec3 lightColor, vec3 objectColor, vec3 lightDir, vec3 nor
 	return diffuseColor;
 }
 
-// 6 Specular
+// 5 Specular
 vec3 calculateSpecular(vec3 lightColor, vec3 lightDir, vec3 normal, vec3 viewDir, float intensity){
 
-	// 6.1 Remove the light from the back
+	// 5.1 Remove the light from the back
 	float dotResult = dot(-lightDir, normal);
 	float flag = step(0.0, dotResult);
 
-	// 6.2 Calculate reflection
+	// 5.2 Calculate reflection
 	vec3 lightReflect = normalize(reflect(lightDir, normal));
 	float specular = max(dot(lightReflect,-viewDir), 0.0);
 
-	// 6.3 Control the size
+	// 5.3 Control the size
 	specular = pow(specular, shiness);
 
 //	float specularMask = texture(specularMaskSampler, uv).r;
 
-	// 6.4 Calculate specular color
+	// 5.4 Calculate specular color
 	vec3 specularColor = lightColor * specular * flag * intensity;
 
 	return specularColor;
 }
 
-// 7 Spot light
+// 6 Spot light
 vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir){
 
-	// 7.1 Prepare variables
-	vec3 objectColor = texture(sampler, uv).xyz;
+	// 6.1 Prepare variables
+	vec3 objectColor = texture(grassTextures, vec3(uv, diffuseLayer)).xyz;
 	vec3 lightDir = normalize(worldPosition - light.position);
 	vec3 targetDir = normalize(light.targetDirection);
 
 	float cGamma = dot(lightDir, targetDir);
 	float intensity = clamp((cGamma - light.outerLine) / (light.innerLine - light.outerLine), 0.0, 1.0);
 
-	// 7.2 Diffuse reflection
+	// 6.2 Diffuse reflection
 	vec3 diffuseColor = calculateDiffuse(light.color, objectColor, lightDir, normal);
 
-	// 7.3 Specular
+	// 6.3 Specular
 	vec3 specularColor = calculateSpecular(light.color, lightDir, normal, viewDir, light.specularIntensity);
 
-	// 7.4 Firal result
+	// 6.4 Firal result
 	return (diffuseColor + specularColor) * intensity;
 }
 
-// 8 Directional light
+// 7 Directional light
 vec3 calculateDirectionalLight(vec3 objectColor, DirectionalLight light, vec3 normal, vec3 viewDir){
 	
 
-	// 7.1 Prepare variables
+	// 6.1 Prepare variables
 	vec3 lightDir = normalize(light.direction);
 
 
-	// 7.2 Diffuse reflection
+	// 6.2 Diffuse reflection
 	vec3 diffuseColor = calculateDiffuse(light.color, objectColor, lightDir, normal);
 
-	// 7.3 Specular
+	// 6.3 Specular
 	vec3 specularColor = calculateSpecular(light.color, lightDir, normal, viewDir, light.specularIntensity);
 
-	// 7.4 Firal result
+	// 6.4 Firal result
 	return diffuseColor + specularColor;
 
 }
 
-// 9 Point light
+// 8 Point light
 vec3 calculatePointLight(vec3 objectColor, PointLight light, vec3 normal, vec3 viewDir){
 	
 	vec3 lightDir = normalize(worldPosition - light.position);
@@ -148,10 +158,10 @@ vec3 calculatePointLight(vec3 objectColor, PointLight light, vec3 normal, vec3 v
 	float dist = length(worldPosition - light.position);
 	float attenuation = 1.0 / (light.k2 * dist * dist + light.k1 * dist + light.kc);
 
-	// 9.2 Diffuse reflection
+	// 8.2 Diffuse reflection
 	vec3 diffuseColor = calculateDiffuse(light.color, objectColor, lightDir, normal);
 
-	// 9.3 Specular
+	// 8.3 Specular
 	vec3 specularColor = calculateSpecular(light.color, lightDir, normal, viewDir, light.specularIntensity);
 
 	return (diffuseColor + specularColor) * attenuation;
@@ -163,7 +173,7 @@ void main()
 {
 	// Worldpositon as UV 
 	vec2 worldUV = worldXZ / uvScale;
-	vec3 objectColor  = texture(sampler, worldUV).xyz * brightness;
+	vec3 objectColor  = texture(grassTextures, vec3(worldUV, diffuseLayer)).xyz * brightness;
 
 	vec3 result = vec3(0.0, 0.0, 0.0);
 	
@@ -177,7 +187,7 @@ void main()
 	// 3 Ambient reflection
 	vec3 ambientColor = objectColor * ambientColor;
 
-	float alpha =  texture(opacityMask, uv).r;
+	float alpha =  textureLod(grassMasks, vec3(uv, opacityLayer), 0.0).r;
 	if(alpha == 0){
 		discard;
 	}
@@ -188,7 +198,7 @@ void main()
 	vec3 windDirN = normalize(windDirection);
 	vec2 cloudUV = worldXZ / cloudUVScale;
 	cloudUV = cloudUV + time * cloudSpeed * windDirN.xz;
-	float cloudMask = texture(cloudMask, cloudUV).r;
+	float cloudMask = texture(grassMasks, vec3(cloudUV, cloudLayer)).r;
 	vec3 cloudColor = mix(cloudBlackColor, cloudWhiteColor, cloudMask);
 
 	vec3 finalColor = mix(grassColor, cloudColor, cloudLerp);
@@ -2,25 +2,41 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aUV;
-layout (location = 2) in vec3 aNormal;
+layout (location = 2) in vec2 aNormal;
 layout (location = 3) in vec3 aColor;
 layout (location = 4) in mat4 aInstanceMatrix;
 
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
 
 out vec2 uv;
 out vec3 normal;
 out vec3 worldPosition;
 out vec2 worldXZ;
 
-uniform float time;
 
 uniform float windScale;
 uniform vec3 windDirection;
 uniform float phaseScale;
 
+// Octahedral normal of the packed vertex, see VertexLayout
+vec3 decodeNormal(vec2 octahedral)
+{
+    vec3 n = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main()
 {
     vec4 transformPosition = vec4(aPos, 1.0);
@@ -41,5 +57,5 @@ void main()
 
     uv = aUV;
 
-    normal = transpose(inverse(mat3(modelMatrix * aInstanceMatrix))) * aNormal;
+    normal = transpose(inverse(mat3(modelMatrix * aInstanceMatrix))) * decodeNormal(aNormal);
 }
\ No newline at end of file
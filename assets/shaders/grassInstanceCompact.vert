@@ -0,0 +1,82 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aUV;
+layout (location = 2) in vec2 aNormal;
+layout (location = 3) in vec3 aColor;
+
+// CompactInstance: half position and scale, normalized yaw
+layout (location = 4) in vec4 aInstancePositionScale;
+layout (location = 5) in vec2 aInstanceYaw;
+
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
+uniform mat4 modelMatrix;
+
+out vec2 uv;
+out vec3 normal;
+out vec3 worldPosition;
+out vec2 worldXZ;
+
+
+uniform float windScale;
+uniform vec3 windDirection;
+uniform float phaseScale;
+
+// Keep in sync with InstancedMesh::unpackInstance
+mat4 instanceMatrix(){
+
+    float yaw = aInstanceYaw.x * 6.28318530718;
+    float scale = aInstancePositionScale.w;
+
+    float c = cos(yaw) * scale;
+    float s = sin(yaw) * scale;
+
+    return mat4(
+        vec4(c, 0.0, -s, 0.0),
+        vec4(0.0, scale, 0.0, 0.0),
+        vec4(s, 0.0, c, 0.0),
+        vec4(aInstancePositionScale.xyz, 1.0));
+}
+
+// Octahedral normal of the packed vertex, see VertexLayout
+vec3 decodeNormal(vec2 octahedral)
+{
+    vec3 n = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    mat4 aInstanceMatrix = instanceMatrix();
+
+    vec4 transformPosition = vec4(aPos, 1.0);
+
+    // vec4 vertice world position
+    transformPosition = modelMatrix * aInstanceMatrix * transformPosition;
+    worldXZ = transformPosition.xz;
+
+    // Wind
+    vec3 windDirN = normalize(windDirection);
+    float phaseDistance = dot(windDirN, transformPosition.xyz);
+    transformPosition += vec4(sin(time + phaseDistance / phaseScale) * (1.0 - aColor.r) * windScale * windDirN, 0);
+
+    // vec3 vertice world position for fragment light calculation
+    worldPosition = transformPosition.xyz;
+
+    gl_Position = projectionMatrix * viewMatrix * transformPosition;
+
+    uv = aUV;
+
+    normal = transpose(inverse(mat3(modelMatrix * aInstanceMatrix))) * decodeNormal(aNormal);
+}
@@ -0,0 +1,114 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aUV;
+layout (location = 2) in vec2 aNormal;
+layout (location = 3) in vec3 aColor;
+
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
+uniform mat4 modelMatrix;
+
+out vec2 uv;
+out vec3 normal;
+out vec3 worldPosition;
+out vec2 worldXZ;
+
+
+uniform float windScale;
+uniform vec3 windDirection;
+uniform float phaseScale;
+
+// Placement
+uniform uint gridRows;
+uniform uint gridColumns;
+uniform float gridSpacing;
+uniform uint seed;
+uniform float maxYaw;
+
+uniform bool useDensityMap;
+uniform sampler2D densityMap;
+
+// PCG hash, the same id and seed always give the same blade
+uint hash(uint value){
+
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float random01(uint value){
+
+    return float(hash(value)) / 4294967295.0;
+}
+
+// Octahedral normal of the packed vertex, see VertexLayout
+vec3 decodeNormal(vec2 octahedral)
+{
+    vec3 n = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    // 1 Grid cell of this blade, same layout as the instanced field in main.cpp
+    uint id = uint(gl_InstanceID);
+    uint row = id / gridColumns;
+    uint column = id % gridColumns;
+
+    uint blade = hash(id ^ hash(seed));
+    float yaw = radians(random01(blade) * maxYaw);
+    float height = 1.0;
+
+    // 2 Density and height over the field
+    if(useDensityMap){
+
+        vec2 fieldUV = (vec2(row, column) + 0.5) / vec2(gridRows, gridColumns);
+        vec4 density = textureLod(densityMap, fieldUV, 0.0);
+
+        if(random01(blade + 1u) > density.r){
+
+            // Outside the clip volume, the whole blade is clipped
+            gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+            return;
+        }
+        height = density.g;
+    }
+
+    float c = cos(yaw);
+    float s = sin(yaw);
+    mat4 instanceMatrix = mat4(
+        vec4(c, 0.0, -s, 0.0),
+        vec4(0.0, height, 0.0, 0.0),
+        vec4(s, 0.0, c, 0.0),
+        vec4(float(row) * gridSpacing, 0.0, float(column) * gridSpacing, 1.0));
+
+    // 3 Same as grassInstance.vert from here
+    vec4 transformPosition = vec4(aPos, 1.0);
+
+    transformPosition = modelMatrix * instanceMatrix * transformPosition;
+    worldXZ = transformPosition.xz;
+
+    // Wind
+    vec3 windDirN = normalize(windDirection);
+    float phaseDistance = dot(windDirN, transformPosition.xyz);
+    transformPosition += vec4(sin(time + phaseDistance / phaseScale) * (1.0 - aColor.r) * windScale * windDirN, 0);
+
+    worldPosition = transformPosition.xyz;
+
+    gl_Position = projectionMatrix * viewMatrix * transformPosition;
+
+    uv = aUV;
+
+    normal = transpose(inverse(mat3(modelMatrix * instanceMatrix))) * decodeNormal(aNormal);
+}
@@ -0,0 +1,6 @@
+#version 460 core
+
+// Depth only, no color attachment
+void main()
+{
+}
@@ -0,0 +1,29 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
+// Same draws as phong.vert under POOL (binding 4)
+struct PoolDraw {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+	uint material;
+};
+
+layout(std430, binding = 4) readonly buffer PoolDraws {
+	PoolDraw poolDraws[];
+};
+
+void main()
+{
+    gl_Position = projectionMatrix * viewMatrix * poolDraws[gl_BaseInstance].modelMatrix * vec4(aPos, 1.0);
+}
@@ -6,14 +6,33 @@ in vec2 uv;
 in vec3 normal;
 in vec3 worldPosition;
 
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
+
 uniform float opacity;
 
-uniform float near;
-uniform float far;
 
 // 1 Texture
+#ifdef BINDLESS
+// Two resident handles per draw, written once per frame by the renderer (binding 3)
+layout(std430, binding = 3) readonly buffer TextureTable {
+	uvec4 textureHandles[];
+};
+uniform uint textureIndex;
+
+#define sampler sampler2D(textureHandles[textureIndex].xy)
+#define opacityMaskSampler sampler2D(textureHandles[textureIndex].zw)
+#else
 uniform sampler2D sampler;
 uniform sampler2D opacityMaskSampler;
+#endif
 
 // 2 Lighting
 // 2.1 Spot light
@@ -33,10 +52,9 @@ struct DirectionalLight{
 	vec3 direction;
 	vec3 color;
 	float specularIntensity;
-
+	float intensity;
 };
 
-uniform DirectionalLight directionalLight;
 
 // 2.3 Point light
 struct PointLight{
@@ -51,16 +69,15 @@ struct PointLight{
 
 
 // 2.4 Ambient light
-uniform vec3 ambientColor;
+layout(std140, binding = 1) uniform LightBlock {
+	DirectionalLight directionalLight;
+	vec3 ambientColor;
+};
 
 // 3 Material
 uniform float shiness;
 
-// 4 Camera
-uniform vec3 cameraPosition;
-
-
-// 5 Diffuse
+// 4 Diffuse
 vec3 calculateDiffuse(vec3 lightColor, vec3 objectColor, vec3 lightDir, vec3 normal){
 
 	float diffuse = clamp(dot(-lightDir, normal), 0.0f, 1.0f);
@@ -70,33 +87,33 @@ vec3 calculateDiffuse(vec3 lightColor, vec3 objectColor, vec3 lightDir, vec3 nor
 }
 
 
-// 6 Specular
+// 5 Specular
 vec3 calculateSpecular(vec3 lightColor, vec3 lightDir, vec3 normal, vec3 viewDir, float intensity){
 
-	// 6.1 Remove the light from the back
+	// 5.1 Remove the light from the back
 	float dotResult = dot(-lightDir, normal);
 	float flag = step(0.0, dotResult);
 
-	// 6.2 Calculate reflection
+	// 5.2 Calculate reflection
 	vec3 lightReflect = normalize(reflect(lightDir, normal));
 	float specular = max(dot(lightReflect,-viewDir), 0.0);
 
-	// 6.3 Control the size
+	// 5.3 Control the size
 	specular = pow(specular, shiness);
 
 //	float specularMask = texture(specularMaskSampler, uv).r;
 
-	// 6.4 Calculate specular color
+	// 5.4 Calculate specular color
 	vec3 specularColor = lightColor * specular * flag * intensity;
 
 	return specularColor;
 }
 
 
-// 7 Spot light
+// 6 Spot light
 vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir){
 
-	// 7.1 Prepare variables
+	// 6.1 Prepare variables
 	vec3 objectColor = texture(sampler, uv).xyz;
 	vec3 lightDir = normalize(worldPosition - light.position);
 	vec3 targetDir = normalize(light.targetDirection);
@@ -104,37 +121,37 @@ vec3 calculateSpotLight(SpotLight light, vec3 normal, vec3 viewDir){
 	float cGamma = dot(lightDir, targetDir);
 	float intensity = clamp((cGamma - light.outerLine) / (light.innerLine - light.outerLine), 0.0, 1.0);
 
-	// 7.2 Diffuse reflection
+	// 6.2 Diffuse reflection
 	vec3 diffuseColor = calculateDiffuse(light.color, objectColor, lightDir, normal);
 
-	// 7.3 Specular
+	// 6.3 Specular
 	vec3 specularColor = calculateSpecular(light.color, lightDir, normal, viewDir, light.specularIntensity);
 
-	// 7.4 Firal result
+	// 6.4 Firal result
 	return (diffuseColor + specularColor) * intensity;
 }
 
 
-// 8 Directional light
+// 7 Directional light
 vec3 calculateDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir){
 	
-	// 7.1 Prepare variables
+	// 6.1 Prepare variables
 	vec3 objectColor = texture(sampler, uv).xyz;
 	vec3 lightDir = normalize(light.direction);
 
 
-	// 7.2 Diffuse reflection
+	// 6.2 Diffuse reflection
 	vec3 diffuseColor = calculateDiffuse(light.color, objectColor, lightDir, normal);
 
-	// 7.3 Specular
+	// 6.3 Specular
 	vec3 specularColor = calculateSpecular(light.color, lightDir, normal, viewDir, light.specularIntensity);
 
-	// 7.4 Firal result
+	// 6.4 Firal result
 	return diffuseColor + specularColor;
 
 }
 
-// 9 Point light
+// 8 Point light
 vec3 calculatePointLight(PointLight light, vec3 normal, vec3 viewDir){
 	
 	vec3 objectColor = texture(sampler, uv).xyz;
@@ -143,10 +160,10 @@ vec3 calculatePointLight(PointLight light, vec3 normal, vec3 viewDir){
 	float dist = length(worldPosition - light.position);
 	float attenuation = 1.0 / (light.k2 * dist * dist + light.k1 * dist + light.kc);
 
-	// 9.2 Diffuse reflection
+	// 8.2 Diffuse reflection
 	vec3 diffuseColor = calculateDiffuse(light.color, objectColor, lightDir, normal);
 
-	// 9.3 Specular
+	// 8.3 Specular
 	vec3 specularColor = calculateSpecular(light.color, lightDir, normal, viewDir, light.specularIntensity);
 
 	return (diffuseColor + specularColor) * attenuation;
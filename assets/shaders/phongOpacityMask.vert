@@ -2,18 +2,34 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aUV;
-layout (location = 2) in vec3 aNormal;
+layout (location = 2) in vec2 aNormal;
+
+// Per frame data, written once by the renderer (binding 0)
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	vec3 cameraPosition;
+	float time;
+	float near;
+	float far;
+};
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
 uniform mat3 normalMatrix;
 
 out vec2 uv;
 out vec3 normal;
 out vec3 worldPosition;
 
-uniform float time;
+
+// Octahedral normal of the packed vertex, see VertexLayout
+vec3 decodeNormal(vec2 octahedral)
+{
+    vec3 n = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
@@ -29,5 +45,5 @@ void main()
 
     uv = aUV;
 
-    normal = normalMatrix * aNormal;
+    normal = normalMatrix * decodeNormal(aNormal);
 }
\ No newline at end of file
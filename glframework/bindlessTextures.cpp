@@ -0,0 +1,96 @@
+#include "bindlessTextures.h"
+#include <cstring>
+
+typedef GLuint64(APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef GLuint64(APIENTRYP PFNGLGETTEXTURESAMPLERHANDLEARBPROC)(GLuint texture, GLuint sampler);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+
+static PFNGLGETTEXTUREHANDLEARBPROC getTextureHandle = nullptr;
+static PFNGLGETTEXTURESAMPLERHANDLEARBPROC getTextureSamplerHandle = nullptr;
+static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC makeTextureHandleResident = nullptr;
+static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC makeTextureHandleNonResident = nullptr;
+
+std::map<uint64_t, GLuint64> BindlessTextures::mHandles{};
+
+bool BindlessTextures::isSupported() {
+
+	static int supported = -1;
+	if (supported >= 0) {
+		return supported == 1;
+	}
+
+	supported = 0;
+
+	// 1 Extension string, Mesa software drivers do not expose it
+	bool found = false;
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+
+		const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (name != nullptr && std::strcmp(name, "GL_ARB_bindless_texture") == 0) {
+			found = true;
+			break;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	// 2 Entry points
+	getTextureHandle = (PFNGLGETTEXTUREHANDLEARBPROC)glfwGetProcAddress("glGetTextureHandleARB");
+	getTextureSamplerHandle = (PFNGLGETTEXTURESAMPLERHANDLEARBPROC)glfwGetProcAddress("glGetTextureSamplerHandleARB");
+	makeTextureHandleResident = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleResidentARB");
+	makeTextureHandleNonResident = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+
+	if (getTextureHandle != nullptr && getTextureSamplerHandle != nullptr &&
+		makeTextureHandleResident != nullptr && makeTextureHandleNonResident != nullptr) {
+		supported = 1;
+	}
+
+	return supported == 1;
+}
+
+GLuint64 BindlessTextures::acquire(GLuint texture, GLuint sampler) {
+
+	if (texture == 0 || !isSupported()) {
+		return 0;
+	}
+
+	uint64_t key = makeKey(texture, sampler);
+	auto iter = mHandles.find(key);
+	if (iter != mHandles.end()) {
+		return iter->second;
+	}
+
+	GLuint64 handle = sampler != 0 ? getTextureSamplerHandle(texture, sampler) : getTextureHandle(texture);
+	if (handle != 0) {
+
+		makeTextureHandleResident(handle);
+		mHandles[key] = handle;
+	}
+
+	return handle;
+}
+
+void BindlessTextures::release(GLuint texture) {
+
+	if (mHandles.empty()) {
+		return;
+	}
+
+	auto first = mHandles.lower_bound(makeKey(texture, 0));
+	auto last = mHandles.lower_bound(makeKey(texture + 1, 0));
+	for (auto iter = first; iter != last; ++iter) {
+		makeTextureHandleNonResident(iter->second);
+	}
+
+	mHandles.erase(first, last);
+}
+
+const char* BindlessTextures::getShaderDefines() {
+
+	return "#extension GL_ARB_bindless_texture : require\n#define BINDLESS\n";
+}
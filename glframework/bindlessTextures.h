@@ -0,0 +1,31 @@
+#pragma once
+#include "core.h"
+#include <cstdint>
+
+// GL_ARB_bindless_texture. glad is generated without the extension, so the entry points
+// are loaded here through glfwGetProcAddress. A handle is created once per texture and
+// sampler pair and stays resident until the texture is deleted. Creating it freezes the
+// parameters of both, textures whose sampler is edited at runtime must stay on bind()
+class BindlessTextures {
+public:
+	// Extension present and every entry point loaded, checked once on the GL thread
+	static bool isSupported();
+
+	// Resident handle sampling texture through sampler, or its own parameters when sampler is 0
+	static GLuint64 acquire(GLuint texture, GLuint sampler);
+
+	// Every handle of texture made non resident, before the texture is deleted
+	static void release(GLuint texture);
+
+	static unsigned int getResidentCount() { return (unsigned int)mHandles.size(); }
+
+	// Prefix for Shader, enables the extension and the BINDLESS branch of the shaders
+	static const char* getShaderDefines();
+
+private:
+	static uint64_t makeKey(GLuint texture, GLuint sampler) { return ((uint64_t)texture << 32) | sampler; }
+
+private:
+	// Ordered by texture first, release() erases one range
+	static std::map<uint64_t, GLuint64> mHandles;
+};
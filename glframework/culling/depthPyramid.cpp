@@ -0,0 +1,215 @@
+#include "depthPyramid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+DepthPyramid::DepthPyramid(int width, int height) {
+
+	// Halved and floored down to 1x1
+	int levelWidth = std::max(width, 1);
+	int levelHeight = std::max(height, 1);
+	while (true) {
+
+		Level level;
+		level.mWidth = levelWidth;
+		level.mHeight = levelHeight;
+		level.mDepths.assign((size_t)levelWidth * levelHeight, 1.0f);
+		mLevels.push_back(std::move(level));
+
+		if (levelWidth == 1 && levelHeight == 1) {
+			break;
+		}
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+}
+
+DepthPyramid::~DepthPyramid() {}
+
+void DepthPyramid::clear() {
+
+	std::fill(mLevels[0].mDepths.begin(), mLevels[0].mDepths.end(), 1.0f);
+	mStats = DepthPyramidStats();
+}
+
+void DepthPyramid::rasterize(const glm::vec3* positions, const uint32_t* indices, uint32_t indexCount, const glm::mat4& matrix) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Level& level = mLevels[0];
+	float width = (float)level.mWidth;
+	float height = (float)level.mHeight;
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+
+		// 1 Window coordinates, nothing is clipped
+		glm::vec3 window[3];
+		bool skip = false;
+		for (int k = 0; k < 3; k++) {
+
+			glm::vec4 clip = matrix * glm::vec4(positions[indices[i + k]], 1.0f);
+			if (clip.w <= 1e-6f || clip.z < -clip.w) {
+				skip = true;
+				break;
+			}
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			window[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+		}
+
+		if (skip) {
+			continue;
+		}
+
+		// 2 Both windings, occluders are double sided
+		auto edge = [](const glm::vec3& a, const glm::vec3& b, float x, float y) {
+			return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+		};
+
+		float area = edge(window[0], window[1], window[2].x, window[2].y);
+		if (std::fabs(area) < 1e-12f) {
+			continue;
+		}
+
+		float sign = area > 0.0f ? 1.0f : -1.0f;
+		float inverseArea = 1.0f / area;
+
+		// 3 Pixel centers inside the screen bounds of the triangle
+		float minX = std::min(window[0].x, std::min(window[1].x, window[2].x));
+		float maxX = std::max(window[0].x, std::max(window[1].x, window[2].x));
+		float minY = std::min(window[0].y, std::min(window[1].y, window[2].y));
+		float maxY = std::max(window[0].y, std::max(window[1].y, window[2].y));
+
+		int x0 = std::max((int)std::ceil(minX - 0.5f), 0);
+		int x1 = std::min((int)std::floor(maxX - 0.5f), level.mWidth - 1);
+		int y0 = std::max((int)std::ceil(minY - 0.5f), 0);
+		int y1 = std::min((int)std::floor(maxY - 0.5f), level.mHeight - 1);
+
+		mStats.mTriangles++;
+
+		for (int y = y0; y <= y1; y++) {
+
+			float py = (float)y + 0.5f;
+			float* row = &level.mDepths[(size_t)y * level.mWidth];
+
+			for (int x = x0; x <= x1; x++) {
+
+				float px = (float)x + 0.5f;
+				float w0 = edge(window[1], window[2], px, py);
+				float w1 = edge(window[2], window[0], px, py);
+				float w2 = edge(window[0], window[1], px, py);
+				if (w0 * sign < 0.0f || w1 * sign < 0.0f || w2 * sign < 0.0f) {
+					continue;
+				}
+
+				// Window depth is affine in screen space
+				float depth = (w0 * window[0].z + w1 * window[1].z + w2 * window[2].z) * inverseArea;
+				if (depth < row[x]) {
+					row[x] = depth;
+				}
+			}
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.mRasterTime += std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void DepthPyramid::build() {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (size_t l = 1; l < mLevels.size(); l++) {
+
+		const Level& source = mLevels[l - 1];
+		Level& target = mLevels[l];
+
+		for (int y = 0; y < target.mHeight; y++) {
+
+			// The last row also covers the odd leftover one
+			int sy0 = y * 2;
+			int sy1 = y == target.mHeight - 1 ? source.mHeight - 1 : std::min(sy0 + 1, source.mHeight - 1);
+
+			for (int x = 0; x < target.mWidth; x++) {
+
+				int sx0 = x * 2;
+				int sx1 = x == target.mWidth - 1 ? source.mWidth - 1 : std::min(sx0 + 1, source.mWidth - 1);
+
+				float farthest = 0.0f;
+				for (int sy = sy0; sy <= sy1; sy++) {
+					for (int sx = sx0; sx <= sx1; sx++) {
+						farthest = std::max(farthest, source.mDepths[(size_t)sy * source.mWidth + sx]);
+					}
+				}
+
+				target.mDepths[(size_t)y * target.mWidth + x] = farthest;
+			}
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.mBuildTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+bool DepthPyramid::isOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix) const {
+
+	const Level& base = mLevels[0];
+
+	// 1 Screen rectangle and nearest depth of the corners
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+	float nearest = 1.0f;
+
+	for (int i = 0; i < 8; i++) {
+
+		glm::vec3 corner(
+			(i & 1) ? boundsMax.x : boundsMin.x,
+			(i & 2) ? boundsMax.y : boundsMin.y,
+			(i & 4) ? boundsMax.z : boundsMin.z);
+
+		glm::vec4 clip = matrix * glm::vec4(corner, 1.0f);
+		if (clip.w <= 1e-6f || clip.z < -clip.w) {
+			return false;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float x = (ndc.x * 0.5f + 0.5f) * (float)base.mWidth;
+		float y = (ndc.y * 0.5f + 0.5f) * (float)base.mHeight;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX > (float)base.mWidth || minY > (float)base.mHeight) {
+		return false;
+	}
+
+	// 2 Every pixel the rectangle touches, a superset of the centers it covers
+	int x0 = glm::clamp((int)std::floor(minX), 0, base.mWidth - 1);
+	int x1 = glm::clamp((int)std::floor(maxX), 0, base.mWidth - 1);
+	int y0 = glm::clamp((int)std::floor(minY), 0, base.mHeight - 1);
+	int y1 = glm::clamp((int)std::floor(maxY), 0, base.mHeight - 1);
+
+	// 3 Coarsest level where the rectangle spans at most 2x2 texels
+	int level = 0;
+	while (level < (int)mLevels.size() - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+		level++;
+	}
+
+	const Level& coarse = mLevels[level];
+	int tx0 = std::min(x0 >> level, coarse.mWidth - 1);
+	int tx1 = std::min(x1 >> level, coarse.mWidth - 1);
+	int ty0 = std::min(y0 >> level, coarse.mHeight - 1);
+	int ty1 = std::min(y1 >> level, coarse.mHeight - 1);
+
+	float farthest = 0.0f;
+	for (int y = ty0; y <= ty1; y++) {
+		for (int x = tx0; x <= tx1; x++) {
+			farthest = std::max(farthest, coarse.mDepths[(size_t)y * coarse.mWidth + x]);
+		}
+	}
+
+	return nearest > farthest;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../core.h"
+#include <cstdint>
+
+struct DepthPyramidStats {
+	unsigned int mTriangles{ 0 };	// occluder triangles rasterized since clear()
+	float mRasterTime{ 0.0f };		// ms
+	float mBuildTime{ 0.0f };		// ms
+};
+
+// Software hierarchical Z. Occluders are rasterized at pixel centers into a small depth buffer,
+// every level above keeps the farthest depth of the texels it covers. Depths are window space,
+// 0 near and 1 far, rows bottom up, same as the GPU pyramid of HiZCuller.
+// Keep isOccluded() in sync with assets/shaders/instanceCull.comp
+class DepthPyramid {
+
+public:
+	DepthPyramid(int width = 256, int height = 128);
+	~DepthPyramid();
+
+	// Level 0 back to the far plane
+	void clear();
+
+	// Triangles of positions, clip = matrix * position. Triangles reaching behind the near plane
+	// are skipped, which only loses occlusion
+	void rasterize(const glm::vec3* positions, const uint32_t* indices, uint32_t indexCount, const glm::mat4& matrix);
+
+	// Max reduce level 0 into the chain, the last texel of an odd row or column takes the extra one
+	void build();
+
+	// True when the box, clip = matrix * corner, is farther than the occluders at every pixel it
+	// can cover. Boxes crossing the near plane or leaving the screen are never occluded
+	bool isOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix) const;
+
+	int getWidth() const { return mLevels[0].mWidth; }
+	int getHeight() const { return mLevels[0].mHeight; }
+	int getLevelCount() const { return (int)mLevels.size(); }
+	float getDepth(int level, int x, int y) const { return mLevels[level].mDepths[(size_t)y * mLevels[level].mWidth + x]; }
+
+	const DepthPyramidStats& getStats() const { return mStats; }
+
+private:
+	struct Level {
+		int mWidth{ 0 };
+		int mHeight{ 0 };
+		std::vector<float> mDepths{};
+	};
+
+	std::vector<Level> mLevels{};
+
+	DepthPyramidStats mStats{};
+};
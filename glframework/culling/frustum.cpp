@@ -0,0 +1,55 @@
+#include "frustum.h"
+
+Frustum::Frustum() {}
+
+Frustum::~Frustum() {}
+
+void Frustum::setFromMatrix(const glm::mat4& viewProjection) {
+
+	// Gribb-Hartmann: combine the rows of the clip matrix
+	glm::mat4 m = glm::transpose(viewProjection);
+
+	mPlanes[0] = m[3] + m[0];
+	mPlanes[1] = m[3] - m[0];
+	mPlanes[2] = m[3] + m[1];
+	mPlanes[3] = m[3] - m[1];
+	mPlanes[4] = m[3] + m[2];
+	mPlanes[5] = m[3] - m[2];
+
+	for (int i = 0; i < 6; i++) {
+
+		mPlanes[i] /= glm::length(glm::vec3(mPlanes[i]));
+	}
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+
+	for (int i = 0; i < 6; i++) {
+
+		if (glm::dot(glm::vec3(mPlanes[i]), center) + mPlanes[i].w < -radius) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+
+	for (int i = 0; i < 6; i++) {
+
+		// Test the box corner furthest along the plane normal
+		glm::vec3 normal = glm::vec3(mPlanes[i]);
+		glm::vec3 positive{
+			normal.x >= 0.0f ? boxMax.x : boxMin.x,
+			normal.y >= 0.0f ? boxMax.y : boxMin.y,
+			normal.z >= 0.0f ? boxMax.z : boxMin.z
+		};
+
+		if (glm::dot(normal, positive) + mPlanes[i].w < 0.0f) {
+			return false;
+		}
+	}
+
+	return true;
+}
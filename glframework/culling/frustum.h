@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../core.h"
+
+class Frustum {
+
+public:
+	Frustum();
+	~Frustum();
+
+	// Extract the six clip planes from a view-projection matrix
+	void setFromMatrix(const glm::mat4& viewProjection);
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const;
+	bool intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	const glm::vec4* getPlanes() const { return mPlanes; }
+
+private:
+	// Order: left, right, bottom, top, near, far. Normals point inside
+	glm::vec4 mPlanes[6];
+};
@@ -0,0 +1,158 @@
+#include "hiZCuller.h"
+#include "../renderer/meshPool.h"
+#include "../glStateCache.h"
+#include "../../wrapper/checkError.h"
+#include <algorithm>
+
+static const int DOWNSAMPLE_GROUP_SIZE = 8;
+
+HiZCuller::HiZCuller(int width, int height) {
+
+	mWidth = std::max(width, 1);
+	mHeight = std::max(height, 1);
+
+	// Halved and floored down to 1x1, the chain of DepthPyramid
+	mLevels = 1;
+	for (int w = mWidth, h = mHeight; w > 1 || h > 1; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+		mLevels++;
+	}
+
+	// 1 Occluder depth target, no color
+	glGenTextures(1, &mDepthTexture);
+	GLStateCache::bindTexture(HiZPyramidUnit, GL_TEXTURE_2D, mDepthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, mWidth, mHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenFramebuffers(1, &mFbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "Error:HiZ framebuffer is not complete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// 2 Pyramid, every level written by the downsample pass
+	glGenTextures(1, &mPyramidTexture);
+	GLStateCache::bindTexture(HiZPyramidUnit, GL_TEXTURE_2D, mPyramidTexture);
+	glTexStorage2D(GL_TEXTURE_2D, mLevels, GL_R32F, mWidth, mHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// 3 Occluded instance counter
+	GLuint zero = 0;
+	glGenBuffers(1, &mStatsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	mOccluderShader = new Shader("assets/shaders/hizOccluder.vert", "assets/shaders/hizOccluder.frag");
+	mDownsampleShader = new Shader("assets/shaders/hizDownsample.comp");
+}
+
+HiZCuller::~HiZCuller() {
+
+	delete mOccluderShader;
+	delete mDownsampleShader;
+
+	GLStateCache::forgetTexture(mDepthTexture);
+	GLStateCache::forgetTexture(mPyramidTexture);
+	glDeleteFramebuffers(1, &mFbo);
+	glDeleteTextures(1, &mDepthTexture);
+	glDeleteTextures(1, &mPyramidTexture);
+	glDeleteBuffers(1, &mStatsBuffer);
+}
+
+void HiZCuller::build(MeshPool* pool, const glm::mat4& viewProjection, GLuint fbo) {
+
+	mViewProjection = viewProjection;
+
+	// 1 Last frame's counter, its dispatches are long finished, then start counting again
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffer);
+	if (mCounting) {
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &mOccludedInstances);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	mCounting = true;
+
+	// 2 Occluder depth, both faces so open meshes still occlude
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFbo);
+	glViewport(0, 0, mWidth, mHeight);
+
+	GLStateCache::enable(GL_DEPTH_TEST);
+	GLStateCache::depthFunc(GL_LESS);
+	GLStateCache::depthMask(GL_TRUE);
+	GLStateCache::disable(GL_CULL_FACE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	const auto& batches = pool->getBatches();
+	if (!batches.empty()) {
+
+		mOccluderShader->begin();
+		pool->bind();
+		for (const auto& batch : batches) {
+			pool->draw(batch);
+		}
+		mOccluderShader->end();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// 3 Level 0 copies the depth, each level after reduces the one below
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	mDownsampleShader->begin();
+	mDownsampleShader->setInt("depthTexture", 0);
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, mDepthTexture);
+	GLStateCache::bindSampler(0, 0);
+
+	int sourceWidth = mWidth, sourceHeight = mHeight;
+	int targetWidth = mWidth, targetHeight = mHeight;
+	for (int level = 0; level < mLevels; level++) {
+
+		if (level > 0) {
+			sourceWidth = targetWidth;
+			sourceHeight = targetHeight;
+			targetWidth = std::max(targetWidth / 2, 1);
+			targetHeight = std::max(targetHeight / 2, 1);
+		}
+
+		glBindImageTexture(0, mPyramidTexture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, mPyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		mDownsampleShader->setInt("level", level);
+		mDownsampleShader->setIntVector2("sourceSize", sourceWidth, sourceHeight);
+		mDownsampleShader->setIntVector2("targetSize", targetWidth, targetHeight);
+
+		glDispatchCompute(
+			(targetWidth + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE,
+			(targetHeight + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE,
+			1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	// 4 The cull pass samples the pyramid
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	mDownsampleShader->end();
+}
+
+void HiZCuller::apply(Shader* cullShader) const {
+
+	GLStateCache::bindTexture(HiZPyramidUnit, GL_TEXTURE_2D, mPyramidTexture);
+	GLStateCache::bindSampler(HiZPyramidUnit, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HiZStatsBinding, mStatsBuffer);
+
+	cullShader->setInt("depthPyramid", HiZPyramidUnit);
+	cullShader->setMatrix4x4("viewProjection", mViewProjection);
+	cullShader->setIntVector2("pyramidSize", mWidth, mHeight);
+	cullShader->setInt("pyramidLevels", mLevels);
+}
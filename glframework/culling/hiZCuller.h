@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../core.h"
+#include "../shader.h"
+
+class MeshPool;
+
+// Shader storage binding of the occluded instance counter, past the mesh pool
+static const GLuint HiZStatsBinding = 6;
+
+// Texture unit of the pyramid while instanceCull.comp runs
+static const unsigned int HiZPyramidUnit = 7;
+
+// GPU hierarchical Z. The pooled static meshes are drawn depth only into a small target, the
+// pyramid keeps the farthest depth per texel and instanceCull.comp tests every instance against it.
+// Same size, depth convention and reduction as DepthPyramid, which serves the CPU issued draws
+class HiZCuller {
+
+public:
+	HiZCuller(int width = 256, int height = 128);
+	~HiZCuller();
+
+	// Occluder pass of the prepared pool and the max reduction. The framebuffer, viewport and depth
+	// state of the caller are restored to fbo, the viewport and the depth state of the frame
+	void build(MeshPool* pool, const glm::mat4& viewProjection, GLuint fbo);
+
+	// Pyramid, matrices and counter for the cull program, which must be in use
+	void apply(Shader* cullShader) const;
+
+	// Instances rejected by occlusion during the previous frame, read back without a stall
+	unsigned int getOccludedInstances() const { return mOccludedInstances; }
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+
+private:
+	int mWidth{ 0 };
+	int mHeight{ 0 };
+	int mLevels{ 0 };
+
+	GLuint mFbo{ 0 };
+	GLuint mDepthTexture{ 0 };
+	GLuint mPyramidTexture{ 0 };
+	GLuint mStatsBuffer{ 0 };
+
+	Shader* mOccluderShader{ nullptr };
+	Shader* mDownsampleShader{ nullptr };
+
+	glm::mat4 mViewProjection{ 1.0f };
+	unsigned int mOccludedInstances{ 0 };
+	bool mCounting{ false };	// the counter holds a frame that was not read back yet
+};
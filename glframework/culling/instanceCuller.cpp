@@ -0,0 +1,129 @@
+#include "instanceCuller.h"
+#include <algorithm>
+#include <cstddef>
+
+static const unsigned int CULL_GROUP_SIZE = 256;
+
+InstanceCuller::InstanceCuller() {
+
+	mCullShader = new Shader("assets/shaders/instanceCull.comp");
+}
+
+InstanceCuller::~InstanceCuller() {
+
+	delete mCullShader;
+}
+
+void InstanceCuller::cull(InstancedMesh* mesh, const Frustum& frustum, float boundsMargin, const HiZCuller* occlusion) {
+
+	// 1 Reset the instance count of the indirect command
+	GLuint zero = 0;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mesh->mIndirectBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(GLuint), &zero);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// 2 Bind input, output and command buffers
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, mesh->getMatrixBuffer(), mesh->getMatrixOffset(), sizeof(glm::mat4) * mesh->mInstanceCount);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mesh->mCulledMatrixVbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mesh->mIndirectBuffer);
+
+	// 3 Uniform
+	mCullShader->begin();
+	mCullShader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
+	mCullShader->setVector4Array("frustumPlanes", frustum.getPlanes(), 6);
+	mCullShader->setVector4("boundingSphere", mesh->mGeometry->getBoundingSphere());
+	mCullShader->setFloat("boundsMargin", boundsMargin);
+	mCullShader->setUnsignedInt("instanceTotal", mesh->mInstanceCount);
+
+	// 3.1 Pyramid and counter of the occlusion test
+	mCullShader->setInt("useOcclusion", occlusion != nullptr ? 1 : 0);
+	if (occlusion != nullptr) {
+		occlusion->apply(mCullShader);
+	}
+
+	// 4 Dispatch and make the result visible to the draw
+	glDispatchCompute((mesh->mInstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	mCullShader->end();
+}
+
+unsigned int InstanceCuller::readVisibleCount(InstancedMesh* mesh) {
+
+	DrawElementsIndirectCommand command;
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mesh->mIndirectBuffer);
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand), &command);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	return command.instanceCount;
+}
+
+unsigned int InstanceCuller::cullCPU(
+	InstancedMesh* mesh,
+	const Frustum& frustum,
+	float boundsMargin,
+	std::vector<glm::mat4>& visibleMatrices,
+	const DepthPyramid* occlusion,
+	const glm::mat4& viewProjection) {
+
+	visibleMatrices.clear();
+
+	glm::mat4 modelMatrix = mesh->getModelMatrix();
+	glm::vec4 boundingSphere = mesh->mGeometry->getBoundingSphere();
+
+	for (unsigned int i = 0; i < mesh->mInstanceCount; i++) {
+
+		glm::mat4 worldMatrix = modelMatrix * mesh->mInstanceMatrices[i];
+		if (!isInstanceVisible(worldMatrix, boundingSphere, boundsMargin, frustum)) {
+			continue;
+		}
+
+		// The box around the sphere, same as instanceCull.comp
+		if (occlusion != nullptr) {
+
+			glm::vec3 center;
+			float radius;
+			instanceSphere(worldMatrix, boundingSphere, boundsMargin, center, radius);
+
+			if (occlusion->isOccluded(center - glm::vec3(radius), center + glm::vec3(radius), viewProjection)) {
+				continue;
+			}
+		}
+
+		visibleMatrices.push_back(mesh->mInstanceMatrices[i]);
+	}
+
+	return (unsigned int)visibleMatrices.size();
+}
+
+bool InstanceCuller::isInstanceVisible(
+	const glm::mat4& worldMatrix,
+	const glm::vec4& boundingSphere,
+	float boundsMargin,
+	const Frustum& frustum) {
+
+	// Keep in sync with assets/shaders/instanceCull.comp
+	glm::vec3 center;
+	float radius;
+	instanceSphere(worldMatrix, boundingSphere, boundsMargin, center, radius);
+
+	return frustum.intersectsSphere(center, radius);
+}
+
+void InstanceCuller::instanceSphere(
+	const glm::mat4& worldMatrix,
+	const glm::vec4& boundingSphere,
+	float boundsMargin,
+	glm::vec3& center,
+	float& radius) {
+
+	center = glm::vec3(worldMatrix * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+
+	float scale = std::max(
+		glm::length(glm::vec3(worldMatrix[0])),
+		std::max(glm::length(glm::vec3(worldMatrix[1])), glm::length(glm::vec3(worldMatrix[2]))));
+
+	radius = boundingSphere.w * scale + boundsMargin;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../core.h"
+#include "../shader.h"
+#include "../mesh/instancedMesh.h"
+#include "frustum.h"
+#include "depthPyramid.h"
+#include "hiZCuller.h"
+
+class InstanceCuller {
+
+public:
+	InstanceCuller();
+	~InstanceCuller();
+
+	// Compact the visible instances of mesh on the GPU and write the indirect instance count.
+	// Instances inside the frustum are also tested against occlusion when it is given
+	void cull(InstancedMesh* mesh, const Frustum& frustum, float boundsMargin, const HiZCuller* occlusion = nullptr);
+
+	// Read the GPU written instance count back, stalls the pipeline
+	static unsigned int readVisibleCount(InstancedMesh* mesh);
+
+	// CPU reference of the compute pass, returns the number of visible instances.
+	// occlusion is the software pyramid of the same occluders, built with viewProjection
+	static unsigned int cullCPU(
+		InstancedMesh* mesh,
+		const Frustum& frustum,
+		float boundsMargin,
+		std::vector<glm::mat4>& visibleMatrices,
+		const DepthPyramid* occlusion = nullptr,
+		const glm::mat4& viewProjection = glm::mat4(1.0f));
+
+	// Bounding sphere of one instance against the frustum, shared by both paths
+	static bool isInstanceVisible(
+		const glm::mat4& worldMatrix,
+		const glm::vec4& boundingSphere,
+		float boundsMargin,
+		const Frustum& frustum);
+
+	// World space bounding sphere of one instance, widened by boundsMargin
+	static void instanceSphere(
+		const glm::mat4& worldMatrix,
+		const glm::vec4& boundingSphere,
+		float boundsMargin,
+		glm::vec3& center,
+		float& radius);
+
+private:
+	Shader* mCullShader{ nullptr };
+};
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "geometry.h"
+#include "glStateCache.h"
 #include <vector>
+#include <limits>
 
 Geometry::Geometry(){}
 
@@ -9,53 +11,13 @@ Geometry::Geometry(
 	const std::vector<float>& uvs,
 	const std::vector<unsigned int>& indices) 
 {
-	mIndicesCount = indices.size();
-
-
-	// 2 Create VBO
-	glGenBuffers(1, &mPosVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mPosVbo);
-	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
-
-
-	glGenBuffers(1, &mUvVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mUvVbo);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(float), uvs.data(), GL_STATIC_DRAW);
-
-	glGenBuffers(1, &mNormalVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mNormalVbo);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
-
-
-	// 3 Create EBO
-	glGenBuffers(1, &mEbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-	// 4 Create vao
-	glGenVertexArrays(1, &mVao);
-	glBindVertexArray(mVao);
-
-	// 5 Add vbo and ebo to vao
-	glBindBuffer(GL_ARRAY_BUFFER, mPosVbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-
-	glBindBuffer(GL_ARRAY_BUFFER, mUvVbo);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, mNormalVbo);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
-
-	glBindVertexArray(0);
-
+	VertexStreams streams;
+	streams.mPositions = positions.data();
+	streams.mNormals = normals.data();
+	streams.mUvs = uvs.data();
+	streams.mVertexCount = (uint32_t)(positions.size() / 3);
 
+	build(streams, indices.data(), (uint32_t)indices.size());
 }
 
 Geometry::Geometry(
@@ -66,90 +28,98 @@ Geometry::Geometry(
 	const std::vector<unsigned int>& indices
 
 ) {
-	mIndicesCount = indices.size();
+	VertexStreams streams;
+	streams.mPositions = positions.data();
+	streams.mNormals = normals.data();
+	streams.mUvs = uvs.data();
+	streams.mColors = colors.empty() ? nullptr : colors.data();
+	streams.mVertexCount = (uint32_t)(positions.size() / 3);
+
+	build(streams, indices.data(), (uint32_t)indices.size());
+}
 
+Geometry::Geometry(
+	const VertexLayout& layout,
+	const void* vertices,
+	uint32_t vertexCount,
+	const void* indices,
+	uint32_t indicesCount,
+	GLenum indexType,
+	const glm::vec3& boundingMin,
+	const glm::vec3& boundingMax
+) {
+	mLayout = layout;
+	mVertexCount = vertexCount;
+	mIndicesCount = indicesCount;
+	mIndexType = indexType;
+	mBoundingMin = boundingMin;
+	mBoundingMax = boundingMax;
+
+	upload(vertices, indices);
+}
 
-	// 2 Create VBO
-	glGenBuffers(1, &mPosVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mPosVbo);
-	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+void Geometry::build(const VertexStreams& streams, const uint32_t* indices, uint32_t indicesCount) {
 
+	computeBounds(streams.mPositions, (size_t)streams.mVertexCount * streams.mPositionComponents, streams.mPositionComponents);
 
-	glGenBuffers(1, &mUvVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mUvVbo);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(float), uvs.data(), GL_STATIC_DRAW);
+	// 1 Smallest formats that keep the data
+	mLayout = VertexLayout::choose(streams);
+	mVertexCount = streams.mVertexCount;
+	mIndicesCount = indicesCount;
+	mIndexType = IndexLayout::choose(streams.mVertexCount);
 
-	glGenBuffers(1, &mNormalVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mNormalVbo);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
+	// 2 Pack to the interleaved vertex and the index type
+	std::vector<uint8_t> vertices((size_t)mVertexCount * mLayout.getStride());
+	mLayout.pack(streams, vertices.data());
 
-	glGenBuffers(1, &mColorVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mColorVbo);
-	glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(float), colors.data(), GL_STATIC_DRAW);
+	std::vector<uint8_t> packedIndices((size_t)mIndicesCount * IndexLayout::getSize(mIndexType));
+	IndexLayout::pack(indices, mIndicesCount, mIndexType, packedIndices.data());
 
+	upload(vertices.data(), packedIndices.data());
+}
 
-	// 3 Create EBO
+void Geometry::upload(const void* vertices, const void* indices) {
+
+	// 1 Create VBO
+	glGenBuffers(1, &mVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+	glBufferData(GL_ARRAY_BUFFER, (size_t)mVertexCount * mLayout.getStride(), vertices, GL_STATIC_DRAW);
+
+	// 2 Create EBO
 	glGenBuffers(1, &mEbo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)mIndicesCount * IndexLayout::getSize(mIndexType), indices, GL_STATIC_DRAW);
 
-	// 4 Create vao
+	// 3 Create vao
 	glGenVertexArrays(1, &mVao);
-	glBindVertexArray(mVao);
-
-	// 5 Add vbo and ebo to vao
-	glBindBuffer(GL_ARRAY_BUFFER, mPosVbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-
-	glBindBuffer(GL_ARRAY_BUFFER, mUvVbo);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, mNormalVbo);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+	GLStateCache::bindVertexArray(mVao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, mColorVbo);
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+	// 4 Add vbo and ebo to vao
+	glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+	mLayout.apply();
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
 
-	glBindVertexArray(0);
-
-
+	GLStateCache::bindVertexArray(0);
 }
 
-
-
 Geometry::~Geometry() {
 
 	if (mVao != 0) {
+		GLStateCache::forgetVertexArray(mVao);
 		glDeleteVertexArrays(1, &mVao);
 	}
-	if (mPosVbo != 0) {
-		glDeleteBuffers(1, &mPosVbo);
-	}
-	if (mUvVbo != 0) {
-		glDeleteBuffers(1, &mUvVbo);
+	if (mVbo != 0) {
+		glDeleteBuffers(1, &mVbo);
 	}
 	if (mEbo != 0) {
 		glDeleteBuffers(1, &mEbo);
 	}
-	if (mNormalVbo != 0) {
-		glDeleteBuffers(1, &mNormalVbo);
-	}
-	if (mColorVbo != 0) {
-		glDeleteBuffers(1, &mColorVbo);
-	}
 }
 
 Geometry* Geometry::createBox(float size){
 
 	Geometry* geometry = new Geometry();
-	geometry->mIndicesCount = 36;
 
 	float halfSize = size / 2.0f;
 
@@ -225,49 +195,14 @@ Geometry* Geometry::createBox(float size){
 		20, 21, 22, 22, 23, 20   // Left face
 	};
 
-	// 2 Create VBO
-	GLuint& posVbo = geometry->mPosVbo, uvVbo = geometry->mUvVbo, normalVbo = geometry->mNormalVbo;
-	glGenBuffers(1, &posVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-
-
-	glGenBuffers(1, &uvVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(uvs), uvs, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &normalVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, normalVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-
-
-	// 3 Create EBO
-	glGenBuffers(1, &geometry->mEbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// 4 Create vao
-	glGenVertexArrays(1, &geometry->mVao);
-	glBindVertexArray(geometry->mVao);
-
-	// 5 Add vbo and ebo to vao
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, normalVbo);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+	// 2 Create vao
+	VertexStreams streams;
+	streams.mPositions = positions;
+	streams.mNormals = normals;
+	streams.mUvs = uvs;
+	streams.mVertexCount = 24;
 
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-
-	glBindVertexArray(0);
+	geometry->build(streams, indices, 36);
 
 	return geometry;
 }
@@ -336,50 +271,13 @@ Geometry* Geometry::createSphere(float radius){
 	}
 
 	// 4 Create vao
-	// 4.1 Create VBO
-	GLuint& posVbo = geometry->mPosVbo, uvVbo = geometry->mUvVbo, normalVbo = geometry->mNormalVbo;
-	glGenBuffers(1, &posVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
-
-
-	glGenBuffers(1, &uvVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(float), uvs.data(), GL_STATIC_DRAW);
-
-	glGenBuffers(1, &normalVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, normalVbo);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
-
-	// 3 Create EBO
-	glGenBuffers(1, &geometry->mEbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-
-	// 4 Create vao
-	glGenVertexArrays(1, &geometry->mVao);
-	glBindVertexArray(geometry->mVao);
-
-	// 5 Add vbo and ebo to vao
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
-
-
-	glBindBuffer(GL_ARRAY_BUFFER, normalVbo);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+	VertexStreams streams;
+	streams.mPositions = positions.data();
+	streams.mNormals = normals.data();
+	streams.mUvs = uvs.data();
+	streams.mVertexCount = (uint32_t)(positions.size() / 3);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-
-	glBindVertexArray(0);
-
-	geometry->mIndicesCount = indices.size();
+	geometry->build(streams, indices.data(), (uint32_t)indices.size());
 
 	return geometry;
 
@@ -389,7 +287,6 @@ Geometry* Geometry::createSphere(float radius){
 Geometry* Geometry::createPlane(float width, float height) {
 
 	Geometry* geometry = new Geometry();
-	geometry->mIndicesCount = 6;
 
 	float halfW = width / 2.0f;
 	float halfH = height / 2.0f;
@@ -420,44 +317,14 @@ Geometry* Geometry::createPlane(float width, float height) {
 		2, 3, 0
 	};
 
-	// 2 Create vbo
-	GLuint& posVbo = geometry->mPosVbo, uvVbo = geometry->mUvVbo, normalVbo = geometry->mNormalVbo;
-	glGenBuffers(1, &posVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &uvVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(uvs), uvs, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &normalVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, normalVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-
-	// 3 Create ebo
-	glGenBuffers(1, &geometry->mEbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// 4 Create vao
-	glGenVertexArrays(1, &geometry->mVao);
-	glBindVertexArray(geometry->mVao);
+	// 2 Create vao
+	VertexStreams streams;
+	streams.mPositions = positions;
+	streams.mNormals = normals;
+	streams.mUvs = uvs;
+	streams.mVertexCount = 4;
 
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, normalVbo);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-
-	glBindVertexArray(0);
+	geometry->build(streams, indices, 6);
 
 	return geometry;
 
@@ -466,7 +333,6 @@ Geometry* Geometry::createPlane(float width, float height) {
 Geometry* Geometry::createScreenPlane() {
 
 	Geometry* geometry = new Geometry();
-	geometry->mIndicesCount = 6;
 
 	float positions[] = {
 		-1.0f,  1.0f,
@@ -489,37 +355,99 @@ Geometry* Geometry::createScreenPlane() {
 	};
 
 
-	// 2 Create vbo
-	GLuint& posVbo = geometry->mPosVbo, uvVbo = geometry->mUvVbo;
-	glGenBuffers(1, &posVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
+	// 2 Create vao, z is 0 and the normal unused
+	VertexStreams streams;
+	streams.mPositions = positions;
+	streams.mPositionComponents = 2;
+	streams.mUvs = uvs;
+	streams.mVertexCount = 4;
 
-	glGenBuffers(1, &uvVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(uvs), uvs, GL_STATIC_DRAW);
+	geometry->build(streams, indices, 6);
 
+	return geometry;
+}
 
-	// 3 Create ebo
-	glGenBuffers(1, &geometry->mEbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+Geometry* Geometry::createGrassCards(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int cardCount) {
 
-	// 4 Create vao
-	glGenVertexArrays(1, &geometry->mVao);
-	glBindVertexArray(geometry->mVao);
+	std::vector<float> positions{};
+	std::vector<float> normals{};
+	std::vector<float> uvs{};
+	std::vector<float> colors{};
+	std::vector<unsigned int> indices{};
 
-	glBindBuffer(GL_ARRAY_BUFFER, posVbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec2 halfSize = glm::vec2(boundsMax.x - boundsMin.x, boundsMax.z - boundsMin.z) * 0.5f;
 
-	glBindBuffer(GL_ARRAY_BUFFER, uvVbo);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, (void*)0);
+	for (int i = 0; i < cardCount; i++) {
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->mEbo);
+		// 1 Cards are spread evenly around the vertical axis
+		float angle = glm::pi<float>() * i / cardCount;
+		glm::vec3 side{ cos(angle) * halfSize.x, 0.0f, sin(angle) * halfSize.y };
 
-	glBindVertexArray(0);
+		glm::vec3 corners[] = {
+			glm::vec3(center.x, boundsMin.y, center.z) - side,
+			glm::vec3(center.x, boundsMin.y, center.z) + side,
+			glm::vec3(center.x, boundsMax.y, center.z) + side,
+			glm::vec3(center.x, boundsMax.y, center.z) - side
+		};
+		float cornerUvs[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
 
-	return geometry;
+		unsigned int base = positions.size() / 3;
+		for (int j = 0; j < 4; j++) {
+
+			positions.push_back(corners[j].x);
+			positions.push_back(corners[j].y);
+			positions.push_back(corners[j].z);
+
+			// 2 Normals point up so both sides of a card light alike
+			normals.push_back(0.0f);
+			normals.push_back(1.0f);
+			normals.push_back(0.0f);
+
+			uvs.push_back(cornerUvs[j * 2]);
+			uvs.push_back(cornerUvs[j * 2 + 1]);
+
+			// 3 Red is the wind weight in grassInstance.vert, roots stay still
+			float root = j < 2 ? 1.0f : 0.0f;
+			colors.push_back(root);
+			colors.push_back(0.0f);
+			colors.push_back(0.0f);
+		}
+
+		unsigned int cardIndices[] = { 0, 1, 2, 2, 3, 0 };
+		for (unsigned int index : cardIndices) {
+			indices.push_back(base + index);
+		}
+	}
+
+	return new Geometry(positions, normals, uvs, colors, indices);
+}
+
+glm::vec4 Geometry::getBoundingSphere() const {
+
+	glm::vec3 center = (mBoundingMin + mBoundingMax) * 0.5f;
+	float radius = glm::length(mBoundingMax - mBoundingMin) * 0.5f;
+
+	return glm::vec4(center, radius);
+}
+
+void Geometry::computeBounds(const float* positions, size_t floatCount, size_t components) {
+
+	if (floatCount < components) {
+		return;
+	}
+
+	mBoundingMin = glm::vec3(std::numeric_limits<float>::max());
+	mBoundingMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (size_t i = 0; i + components <= floatCount; i += components) {
+
+		glm::vec3 p{ 0.0f };
+		for (size_t c = 0; c < components; c++) {
+			p[c] = positions[i + c];
+		}
+
+		mBoundingMin = glm::min(mBoundingMin, p);
+		mBoundingMax = glm::max(mBoundingMax, p);
+	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core.h"
+#include "vertexLayout.h"
 
 class Geometry {
 
@@ -22,6 +23,17 @@ public:
 
 	);
 
+	// Vertices already packed in layout, indices of indexType, e.g. straight from a mapped file
+	Geometry(
+		const VertexLayout& layout,
+		const void* vertices,
+		uint32_t vertexCount,
+		const void* indices,
+		uint32_t indicesCount,
+		GLenum indexType,
+		const glm::vec3& boundingMin,
+		const glm::vec3& boundingMax
+	);
 
 	~Geometry();
 
@@ -30,17 +42,45 @@ public:
 	static Geometry* createPlane(float width, float height);
 	static Geometry* createScreenPlane();
 
+	// Crossed vertical quads filling a blade box, used as grass LODs
+	static Geometry* createGrassCards(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int cardCount);
+
 	GLuint getVao()const { return mVao; }
+
+	// Source of the copies into MeshPool
+	GLuint getVbo()const { return mVbo; }
+	GLuint getEbo()const { return mEbo; }
 	uint32_t getIndicesCount()const { return mIndicesCount; }
+	uint32_t getVertexCount()const { return mVertexCount; }
+
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, pass to every draw
+	GLenum getIndexType()const { return mIndexType; }
+	const VertexLayout& getLayout()const { return mLayout; }
 
+	// Local space bounds, used by culling
+	glm::vec3 getBoundingMin()const { return mBoundingMin; }
+	glm::vec3 getBoundingMax()const { return mBoundingMax; }
+	glm::vec4 getBoundingSphere()const;
+
+private:
+	void computeBounds(const float* positions, size_t floatCount, size_t components);
+
+	// Pick the smallest layout and index type for the streams and upload them
+	void build(const VertexStreams& streams, const uint32_t* indices, uint32_t indicesCount);
+
+	// One interleaved VBO plus the EBO, attributes described by layout
+	void upload(const void* vertices, const void* indices);
 
 private:
 	GLuint mVao{ 0 };
-	GLuint mPosVbo{ 0 };
-	GLuint mUvVbo{ 0 };
+	GLuint mVbo{ 0 };
 	GLuint mEbo{ 0 };
-	GLuint mNormalVbo{ 0 };
-	GLuint mColorVbo{ 0 };
 
+	VertexLayout mLayout{};
+	uint32_t mVertexCount{ 0 };
 	uint32_t mIndicesCount{ 0 };
+	GLenum mIndexType{ GL_UNSIGNED_INT };
+
+	glm::vec3 mBoundingMin{ 0.0f };
+	glm::vec3 mBoundingMax{ 0.0f };
 };
\ No newline at end of file
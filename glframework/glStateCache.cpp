@@ -0,0 +1,270 @@
+#include "glStateCache.h"
+
+GLStateCache::Cached<bool> GLStateCache::mDepthTest{};
+GLStateCache::Cached<bool> GLStateCache::mStencilTest{};
+GLStateCache::Cached<bool> GLStateCache::mBlend{};
+GLStateCache::Cached<bool> GLStateCache::mCullFace{};
+GLStateCache::Cached<bool> GLStateCache::mPolygonOffsetFill{};
+GLStateCache::Cached<bool> GLStateCache::mPolygonOffsetLine{};
+
+GLStateCache::Cached<GLenum> GLStateCache::mDepthFunc{};
+GLStateCache::Cached<GLboolean> GLStateCache::mDepthMask{};
+GLStateCache::Cached<std::tuple<float, float>> GLStateCache::mPolygonOffset{};
+
+GLStateCache::Cached<std::tuple<GLenum, GLenum, GLenum>> GLStateCache::mStencilOp{};
+GLStateCache::Cached<GLuint> GLStateCache::mStencilMask{};
+GLStateCache::Cached<std::tuple<GLenum, GLint, GLuint>> GLStateCache::mStencilFunc{};
+
+GLStateCache::Cached<std::tuple<GLenum, GLenum>> GLStateCache::mBlendFunc{};
+
+GLStateCache::Cached<GLenum> GLStateCache::mFrontFace{};
+GLStateCache::Cached<GLenum> GLStateCache::mCullFaceMode{};
+
+GLStateCache::Cached<GLuint> GLStateCache::mProgram{};
+GLStateCache::Cached<GLuint> GLStateCache::mVertexArray{};
+GLStateCache::Cached<GLuint> GLStateCache::mActiveUnit{};
+GLStateCache::Cached<GLuint> GLStateCache::mTextures[GLStateCache::MaxTextureUnits][GLStateCache::TextureTargetCount]{};
+GLStateCache::Cached<GLuint> GLStateCache::mSamplers[GLStateCache::MaxTextureUnits]{};
+
+GLStateStats GLStateCache::mStats{};
+
+void GLStateCache::invalidate() {
+
+	mDepthTest.mKnown = false;
+	mStencilTest.mKnown = false;
+	mBlend.mKnown = false;
+	mCullFace.mKnown = false;
+	mPolygonOffsetFill.mKnown = false;
+	mPolygonOffsetLine.mKnown = false;
+
+	mDepthFunc.mKnown = false;
+	mDepthMask.mKnown = false;
+	mPolygonOffset.mKnown = false;
+
+	mStencilOp.mKnown = false;
+	mStencilMask.mKnown = false;
+	mStencilFunc.mKnown = false;
+
+	mBlendFunc.mKnown = false;
+
+	mFrontFace.mKnown = false;
+	mCullFaceMode.mKnown = false;
+
+	mProgram.mKnown = false;
+	mVertexArray.mKnown = false;
+	mActiveUnit.mKnown = false;
+
+	for (auto& unit : mTextures) {
+		for (auto& texture : unit) {
+			texture.mKnown = false;
+		}
+	}
+
+	for (auto& sampler : mSamplers) {
+		sampler.mKnown = false;
+	}
+}
+
+GLStateCache::Cached<bool>* GLStateCache::capability(GLenum capability) {
+
+	switch (capability) {
+	case GL_DEPTH_TEST:
+		return &mDepthTest;
+	case GL_STENCIL_TEST:
+		return &mStencilTest;
+	case GL_BLEND:
+		return &mBlend;
+	case GL_CULL_FACE:
+		return &mCullFace;
+	case GL_POLYGON_OFFSET_FILL:
+		return &mPolygonOffsetFill;
+	case GL_POLYGON_OFFSET_LINE:
+		return &mPolygonOffsetLine;
+	default:
+		return nullptr;
+	}
+}
+
+int GLStateCache::textureTargetIndex(GLenum target) {
+
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return 0;
+	case GL_TEXTURE_CUBE_MAP:
+		return 1;
+	case GL_TEXTURE_2D_ARRAY:
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+void GLStateCache::enable(GLenum capability) {
+
+	Cached<bool>* cached = GLStateCache::capability(capability);
+	if (cached == nullptr || cached->update(true)) {
+
+		glEnable(capability);
+	}
+}
+
+void GLStateCache::disable(GLenum capability) {
+
+	Cached<bool>* cached = GLStateCache::capability(capability);
+	if (cached == nullptr || cached->update(false)) {
+
+		glDisable(capability);
+	}
+}
+
+void GLStateCache::depthFunc(GLenum func) {
+
+	if (mDepthFunc.update(func)) {
+		glDepthFunc(func);
+	}
+}
+
+void GLStateCache::depthMask(GLboolean flag) {
+
+	if (mDepthMask.update(flag)) {
+		glDepthMask(flag);
+	}
+}
+
+void GLStateCache::polygonOffset(float factor, float units) {
+
+	if (mPolygonOffset.update({ factor, units })) {
+		glPolygonOffset(factor, units);
+	}
+}
+
+void GLStateCache::stencilOp(GLenum sFail, GLenum zFail, GLenum zPass) {
+
+	if (mStencilOp.update({ sFail, zFail, zPass })) {
+		glStencilOp(sFail, zFail, zPass);
+	}
+}
+
+void GLStateCache::stencilMask(GLuint mask) {
+
+	if (mStencilMask.update(mask)) {
+		glStencilMask(mask);
+	}
+}
+
+void GLStateCache::stencilFunc(GLenum func, GLint ref, GLuint mask) {
+
+	if (mStencilFunc.update({ func, ref, mask })) {
+		glStencilFunc(func, ref, mask);
+	}
+}
+
+void GLStateCache::blendFunc(GLenum sFactor, GLenum dFactor) {
+
+	if (mBlendFunc.update({ sFactor, dFactor })) {
+		glBlendFunc(sFactor, dFactor);
+	}
+}
+
+void GLStateCache::frontFace(GLenum mode) {
+
+	if (mFrontFace.update(mode)) {
+		glFrontFace(mode);
+	}
+}
+
+void GLStateCache::cullFace(GLenum mode) {
+
+	if (mCullFaceMode.update(mode)) {
+		glCullFace(mode);
+	}
+}
+
+void GLStateCache::useProgram(GLuint program) {
+
+	if (mProgram.update(program)) {
+		glUseProgram(program);
+	}
+}
+
+void GLStateCache::bindVertexArray(GLuint vao) {
+
+	if (mVertexArray.update(vao)) {
+		glBindVertexArray(vao);
+	}
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+
+	int targetIndex = textureTargetIndex(target);
+	if (unit >= MaxTextureUnits || targetIndex < 0) {
+
+		mStats.mIssuedCalls += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		mActiveUnit.mValue = unit;
+		mActiveUnit.mKnown = true;
+		return;
+	}
+
+	// The active unit only matters when the binding changes
+	Cached<GLuint>& cached = mTextures[unit][targetIndex];
+	if (cached.update(texture)) {
+
+		if (mActiveUnit.update(unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		glBindTexture(target, texture);
+	}
+}
+
+void GLStateCache::bindSampler(unsigned int unit, GLuint sampler) {
+
+	// Sampler bindings are per unit, no active unit switch
+	if (unit >= MaxTextureUnits) {
+
+		mStats.mIssuedCalls++;
+		glBindSampler(unit, sampler);
+		return;
+	}
+
+	if (mSamplers[unit].update(sampler)) {
+		glBindSampler(unit, sampler);
+	}
+}
+
+void GLStateCache::forgetProgram(GLuint program) {
+
+	if (mProgram.mValue == program) {
+		mProgram.mKnown = false;
+	}
+}
+
+void GLStateCache::forgetVertexArray(GLuint vao) {
+
+	if (mVertexArray.mValue == vao) {
+		mVertexArray.mKnown = false;
+	}
+}
+
+void GLStateCache::forgetTexture(GLuint texture) {
+
+	for (auto& unit : mTextures) {
+		for (auto& cached : unit) {
+
+			if (cached.mValue == texture) {
+				cached.mKnown = false;
+			}
+		}
+	}
+}
+
+void GLStateCache::forgetSampler(GLuint sampler) {
+
+	for (auto& cached : mSamplers) {
+
+		if (cached.mValue == sampler) {
+			cached.mKnown = false;
+		}
+	}
+}
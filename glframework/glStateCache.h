@@ -0,0 +1,99 @@
+#pragma once
+
+#include "core.h"
+#include <tuple>
+
+struct GLStateStats {
+	unsigned int mIssuedCalls{ 0 };		// reached the driver
+	unsigned int mSkippedCalls{ 0 };	// matched the shadowed state
+};
+
+// Shadow copy of the GL state the renderer touches, no-op transitions never reach the driver.
+// Everything in glframework changes this state through here, anything else (ImGui) must be
+// followed by invalidate()
+class GLStateCache {
+
+public:
+	// Forget every shadowed value, the next request of each state is issued
+	static void invalidate();
+
+	// GL_DEPTH_TEST, GL_STENCIL_TEST, GL_BLEND, GL_CULL_FACE and GL_POLYGON_OFFSET_* are shadowed,
+	// other capabilities pass through
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+
+	static void depthFunc(GLenum func);
+	static void depthMask(GLboolean flag);
+	static void polygonOffset(float factor, float units);
+
+	static void stencilOp(GLenum sFail, GLenum zFail, GLenum zPass);
+	static void stencilMask(GLuint mask);
+	static void stencilFunc(GLenum func, GLint ref, GLuint mask);
+
+	static void blendFunc(GLenum sFactor, GLenum dFactor);
+
+	static void frontFace(GLenum mode);
+	static void cullFace(GLenum mode);
+
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vao);
+	static void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+	static void bindSampler(unsigned int unit, GLuint sampler);
+
+	// Deleted names can be handed out again, drop them before the delete call
+	static void forgetProgram(GLuint program);
+	static void forgetVertexArray(GLuint vao);
+	static void forgetTexture(GLuint texture);
+	static void forgetSampler(GLuint sampler);
+
+	static const GLStateStats& getStats() { return mStats; }
+	static void resetStats() { mStats = GLStateStats(); }
+
+private:
+	// One shadowed value, unknown until the first request after invalidate()
+	template<typename T>
+	struct Cached {
+		T mValue{};
+		bool mKnown{ false };
+
+		bool update(const T& value) {
+
+			if (mKnown && mValue == value) {
+				mStats.mSkippedCalls++;
+				return false;
+			}
+
+			mValue = value;
+			mKnown = true;
+			mStats.mIssuedCalls++;
+			return true;
+		}
+	};
+
+	static constexpr unsigned int MaxTextureUnits = 32;
+	static constexpr unsigned int TextureTargetCount = 3; // 2D, cube map, 2D array
+
+	static Cached<bool>* capability(GLenum capability);
+	static int textureTargetIndex(GLenum target);
+
+private:
+	static Cached<bool> mDepthTest, mStencilTest, mBlend, mCullFace, mPolygonOffsetFill, mPolygonOffsetLine;
+
+	static Cached<GLenum> mDepthFunc;
+	static Cached<GLboolean> mDepthMask;
+	static Cached<std::tuple<float, float>> mPolygonOffset;
+
+	static Cached<std::tuple<GLenum, GLenum, GLenum>> mStencilOp;
+	static Cached<GLuint> mStencilMask;
+	static Cached<std::tuple<GLenum, GLint, GLuint>> mStencilFunc;
+
+	static Cached<std::tuple<GLenum, GLenum>> mBlendFunc;
+
+	static Cached<GLenum> mFrontFace, mCullFaceMode;
+
+	static Cached<GLuint> mProgram, mVertexArray, mActiveUnit;
+	static Cached<GLuint> mTextures[MaxTextureUnits][TextureTargetCount];
+	static Cached<GLuint> mSamplers[MaxTextureUnits];
+
+	static GLStateStats mStats;
+};
@@ -0,0 +1,145 @@
+#include "grassField.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+GrassField::GrassField(float chunkSize) {
+
+	mChunkSize = chunkSize;
+}
+
+GrassField::~GrassField() {}
+
+void GrassField::build(
+	std::vector<glm::mat4>& instanceMatrices,
+	const glm::vec3& geometryMin,
+	const glm::vec3& geometryMax) {
+
+	mChunks.clear();
+	mDrawRanges.clear();
+	mInstanceTotal = (unsigned int)instanceMatrices.size();
+
+	if (instanceMatrices.empty()) {
+		return;
+	}
+
+	// 1 Grid extent from the instance origins
+	glm::vec2 fieldMin{ std::numeric_limits<float>::max() };
+	glm::vec2 fieldMax{ std::numeric_limits<float>::lowest() };
+
+	for (const auto& matrix : instanceMatrices) {
+
+		fieldMin = glm::min(fieldMin, glm::vec2(matrix[3].x, matrix[3].z));
+		fieldMax = glm::max(fieldMax, glm::vec2(matrix[3].x, matrix[3].z));
+	}
+
+	int columns = (int)((fieldMax.x - fieldMin.x) / mChunkSize) + 1;
+	int rows = (int)((fieldMax.y - fieldMin.y) / mChunkSize) + 1;
+
+	auto chunkIndex = [&](const glm::mat4& matrix) {
+
+		int column = std::min((int)((matrix[3].x - fieldMin.x) / mChunkSize), columns - 1);
+		int row = std::min((int)((matrix[3].z - fieldMin.y) / mChunkSize), rows - 1);
+		return row * columns + column;
+	};
+
+	// 2 Counting sort, instances of one chunk become contiguous
+	std::vector<unsigned int> offsets(columns * rows + 1, 0);
+	for (const auto& matrix : instanceMatrices) {
+
+		offsets[chunkIndex(matrix) + 1]++;
+	}
+	for (size_t i = 1; i < offsets.size(); i++) {
+
+		offsets[i] += offsets[i - 1];
+	}
+
+	std::vector<glm::mat4> sorted(instanceMatrices.size());
+	std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+	for (const auto& matrix : instanceMatrices) {
+
+		sorted[cursor[chunkIndex(matrix)]++] = matrix;
+	}
+	instanceMatrices.swap(sorted);
+
+	// 3 Chunk bounds, the geometry box of every instance is transformed as center and extents
+	glm::vec3 localCenter = (geometryMin + geometryMax) * 0.5f;
+	glm::vec3 localExtents = (geometryMax - geometryMin) * 0.5f;
+
+	for (int i = 0; i < columns * rows; i++) {
+
+		if (offsets[i] == offsets[i + 1]) {
+			continue;
+		}
+
+		GrassChunk chunk;
+		chunk.mFirstInstance = offsets[i];
+		chunk.mInstanceCount = offsets[i + 1] - offsets[i];
+		chunk.mBoundsMin = glm::vec3(std::numeric_limits<float>::max());
+		chunk.mBoundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+		for (unsigned int j = chunk.mFirstInstance; j < offsets[i + 1]; j++) {
+
+			const glm::mat4& matrix = instanceMatrices[j];
+			glm::vec3 center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+
+			glm::mat3 absolute = glm::mat3(matrix);
+			for (int k = 0; k < 3; k++) {
+				absolute[k] = glm::abs(absolute[k]);
+			}
+			glm::vec3 extents = absolute * localExtents;
+
+			chunk.mBoundsMin = glm::min(chunk.mBoundsMin, center - extents);
+			chunk.mBoundsMax = glm::max(chunk.mBoundsMax, center + extents);
+		}
+
+		mChunks.push_back(chunk);
+	}
+}
+
+void GrassField::cull(const glm::mat4& localViewProjection, float boundsMargin, const DepthPyramid* occlusion) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mFrustum.setFromMatrix(localViewProjection);
+	mDrawRanges.clear();
+	mStats.mVisibleChunks = 0;
+	mStats.mDrawnInstances = 0;
+	mStats.mOccludedChunks = 0;
+	mStats.mOccludedInstances = 0;
+
+	glm::vec3 margin{ boundsMargin };
+
+	for (const auto& chunk : mChunks) {
+
+		if (!mFrustum.intersectsBox(chunk.mBoundsMin - margin, chunk.mBoundsMax + margin)) {
+			continue;
+		}
+
+		if (occlusion != nullptr && occlusion->isOccluded(chunk.mBoundsMin - margin, chunk.mBoundsMax + margin, localViewProjection)) {
+
+			mStats.mOccludedChunks++;
+			mStats.mOccludedInstances += chunk.mInstanceCount;
+			continue;
+		}
+
+		mStats.mVisibleChunks++;
+		mStats.mDrawnInstances += chunk.mInstanceCount;
+
+		// Neighbouring chunks in the buffer merge into one draw
+		if (!mDrawRanges.empty() &&
+			mDrawRanges.back().mBaseInstance + mDrawRanges.back().mInstanceCount == chunk.mFirstInstance) {
+
+			mDrawRanges.back().mInstanceCount += chunk.mInstanceCount;
+		}
+		else {
+
+			mDrawRanges.push_back({ chunk.mFirstInstance, chunk.mInstanceCount });
+		}
+	}
+
+	mStats.mCulledInstances = mInstanceTotal - mStats.mDrawnInstances;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.mCullTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
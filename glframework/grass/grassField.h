@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../core.h"
+#include "../culling/frustum.h"
+#include "../culling/depthPyramid.h"
+
+// Instances of one world-space cell, stored contiguously in the instance buffer
+struct GrassChunk {
+	glm::vec3 mBoundsMin{ 0.0f };
+	glm::vec3 mBoundsMax{ 0.0f };
+	unsigned int mFirstInstance{ 0 };
+	unsigned int mInstanceCount{ 0 };
+};
+
+// One glDrawElementsInstancedBaseInstance call
+struct GrassDrawRange {
+	unsigned int mBaseInstance{ 0 };
+	unsigned int mInstanceCount{ 0 };
+};
+
+struct GrassCullStats {
+	unsigned int mVisibleChunks{ 0 };
+	unsigned int mDrawnInstances{ 0 };
+	unsigned int mCulledInstances{ 0 };
+	unsigned int mOccludedChunks{ 0 };		// inside the frustum, behind the occluders
+	unsigned int mOccludedInstances{ 0 };	// part of mCulledInstances
+	float mCullTime{ 0.0f }; // ms
+};
+
+class GrassField {
+
+public:
+	GrassField(float chunkSize = 16.0f);
+	~GrassField();
+
+	// Reorder instance matrices chunk by chunk and compute the chunk bounds.
+	// Bounds are in the local space of the instanced mesh
+	void build(
+		std::vector<glm::mat4>& instanceMatrices,
+		const glm::vec3& geometryMin,
+		const glm::vec3& geometryMax);
+
+	// localViewProjection = projection * view * model of the instanced mesh.
+	// Chunks inside the frustum are also tested against occlusion when it is given
+	void cull(const glm::mat4& localViewProjection, float boundsMargin, const DepthPyramid* occlusion = nullptr);
+
+	float getChunkSize() const { return mChunkSize; }
+	const std::vector<GrassChunk>& getChunks() const { return mChunks; }
+	const std::vector<GrassDrawRange>& getDrawRanges() const { return mDrawRanges; }
+	const GrassCullStats& getStats() const { return mStats; }
+
+private:
+	float mChunkSize{ 16.0f };
+
+	std::vector<GrassChunk> mChunks{};
+	std::vector<GrassDrawRange> mDrawRanges{};
+
+	GrassCullStats mStats{};
+	unsigned int mInstanceTotal{ 0 };
+	Frustum mFrustum{};
+};
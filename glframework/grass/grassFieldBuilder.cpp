@@ -0,0 +1,118 @@
+#include "grassFieldBuilder.h"
+#include "../mesh/instancedMesh.h"
+#include <algorithm>
+#include <thread>
+
+GrassFieldBuilder::GrassFieldBuilder(unsigned int rows, unsigned int columns, float spacing, uint32_t seed) {
+
+	mRows = rows;
+	mColumns = columns;
+	mSpacing = spacing;
+	mSeed = seed;
+}
+
+GrassFieldBuilder::~GrassFieldBuilder() {}
+
+uint32_t GrassFieldBuilder::hash(uint32_t value) {
+
+	// PCG hash
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float GrassFieldBuilder::random01(uint32_t value) {
+
+	return (float)hash(value) / 4294967295.0f;
+}
+
+void GrassFieldBuilder::generate(std::vector<glm::mat4>& matrices) const {
+
+	unsigned int count = getInstanceCount();
+	matrices.resize(count);
+
+	unsigned int threads = mThreadCount != 0 ? mThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, std::max(1u, count));
+
+	if (threads == 1) {
+
+		generateRange(matrices.data(), 0, count);
+		return;
+	}
+
+	// Contiguous blocks, each thread writes its own part of the buffer
+	std::vector<std::thread> workers;
+	unsigned int block = (count + threads - 1) / threads;
+
+	for (unsigned int i = 0; i < threads; i++) {
+
+		unsigned int first = std::min(count, i * block);
+		unsigned int last = std::min(count, first + block);
+		workers.emplace_back(&GrassFieldBuilder::generateRange, this, matrices.data(), first, last);
+	}
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void GrassFieldBuilder::generateRange(glm::mat4* matrices, unsigned int first, unsigned int last) const {
+
+	uint32_t seedHash = hash(mSeed);
+
+	for (unsigned int id = first; id < last; id++) {
+
+		unsigned int row = id / mColumns;
+		unsigned int column = id % mColumns;
+
+		float yaw = glm::radians(random01(hash(id ^ seedHash)) * mMaxYaw);
+		float c = cos(yaw);
+		float s = sin(yaw);
+
+		// translate * rotate around Y, written out
+		matrices[id] = glm::mat4(
+			glm::vec4(c, 0.0f, -s, 0.0f),
+			glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
+			glm::vec4(s, 0.0f, c, 0.0f),
+			glm::vec4(row * mSpacing, 0.0f, column * mSpacing, 1.0f));
+	}
+}
+
+bool GrassFieldBuilder::build(Object* root) const {
+
+	// 1 Collect the instanced meshes, one field is shared by all of them
+	std::vector<InstancedMesh*> meshes;
+	root->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
+		meshes.push_back(im);
+	});
+
+	if (meshes.empty()) {
+		return true;
+	}
+
+	// 1.1 Every blade needs exactly one instance slot
+	for (auto mesh : meshes) {
+
+		if (mesh->mInstanceCount != getInstanceCount()) {
+
+			std::cout << "Error:GrassFieldBuilder has " << getInstanceCount() << " blades ("
+				<< mRows << "x" << mColumns << ") but the mesh holds " << mesh->mInstanceCount << " instances" << std::endl;
+			return false;
+		}
+	}
+
+	// 2 Generate straight into the first mesh, copy into the others
+	generate(meshes[0]->mInstanceMatrices);
+
+	for (auto mesh : meshes) {
+
+		if (mesh != meshes[0]) {
+			mesh->mInstanceMatrices = meshes[0]->mInstanceMatrices;
+		}
+
+		mesh->markDirty();
+		mesh->updateMatrices();
+	}
+
+	return true;
+}
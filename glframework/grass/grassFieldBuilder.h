@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../core.h"
+#include "../object.h"
+
+// Grid field generated in parallel. Every blade only depends on its index and the seed,
+// so the field is the same for any thread count and matches grassProcedural.vert
+class GrassFieldBuilder {
+
+public:
+	GrassFieldBuilder(unsigned int rows, unsigned int columns, float spacing, uint32_t seed = 0);
+	~GrassFieldBuilder();
+
+	void setMaxYaw(float degrees) { mMaxYaw = degrees; }
+
+	// 0 uses every hardware thread
+	void setThreadCount(unsigned int count) { mThreadCount = count; }
+
+	unsigned int getInstanceCount() const { return mRows * mColumns; }
+
+	// Fill matrices with rows * columns transforms, no GL calls
+	void generate(std::vector<glm::mat4>& matrices) const;
+
+	// Write the field into every instanced mesh below root and upload each buffer once.
+	// Returns false and leaves every mesh untouched when one holds a different instance count
+	bool build(Object* root) const;
+
+	// Counter based random numbers, keep in sync with grassProcedural.vert
+	static uint32_t hash(uint32_t value);
+	static float random01(uint32_t value);
+
+private:
+	void generateRange(glm::mat4* matrices, unsigned int first, unsigned int last) const;
+
+private:
+	unsigned int mRows{ 0 };
+	unsigned int mColumns{ 0 };
+	float mSpacing{ 0.2f };
+	uint32_t mSeed{ 0 };
+	float mMaxYaw{ 90.0f };
+	unsigned int mThreadCount{ 0 };
+};
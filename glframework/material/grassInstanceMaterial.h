@@ -11,8 +11,16 @@ public:
 	~GrassInstanceMaterial();
 
 public:
-	Texture* mDiffuse{ nullptr };
-	Texture* mOpacityMask{ nullptr };
+	// Single channel masks keep an exact 0 in BC4, BC7 moves masked texels off the alpha == 0 discard
+	static const TextureFormat MaskFormat = TextureFormat::Bc4;
+
+	// Diffuse layers in mTextures, opacity and cloud mask layers in mMasks, see TextureArray.
+	// The opacity mask is read at level 0, averaged mips would erode the alpha == 0 discard
+	Texture* mTextures{ nullptr };
+	Texture* mMasks{ nullptr };
+	int mDiffuseLayer{ 0 };
+	int mOpacityLayer{ 0 };
+	int mCloudLayer{ 1 };
 	float mShiness{ 1.0f };
 
 	float mUVScale{ 1.0f };
@@ -22,7 +30,6 @@ public:
 	glm::vec3 mWindDirection{ 1.0f, 1.0f, 1.0f };
 	float  mPhaseScale{ 1.0f };
 
-	Texture* mCloudMask{ nullptr };
 	glm::vec3 mCloudWhiteColor{ 0.576, 1.0, 0.393 };
 	glm::vec3 mCloudBlackColor{ 0.994, 0.3, 0.426 };
 	float mCloudUVScale{ 1.0f };
@@ -1,5 +1,10 @@
 #include "material.h"
 
 
-Material::Material(){}
+unsigned int Material::mNextId = 0;
+
+Material::Material(){
+
+	mId = mNextId++;
+}
 Material::~Material(){}
\ No newline at end of file
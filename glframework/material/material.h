@@ -12,7 +12,8 @@ enum class MaterialType {
 	CubeMaterial,
 	PhongEnvMaterial,
 	PhongInstanceMaterial,
-	GrassInstanceMaterial
+	GrassInstanceMaterial,
+	ProceduralGrassMaterial
 };
 
 class Material {
@@ -26,6 +27,9 @@ public:
 
 	MaterialType mType;
 
+	// Unique per material, part of the render queue sort key
+	unsigned int getId() const { return mId; }
+
 	// Depth
 	bool mDepthTest{ true };
 	GLenum mDepthFunc{ GL_LEQUAL };
@@ -60,4 +64,8 @@ public:
 	unsigned int mFrontFace{ GL_CCW };
 	unsigned int mCullFace{ GL_BACK };
 
+private:
+	unsigned int mId{ 0 };
+
+	static unsigned int mNextId;
 };
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "proceduralGrassMaterial.h"
+
+ProceduralGrassMaterial::ProceduralGrassMaterial() {
+
+	mType = MaterialType::ProceduralGrassMaterial;
+}
+
+ProceduralGrassMaterial::~ProceduralGrassMaterial(){}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "grassInstanceMaterial.h"
+
+// Grass placed in the vertex shader from gl_InstanceID, the mesh needs no instance buffer
+class ProceduralGrassMaterial :public GrassInstanceMaterial {
+public:
+
+	ProceduralGrassMaterial();
+	~ProceduralGrassMaterial();
+
+	unsigned int getInstanceCount() const { return mRows * mColumns; }
+
+public:
+	unsigned int mRows{ 300 };
+	unsigned int mColumns{ 300 };
+	float mSpacing{ 0.2f };
+	unsigned int mSeed{ 0 };
+	float mMaxYaw{ 90.0f };
+
+	// Optional, r is the chance a blade exists and g scales its height over the whole field
+	Texture* mDensityMap{ nullptr };
+};
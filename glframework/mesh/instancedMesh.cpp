@@ -1,5 +1,19 @@
 #include "instancedMesh.h"
+#include "../glStateCache.h"
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+static const unsigned int PERSISTENT_SECTIONS = 3;
+
+// Coarser than GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT on common drivers
+static const size_t PERSISTENT_ALIGNMENT = 256;
+
+// Beyond this many separate ranges one covering upload is cheaper than many small ones
+static const size_t MAX_DIRTY_RANGES = 16;
+
+size_t InstancedMesh::mUploadBytes = 0;
 
 InstancedMesh::InstancedMesh(
 	Geometry* geometry, 
@@ -14,29 +28,517 @@ InstancedMesh::InstancedMesh(
 	glBindBuffer(GL_ARRAY_BUFFER, mMatrixVbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * mInstanceCount, mInstanceMatrices.data(), GL_DYNAMIC_DRAW);
 
-	glBindVertexArray(mGeometry->getVao());
-	glBindBuffer(GL_ARRAY_BUFFER, mMatrixVbo);
-	
+	bindInstanceAttributes(mGeometry, mMatrixVbo);
+}
+
+
+InstancedMesh::~InstancedMesh(){
+
+	// Unmap before anything else, no attributes are rebound on the way out
+	if (mPersistent) {
+		releasePersistent();
+	}
+
+	if (mMatrixVbo != 0) {
+		glDeleteBuffers(1, &mMatrixVbo);
+	}
+	if (mCulledMatrixVbo != 0) {
+		glDeleteBuffers(1, &mCulledMatrixVbo);
+	}
+	if (mIndirectBuffer != 0) {
+		glDeleteBuffers(1, &mIndirectBuffer);
+	}
+	if (mCompactVbo != 0) {
+		glDeleteBuffers(1, &mCompactVbo);
+	}
+
+	delete mGrassField;
+
+	for (auto& lod : mLods) {
+		glDeleteBuffers(1, &lod.mMatrixVbo);
+	}
+}
+
+void InstancedMesh::bindInstanceAttributes(Geometry* geometry, unsigned int vbo, size_t offset) {
+
+	GLStateCache::bindVertexArray(geometry->getVao());
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
 	for (int i = 0; i < 4; i++) {
 
 		glEnableVertexAttribArray(4 + i);
-		glVertexAttribPointer(4 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(float) * i * 4));
+		glVertexAttribPointer(4 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + sizeof(float) * i * 4));
 		glVertexAttribDivisor(4 + i, 1);
 	}
 
-	glBindVertexArray(0);
+	GLStateCache::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+void InstancedMesh::bindCompactAttributes(Geometry* geometry, unsigned int vbo) {
 
-InstancedMesh::~InstancedMesh(){
+	GLStateCache::bindVertexArray(geometry->getVao());
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	// 1 Position and scale
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 4, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactInstance), (void*)offsetof(CompactInstance, mPosition));
+	glVertexAttribDivisor(4, 1);
+
+	// 2 Yaw, normalized to [0, 1]
+	glEnableVertexAttribArray(5);
+	glVertexAttribPointer(5, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactInstance), (void*)offsetof(CompactInstance, mYaw));
+	glVertexAttribDivisor(5, 1);
+
+	glDisableVertexAttribArray(6);
+	glDisableVertexAttribArray(7);
+
+	GLStateCache::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedMesh::setGpuCulling(bool enable) {
+
+	if (enable == mGpuCulling) {
+		return;
+	}
+	mGpuCulling = enable;
+
+	if (enable && mCulledMatrixVbo == 0) {
+
+		// 1 Compacted visible matrices, only written by the cull pass
+		glGenBuffers(1, &mCulledMatrixVbo);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCulledMatrixVbo);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * mInstanceCount, nullptr, GL_DYNAMIC_COPY);
+
+		// 2 Indirect command, instanceCount is written by the cull pass
+		DrawElementsIndirectCommand command;
+		command.count = mGeometry->getIndicesCount();
+
+		glGenBuffers(1, &mIndirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand), &command, GL_DYNAMIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// 3 Instance attributes read from whichever buffer is drawn
+	rebindInstanceAttributes();
+}
+
+void InstancedMesh::rebindInstanceAttributes() {
+
+	if (mGpuCulling) {
+
+		bindInstanceAttributes(mGeometry, mCulledMatrixVbo);
+	}
+	else if (isCompactDrawn()) {
+
+		bindCompactAttributes(mGeometry, mCompactVbo);
+	}
+	else {
+
+		bindInstanceAttributes(mGeometry, getMatrixBuffer(), getMatrixOffset());
+	}
+
+	// GPU culling wins over LODs, same order as Renderer::renderObject
+	if (mLodEnabled && !mGpuCulling) {
+
+		for (auto& lod : mLods) {
+			bindInstanceAttributes(lod.mGeometry, lod.mMatrixVbo);
+		}
+	}
+}
+
+void InstancedMesh::setLods(const std::vector<Geometry*>& geometries, const std::vector<float>& distances) {
+
+	for (auto& lod : mLods) {
+		glDeleteBuffers(1, &lod.mMatrixVbo);
+	}
+	mLods.clear();
+	mLods.resize(geometries.size());
+
+	for (size_t i = 0; i < geometries.size(); i++) {
+
+		InstanceLod& lod = mLods[i];
+		lod.mGeometry = geometries[i];
+		lod.mMatrices.reserve(mInstanceCount);
+
+		// Every bucket may hold all instances when the camera is far away or close up
+		glGenBuffers(1, &lod.mMatrixVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, lod.mMatrixVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * mInstanceCount, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	setLodDistances(distances);
+	rebindInstanceAttributes();
+}
+
+void InstancedMesh::setLodDistances(const std::vector<float>& distances) {
+
+	for (size_t i = 0; i < mLods.size() && i < distances.size(); i++) {
+
+		mLods[i].mDistance = distances[i];
+	}
+}
+
+void InstancedMesh::setInstanceFormat(InstanceFormat format) {
+
+	if (format == mFormat) {
+		return;
+	}
+	mFormat = format;
+
+	if (format == InstanceFormat::Compact) {
+
+		// Matrices stay on the CPU for culling and LODs, the compact buffer follows every edit
+		mCompactInstances.resize(mInstanceCount);
+		for (unsigned int i = 0; i < mInstanceCount; i++) {
+			mCompactInstances[i] = packInstance(mInstanceMatrices[i]);
+		}
+
+		glGenBuffers(1, &mCompactVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mCompactVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(CompactInstance) * mInstanceCount, mCompactInstances.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		mUploadBytes += sizeof(CompactInstance) * mInstanceCount;
+	}
+	else {
+
+		glDeleteBuffers(1, &mCompactVbo);
+		mCompactVbo = 0;
+		mCompactInstances.clear();
+		mCompactInstances.shrink_to_fit();
+	}
+
+	rebindInstanceAttributes();
+}
+
+CompactInstance InstancedMesh::packInstance(const glm::mat4& matrix) {
+
+	CompactInstance instance;
+	instance.mPosition[0] = glm::packHalf1x16(matrix[3].x);
+	instance.mPosition[1] = glm::packHalf1x16(matrix[3].y);
+	instance.mPosition[2] = glm::packHalf1x16(matrix[3].z);
+
+	// glm::rotate around Y puts (cos, 0, -sin) * scale in the first column
+	float scale = glm::length(glm::vec3(matrix[0]));
+	instance.mScale = glm::packHalf1x16(scale);
+
+	float yaw = atan2(-matrix[0].z, matrix[0].x);
+	if (yaw < 0.0f) {
+		yaw += glm::two_pi<float>();
+	}
+	instance.mYaw = (uint16_t)glm::round(yaw / glm::two_pi<float>() * 65535.0f);
+
+	return instance;
+}
+
+glm::mat4 InstancedMesh::unpackInstance(const CompactInstance& instance) {
+
+	// Keep in sync with assets/shaders/grassInstanceCompact.vert
+	glm::vec3 position{
+		glm::unpackHalf1x16(instance.mPosition[0]),
+		glm::unpackHalf1x16(instance.mPosition[1]),
+		glm::unpackHalf1x16(instance.mPosition[2])
+	};
+	float scale = glm::unpackHalf1x16(instance.mScale);
+	float yaw = instance.mYaw / 65535.0f * glm::two_pi<float>();
+
+	float c = cos(yaw) * scale;
+	float s = sin(yaw) * scale;
+
+	return glm::mat4(
+		glm::vec4(c, 0.0f, -s, 0.0f),
+		glm::vec4(0.0f, scale, 0.0f, 0.0f),
+		glm::vec4(s, 0.0f, c, 0.0f),
+		glm::vec4(position, 1.0f));
+}
+
+void InstancedMesh::updateCompactInstances() {
+
+	if (mFormat != InstanceFormat::Compact || mDirtyRanges.empty()) {
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, mCompactVbo);
+	for (const auto& range : mDirtyRanges) {
+
+		for (unsigned int i = range.mFirst; i < range.mFirst + range.mCount; i++) {
+			mCompactInstances[i] = packInstance(mInstanceMatrices[i]);
+		}
+
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(CompactInstance) * range.mFirst, sizeof(CompactInstance) * range.mCount, &mCompactInstances[range.mFirst]);
+		mUploadBytes += sizeof(CompactInstance) * range.mCount;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedMesh::setLodEnabled(bool enable) {
+
+	mLodEnabled = enable && !mLods.empty();
+	rebindInstanceAttributes();
+}
+
+void InstancedMesh::updateLods(const glm::vec3& localCameraPosition) {
+
+	// 1 Sort instances into distance buckets
+	for (auto& lod : mLods) {
+		lod.mMatrices.clear();
+	}
+
+	if (mChunkCulling) {
+
+		for (const auto& range : mGrassField->getDrawRanges()) {
+			bucketLods(range.mBaseInstance, range.mInstanceCount, localCameraPosition);
+		}
+	}
+	else {
+
+		bucketLods(0, mInstanceCount, localCameraPosition);
+	}
+
+	// 2 Upload the buckets
+	for (auto& lod : mLods) {
 
+		lod.mInstanceCount = lod.mMatrices.size();
+		if (lod.mInstanceCount == 0) {
+			continue;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, lod.mMatrixVbo);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * lod.mInstanceCount, lod.mMatrices.data());
+		mUploadBytes += sizeof(glm::mat4) * lod.mInstanceCount;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedMesh::bucketLods(unsigned int first, unsigned int count, const glm::vec3& localCameraPosition) {
+
+	for (unsigned int i = first; i < first + count; i++) {
+
+		const glm::mat4& matrix = mInstanceMatrices[i];
+		glm::vec3 offset = glm::vec3(matrix[3]) - localCameraPosition;
+		float distance2 = glm::dot(offset, offset);
+
+		for (auto& lod : mLods) {
+
+			if (distance2 <= lod.mDistance * lod.mDistance) {
+
+				lod.mMatrices.push_back(matrix);
+				break;
+			}
+		}
+	}
+}
+
+void InstancedMesh::setChunkCulling(bool enable, float chunkSize) {
+
+	mChunkCulling = enable;
+
+	if (!enable) {
+		return;
+	}
+
+	if (mGrassField == nullptr || mGrassField->getChunkSize() != chunkSize) {
+
+		delete mGrassField;
+		mGrassField = new GrassField(chunkSize);
+
+		// Chunk order replaces the original instance order
+		mGrassField->build(mInstanceMatrices, mGeometry->getBoundingMin(), mGeometry->getBoundingMax());
+		markDirty();
+		updateMatrices();
+	}
+}
+
+void InstancedMesh::setInstanceMatrix(unsigned int index, const glm::mat4& matrix) {
+
+	mInstanceMatrices[index] = matrix;
+	addRange(mDirtyRanges, index, 1);
+}
+
+void InstancedMesh::markDirty(unsigned int first, unsigned int count) {
+
+	addRange(mDirtyRanges, first, count);
+}
+
+void InstancedMesh::markDirty() {
+
+	mDirtyRanges.clear();
+	addRange(mDirtyRanges, 0, mInstanceCount);
+}
+
+void InstancedMesh::addRange(std::vector<InstanceRange>& ranges, unsigned int first, unsigned int count) {
+
+	// 1 Sequential edits grow the last range
+	if (!ranges.empty()) {
+
+		InstanceRange& last = ranges.back();
+		if (first <= last.mFirst + last.mCount && first + count >= last.mFirst) {
+
+			unsigned int end = std::max(last.mFirst + last.mCount, first + count);
+			last.mFirst = std::min(last.mFirst, first);
+			last.mCount = end - last.mFirst;
+			return;
+		}
+	}
+
+	ranges.push_back({ first, count });
+
+	// 2 Too scattered, collapse into one covering range
+	if (ranges.size() > MAX_DIRTY_RANGES) {
+
+		unsigned int begin = ranges[0].mFirst;
+		unsigned int end = ranges[0].mFirst + ranges[0].mCount;
+		for (const auto& range : ranges) {
+
+			begin = std::min(begin, range.mFirst);
+			end = std::max(end, range.mFirst + range.mCount);
+		}
+
+		ranges.clear();
+		ranges.push_back({ begin, end - begin });
+	}
 }
 
 void InstancedMesh::updateMatrices() {
 
-	glBindBuffer(GL_ARRAY_BUFFER, mMatrixVbo);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * mInstanceCount, mInstanceMatrices.data());
+	updateCompactInstances();
+
+	if (!mPersistent) {
+
+		if (mDirtyRanges.empty()) {
+			return;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, mMatrixVbo);
+		for (const auto& range : mDirtyRanges) {
+
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * range.mFirst, sizeof(glm::mat4) * range.mCount, &mInstanceMatrices[range.mFirst]);
+			mUploadBytes += sizeof(glm::mat4) * range.mCount;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		mDirtyRanges.clear();
+		return;
+	}
+
+	// 1 Every section has to catch up with the edits
+	for (const auto& range : mDirtyRanges) {
+		for (unsigned int i = 0; i < PERSISTENT_SECTIONS; i++) {
+			addRange(mPersistentDirty[i], range.mFirst, range.mCount);
+		}
+	}
+	mDirtyRanges.clear();
+
+	// 2 Move to the next section only when it is behind, otherwise keep drawing the current one
+	unsigned int next = (mPersistentSection + 1) % PERSISTENT_SECTIONS;
+	if (mPersistentDirty[next].empty()) {
+		return;
+	}
+
+	writePersistentSection(next);
+	mPersistentSection = next;
+	rebindInstanceAttributes();
+}
+
+void InstancedMesh::writePersistentSection(unsigned int section) {
+
+	// 1 Wait until the GPU is done with the frame that last read this section
+	GLsync& fence = mPersistentFences[section];
+	if (fence != nullptr) {
+
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	// 2 Coherent mapping, a plain copy is the upload
+	unsigned char* base = mPersistentData + mPersistentStride * section;
+	for (const auto& range : mPersistentDirty[section]) {
+
+		memcpy(base + sizeof(glm::mat4) * range.mFirst, &mInstanceMatrices[range.mFirst], sizeof(glm::mat4) * range.mCount);
+		mUploadBytes += sizeof(glm::mat4) * range.mCount;
+	}
+	mPersistentDirty[section].clear();
+}
+
+void InstancedMesh::setPersistentMapping(bool enable) {
+
+	if (enable == mPersistent) {
+		return;
+	}
+
+	if (enable) {
+
+		// 1 Immutable storage mapped once for the lifetime of the mesh
+		mPersistentStride = (sizeof(glm::mat4) * mInstanceCount + PERSISTENT_ALIGNMENT - 1) / PERSISTENT_ALIGNMENT * PERSISTENT_ALIGNMENT;
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glGenBuffers(1, &mPersistentVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mPersistentVbo);
+		glBufferStorage(GL_ARRAY_BUFFER, mPersistentStride * PERSISTENT_SECTIONS, nullptr, flags);
+		mPersistentData = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, mPersistentStride * PERSISTENT_SECTIONS, flags);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// 2 Fill every section once
+		mPersistentSection = 0;
+		for (unsigned int i = 0; i < PERSISTENT_SECTIONS; i++) {
+
+			mPersistentDirty[i].clear();
+			addRange(mPersistentDirty[i], 0, mInstanceCount);
+			writePersistentSection(i);
+		}
+		mDirtyRanges.clear();
+	}
+	else {
+
+		releasePersistent();
+
+		// The regular buffer missed every edit made while mapped
+		markDirty();
+	}
+
+	mPersistent = enable;
+	rebindInstanceAttributes();
+}
+
+void InstancedMesh::releasePersistent() {
+
+	for (unsigned int i = 0; i < PERSISTENT_SECTIONS; i++) {
+
+		if (mPersistentFences[i] != nullptr) {
+			glDeleteSync(mPersistentFences[i]);
+			mPersistentFences[i] = nullptr;
+		}
+		mPersistentDirty[i].clear();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, mPersistentVbo);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDeleteBuffers(1, &mPersistentVbo);
+
+	mPersistentVbo = 0;
+	mPersistentData = nullptr;
+	mPersistentSection = 0;
+}
+
+void InstancedMesh::fenceMatrices() {
+
+	if (!mPersistent) {
+		return;
+	}
+
+	GLsync& fence = mPersistentFences[mPersistentSection];
+	if (fence != nullptr) {
+		glDeleteSync(fence);
+	}
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 void InstancedMesh::sortMatrices(glm::mat4 viewMatrix) {
@@ -1,6 +1,46 @@
 #pragma once
 
 #include "mesh.h"
+#include "../grass/grassField.h"
+
+// Layout consumed by glDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count{ 0 };
+	GLuint instanceCount{ 0 };
+	GLuint firstIndex{ 0 };
+	GLint  baseVertex{ 0 };
+	GLuint baseInstance{ 0 };
+};
+
+// One distance band of an instanced mesh with its own geometry and instance buffer
+struct InstanceLod {
+	Geometry* mGeometry{ nullptr };
+	float mDistance{ 0.0f };	// Far end of the band, in the local space of the mesh
+
+	unsigned int mMatrixVbo{ 0 };
+	unsigned int mInstanceCount{ 0 };
+	std::vector<glm::mat4> mMatrices{};
+};
+
+// Instances [mFirst, mFirst + mCount) changed since the last upload
+struct InstanceRange {
+	unsigned int mFirst{ 0 };
+	unsigned int mCount{ 0 };
+};
+
+// 12 byte instance for translation plus yaw placements, rebuilt in grassInstanceCompact.vert.
+// Half floats keep about 3 cm of precision up to 64 m from the mesh origin
+struct CompactInstance {
+	uint16_t mPosition[3]{ 0, 0, 0 };	// half float
+	uint16_t mScale{ 0 };				// half float, uniform
+	uint16_t mYaw{ 0 };					// unorm16 of [0, 2pi)
+	uint16_t mPadding{ 0 };
+};
+
+enum class InstanceFormat {
+	Matrix,
+	Compact
+};
 
 class InstancedMesh :public Mesh {
 
@@ -8,11 +48,103 @@ public:
 	InstancedMesh(Geometry* geometry, Material* material, unsigned int instanceCount);
 	~InstancedMesh();
 
+	// Upload only the dirty instance ranges, no-op when nothing changed
 	void updateMatrices();
 	void sortMatrices(glm::mat4 viewMatrix);
 
+	void setInstanceMatrix(unsigned int index, const glm::mat4& matrix);
+	void markDirty(unsigned int first, unsigned int count);
+	void markDirty();
+
+	// Triple-buffered persistent mapping for instances that change every frame
+	void setPersistentMapping(bool enable);
+	bool getPersistentMapping() const { return mPersistent; }
+
+	// Compact instances are drawn unless GPU culling or LODs need the full matrices
+	void setInstanceFormat(InstanceFormat format);
+	InstanceFormat getInstanceFormat() const { return mFormat; }
+	bool isCompactDrawn() const { return mFormat == InstanceFormat::Compact && !mGpuCulling && !mLodEnabled; }
+
+	// Translation, Y rotation and uniform scale only, other parts of the matrix are dropped
+	static CompactInstance packInstance(const glm::mat4& matrix);
+	static glm::mat4 unpackInstance(const CompactInstance& instance);
+
+	// Fence the persistent section the last draw read from
+	void fenceMatrices();
+
+	// Buffer and byte offset the current instance matrices live at
+	unsigned int getMatrixBuffer() const { return mPersistent ? mPersistentVbo : mMatrixVbo; }
+	size_t getMatrixOffset() const { return mPersistent ? mPersistentStride * mPersistentSection : 0; }
+
+	// Instance bytes sent to the GPU since the last reset, by any instanced mesh
+	static size_t getUploadBytes() { return mUploadBytes; }
+	static void resetUploadBytes() { mUploadBytes = 0; }
+
+	// Draw only the instances a compute pass found inside the frustum
+	void setGpuCulling(bool enable);
+	bool getGpuCulling() const { return mGpuCulling; }
+
+	// Bucket instances into world-space chunks and draw only the visible chunk ranges
+	void setChunkCulling(bool enable, float chunkSize = 16.0f);
+	bool getChunkCulling() const { return mChunkCulling; }
+	GrassField* getGrassField() const { return mGrassField; }
+
+	// Level i draws geometries[i] up to distances[i], instances beyond the last distance are dropped
+	void setLods(const std::vector<Geometry*>& geometries, const std::vector<float>& distances);
+	void setLodDistances(const std::vector<float>& distances);
+	void setLodEnabled(bool enable);
+	bool getLodEnabled() const { return mLodEnabled; }
+
+	// Bucket instances by distance and upload every bucket, chunk culled ranges only when enabled
+	void updateLods(const glm::vec3& localCameraPosition);
+
 public:
 	unsigned int	mInstanceCount{ 0 };
 	std::vector<glm::mat4>	mInstanceMatrices{};
 	unsigned int	mMatrixVbo{ 0 };
+
+	// GPU culling output
+	unsigned int	mCulledMatrixVbo{ 0 };
+	unsigned int	mIndirectBuffer{ 0 };
+
+	std::vector<InstanceLod> mLods{};
+
+	unsigned int	mCompactVbo{ 0 };
+	std::vector<CompactInstance> mCompactInstances{};
+
+private:
+	void bindInstanceAttributes(Geometry* geometry, unsigned int vbo, size_t offset = 0);
+	void bindCompactAttributes(Geometry* geometry, unsigned int vbo);
+	void rebindInstanceAttributes();
+	void updateCompactInstances();
+	void bucketLods(unsigned int first, unsigned int count, const glm::vec3& localCameraPosition);
+
+	static void addRange(std::vector<InstanceRange>& ranges, unsigned int first, unsigned int count);
+	void writePersistentSection(unsigned int section);
+
+	// Fences, mapping and storage of the persistent path, attributes are left alone
+	void releasePersistent();
+
+private:
+	bool mGpuCulling{ false };
+
+	bool mChunkCulling{ false };
+	GrassField* mGrassField{ nullptr };
+
+	bool mLodEnabled{ false };
+
+	std::vector<InstanceRange> mDirtyRanges{};
+
+	InstanceFormat mFormat{ InstanceFormat::Matrix };
+
+	// Persistent path: three sections of mPersistentStride bytes, one written while the others are read
+	bool mPersistent{ false };
+	unsigned int mPersistentVbo{ 0 };
+	unsigned char* mPersistentData{ nullptr };
+	size_t mPersistentStride{ 0 };
+	unsigned int mPersistentSection{ 0 };
+	GLsync mPersistentFences[3]{ nullptr, nullptr, nullptr };
+	std::vector<InstanceRange> mPersistentDirty[3]{};
+
+	static size_t mUploadBytes;
 };
\ No newline at end of file
@@ -4,6 +4,12 @@
 #include "../geometry.h"
 #include "../material/material.h"
 
+// Simplified stand-in for the mesh geometry
+struct GeometryLod {
+	Geometry* mGeometry{ nullptr };
+	float mError{ 0.0f };	// largest deviation from the source geometry, mesh units
+};
+
 class Mesh : public Object {
 
 public:
@@ -15,4 +21,7 @@ public:
 	Geometry* mGeometry{ nullptr };
 	Material* mMaterial{ nullptr };
 
+	// Finest first, generated at import
+	std::vector<GeometryLod> mGeometryLods{};
+
 };
\ No newline at end of file
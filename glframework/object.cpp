@@ -1,77 +1,77 @@
 #include "object.h"
+#include <algorithm>
 
 Object::Object(){
 
 	mType = ObjectType::Object;
+	mTransform = TransformSystem::getDefault().create();
 }
 
-Object::~Object(){}
+Object::~Object(){
+
+	// Children outlive this node as roots
+	TransformSystem& transforms = TransformSystem::getDefault();
+	for (Object* child : mChildren) {
+
+		child->mParent = nullptr;
+		transforms.setParent(child->mTransform, TransformSystem::InvalidHandle);
+	}
+
+	transforms.release(mTransform);
+}
 
 void Object::setPosition(glm::vec3 pos){
 	
-	mPosition = pos;
+	TransformSystem::getDefault().setPosition(mTransform, pos);
 }
 
 void Object::rotateX(float angle){
 
-	mAngleX += angle;
+	TransformSystem& transforms = TransformSystem::getDefault();
+	transforms.setAngles(mTransform, transforms.getAngles(mTransform) + glm::vec3(angle, 0.0f, 0.0f));
 }
 
 void Object::rotateY(float angle){
 
-	mAngleY += angle;
+	TransformSystem& transforms = TransformSystem::getDefault();
+	transforms.setAngles(mTransform, transforms.getAngles(mTransform) + glm::vec3(0.0f, angle, 0.0f));
 }
 
 void Object::rotateZ(float angle){
 
-	mAngleZ += angle;
+	TransformSystem& transforms = TransformSystem::getDefault();
+	transforms.setAngles(mTransform, transforms.getAngles(mTransform) + glm::vec3(0.0f, 0.0f, angle));
 }
 
 void Object::setAngleX(float angle) {
 
-	mAngleX = angle;
+	TransformSystem& transforms = TransformSystem::getDefault();
+	glm::vec3 angles = transforms.getAngles(mTransform);
+	transforms.setAngles(mTransform, glm::vec3(angle, angles.y, angles.z));
 }
 
 void Object::setAngleY(float angle) {
 
-	mAngleY = angle;
+	TransformSystem& transforms = TransformSystem::getDefault();
+	glm::vec3 angles = transforms.getAngles(mTransform);
+	transforms.setAngles(mTransform, glm::vec3(angles.x, angle, angles.z));
 }
 
 void Object::setAngleZ(float angle) {
 
-	mAngleZ = angle;
+	TransformSystem& transforms = TransformSystem::getDefault();
+	glm::vec3 angles = transforms.getAngles(mTransform);
+	transforms.setAngles(mTransform, glm::vec3(angles.x, angles.y, angle));
 }
 
 void Object::setScale(glm::vec3 scale){
 
-	mScale = scale;
+	TransformSystem::getDefault().setScale(mTransform, scale);
 }
 
-glm::mat4 Object::getModelMatrix() const {
-
-	glm::mat4 parentMatrix{ 1.0f };
-	if (mParent != nullptr) {
-
-		parentMatrix = mParent->getModelMatrix();
-	}
-
-	// 1 Scale (local coordinate)
-	glm::mat4 transform{ 1.0f };
-
-
-	// 2 Rotate (local coordinate)
-	transform = glm::scale(transform, mScale);
+const glm::mat4& Object::getModelMatrix() const {
 
-	transform = glm::rotate(transform, glm::radians(mAngleX), glm::vec3(1.0f, 0.0f, 0.0f));
-
-	transform = glm::rotate(transform, glm::radians(mAngleY), glm::vec3(0.0f, 1.0f, 0.0f));
-
-	transform = glm::rotate(transform, glm::radians(mAngleZ), glm::vec3(0.0f, 0.0f, 1.0f));
-
-	// 3 Translate (global coordinate)
-	transform = parentMatrix * glm::translate(glm::mat4(1.0f), mPosition) * transform;
-
-	return transform;
+	return TransformSystem::getDefault().getWorldMatrix(mTransform);
 }
 
 void Object::addChild(Object* obj){
@@ -85,14 +85,34 @@ void Object::addChild(Object* obj){
 	}
 
 	// 2 Add child
+	obj->mIndexInParent = (unsigned int)mChildren.size();
 	mChildren.push_back(obj);
 
 	// 3 link parent
 	obj->mParent = this;
+	TransformSystem::getDefault().setParent(obj->mTransform, mTransform);
 }
 
-std::vector<Object*> Object::getChildren(){
-	return mChildren;
+Object* Object::nextInSubtree(const Object* root) const {
+
+	// 1 Down to the first child
+	if (!mChildren.empty()) {
+		return mChildren[0];
+	}
+
+	// 2 Up until a parent has a next sibling, never above root
+	const Object* obj = this;
+	while (obj != root && obj->mParent != nullptr) {
+
+		const std::vector<Object*>& siblings = obj->mParent->mChildren;
+		if (obj->mIndexInParent + 1 < siblings.size()) {
+			return siblings[obj->mIndexInParent + 1];
+		}
+
+		obj = obj->mParent;
+	}
+
+	return nullptr;
 }
 
 Object* Object::getParent(){
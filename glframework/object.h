@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core.h"
+#include "transform/transformSystem.h"
 
 enum class ObjectType {
 	Object,
@@ -16,6 +17,10 @@ public:
 	Object();
 	~Object();
 
+	// One transform node per object
+	Object(const Object&) = delete;
+	Object& operator=(const Object&) = delete;
+
 	void setPosition(glm::vec3 pos);
 	void rotateX(float angle);
 	void rotateY(float angle);
@@ -30,31 +35,62 @@ public:
 
 
 	glm::vec3 getPosition() const {
-		return mPosition;
+		return TransformSystem::getDefault().getPosition(mTransform);
 	}
 
-	glm::mat4 getModelMatrix() const;
+	// World matrix from the shared TransformSystem
+	const glm::mat4& getModelMatrix() const;
+
+	TransformSystem::Handle getTransform() const { return mTransform; }
 
 	// Parent
 	void addChild(Object* obj);
-	std::vector<Object*> getChildren();
+	const std::vector<Object*>& getChildren() const { return mChildren; }
 	Object* getParent();
 
-	ObjectType getType() const { return mType; }
+	// Pre-order walk over this object and all of its descendants. Iterative and allocation free,
+	// visit may start another walk but must not add or remove children
+	template<typename Visitor>
+	void forEachDescendant(Visitor&& visit);
 
-protected:
-	glm::vec3 mPosition{ 0.0f };
-	
-	float mAngleX{ 0.0f };
-	float mAngleY{ 0.0f };
-	float mAngleZ{ 0.0f };
+	// Only objects of the given type, passed as T*
+	template<typename T = Object, typename Visitor>
+	void forEachDescendant(ObjectType type, Visitor&& visit);
 
-	glm::vec3 mScale{ 1.0f };
+	ObjectType getType() const { return mType; }
 
+protected:
+	// Position, angles and scale live in TransformSystem::getDefault()
+	TransformSystem::Handle mTransform{ TransformSystem::InvalidHandle };
 
 	// Parent and children
 	std::vector<Object*> mChildren{};
 	Object* mParent{ nullptr };
+	unsigned int mIndexInParent{ 0 };
 
 	ObjectType mType;
-};
\ No newline at end of file
+
+private:
+	// Next object after this one in the pre-order walk of root, nullptr at the end
+	Object* nextInSubtree(const Object* root) const;
+};
+
+template<typename Visitor>
+void Object::forEachDescendant(Visitor&& visit) {
+
+	for (Object* obj = this; obj != nullptr; obj = obj->nextInSubtree(this)) {
+
+		visit(obj);
+	}
+}
+
+template<typename T, typename Visitor>
+void Object::forEachDescendant(ObjectType type, Visitor&& visit) {
+
+	for (Object* obj = this; obj != nullptr; obj = obj->nextInSubtree(this)) {
+
+		if (obj->getType() == type) {
+			visit((T*)obj);
+		}
+	}
+}
\ No newline at end of file
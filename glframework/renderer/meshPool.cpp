@@ -0,0 +1,377 @@
+#include "meshPool.h"
+#include "../glStateCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+// Grow buffer to at least bytes, doubling, and write data at the start
+static void uploadBuffer(GLenum target, GLuint buffer, size_t& capacity, const void* data, size_t bytes) {
+
+	glBindBuffer(target, buffer);
+	if (bytes > capacity) {
+
+		capacity = std::max(bytes, capacity * 2);
+		glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(target, 0, bytes, data);
+	glBindBuffer(target, 0);
+}
+
+MeshPool::MeshPool() {
+
+	glGenBuffers(1, &mCommandBuffer);
+	glGenBuffers(1, &mDrawSsbo);
+	glGenBuffers(1, &mMaterialSsbo);
+}
+
+MeshPool::~MeshPool() {
+
+	for (auto& arena : mArenas) {
+
+		GLStateCache::forgetVertexArray(arena.mVao);
+		glDeleteVertexArrays(1, &arena.mVao);
+		glDeleteBuffers(1, &arena.mVbo);
+		glDeleteBuffers(1, &arena.mEbo);
+	}
+
+	glDeleteBuffers(1, &mCommandBuffer);
+	glDeleteBuffers(1, &mDrawSsbo);
+	glDeleteBuffers(1, &mMaterialSsbo);
+}
+
+bool MeshPool::accepts(Mesh* mesh, Material* material) {
+
+	if (mesh->getType() != ObjectType::Mesh || material->mType != MaterialType::PhongMaterial) {
+		return false;
+	}
+
+	// Anything that needs the scene order or a per draw state stays in the render queue
+	if (material->mBlend || material->mStencilTest || material->mPolygonOffset) {
+		return false;
+	}
+
+	return ((PhongMaterial*)material)->mDiffuse != nullptr && mesh->mGeometry->getIndicesCount() > 0;
+}
+
+void MeshPool::begin() {
+
+	mDraws.clear();
+}
+
+void MeshPool::push(Mesh* mesh, PhongMaterial* material) {
+
+	FrameDraw draw;
+	draw.mMesh = mesh;
+	draw.mMaterial = material;
+	draw.mRange = registerGeometry(mesh->mGeometry);
+	draw.mMaterialIndex = registerMaterial(material);
+	draw.mKey = makeBatchKey(mRanges[draw.mRange].mArena, material);
+
+	mDraws.push_back(draw);
+}
+
+uint32_t MeshPool::registerGeometry(Geometry* geometry) {
+
+	auto iter = mRangeIndices.find(geometry);
+	if (iter != mRangeIndices.end()) {
+		return iter->second;
+	}
+
+	// 1 Arena of the layout and index type
+	uint32_t arenaIndex = 0;
+	while (arenaIndex < mArenas.size()) {
+
+		const Arena& arena = mArenas[arenaIndex];
+		if (arena.mLayout.encode() == geometry->getLayout().encode() && arena.mIndexType == geometry->getIndexType()) {
+			break;
+		}
+		arenaIndex++;
+	}
+
+	if (arenaIndex == mArenas.size()) {
+
+		Arena arena;
+		arena.mLayout = geometry->getLayout();
+		arena.mIndexType = geometry->getIndexType();
+		mArenas.push_back(arena);
+	}
+
+	// 2 Offsets are assigned by the next rebuild of the arena
+	Arena& arena = mArenas[arenaIndex];
+	arena.mGeometries.push_back(geometry);
+	arena.mDirty = true;
+
+	PoolRange range;
+	range.mGeometry = geometry;
+	range.mArena = arenaIndex;
+	range.mIndexCount = geometry->getIndicesCount();
+
+	uint32_t index = (uint32_t)mRanges.size();
+	mRanges.push_back(range);
+	mRangeIndices[geometry] = index;
+
+	return index;
+}
+
+uint32_t MeshPool::registerMaterial(PhongMaterial* material) {
+
+	auto iter = mMaterialIndices.find(material);
+	if (iter != mMaterialIndices.end()) {
+		return iter->second;
+	}
+
+	uint32_t index = (uint32_t)mMaterials.size();
+	mMaterials.push_back(material);
+	mMaterialIndices[material] = index;
+
+	return index;
+}
+
+uint64_t MeshPool::makeBatchKey(uint32_t arena, PhongMaterial* material) {
+
+	uint64_t cullFace = material->mCullFace == GL_FRONT ? 0 : (material->mCullFace == GL_BACK ? 1 : 2);
+
+	uint64_t state =
+		(uint64_t)material->mDepthTest |
+		((uint64_t)material->mDepthWrite << 1) |
+		((uint64_t)((material->mDepthFunc - GL_NEVER) & 0x7) << 2) |
+		((uint64_t)material->mFaceCulling << 5) |
+		((uint64_t)(material->mFrontFace == GL_CW) << 6) |
+		(cullFace << 7);
+
+	return ((uint64_t)(arena & 0xFF) << 56) | (state << 32) | (uint64_t)material->mDiffuse->getTexture();
+}
+
+void MeshPool::rebuild(Arena& arena) {
+
+	uint32_t stride = arena.mLayout.getStride();
+	uint32_t indexSize = IndexLayout::getSize(arena.mIndexType);
+
+	// 1 Offsets, in vertices and indices
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (Geometry* geometry : arena.mGeometries) {
+
+		PoolRange& range = mRanges[mRangeIndices[geometry]];
+		range.mBaseVertex = (int32_t)vertexCount;
+		range.mFirstIndex = (uint32_t)indexCount;
+
+		vertexCount += geometry->getVertexCount();
+		indexCount += geometry->getIndicesCount();
+	}
+
+	// 2 Fresh megabuffers, every geometry copied buffer to buffer without a CPU round trip
+	if (arena.mVbo == 0) {
+
+		glGenBuffers(1, &arena.mVbo);
+		glGenBuffers(1, &arena.mEbo);
+		glGenVertexArrays(1, &arena.mVao);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, arena.mVbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexCount * stride, nullptr, GL_STATIC_DRAW);
+	for (Geometry* geometry : arena.mGeometries) {
+
+		const PoolRange& range = mRanges[mRangeIndices[geometry]];
+		glBindBuffer(GL_COPY_READ_BUFFER, geometry->getVbo());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (size_t)range.mBaseVertex * stride, (size_t)geometry->getVertexCount() * stride);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, arena.mEbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCount * indexSize, nullptr, GL_STATIC_DRAW);
+	for (Geometry* geometry : arena.mGeometries) {
+
+		const PoolRange& range = mRanges[mRangeIndices[geometry]];
+		glBindBuffer(GL_COPY_READ_BUFFER, geometry->getEbo());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (size_t)range.mFirstIndex * indexSize, (size_t)geometry->getIndicesCount() * indexSize);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// 3 Same attribute layout as every geometry of the arena
+	GLStateCache::bindVertexArray(arena.mVao);
+	glBindBuffer(GL_ARRAY_BUFFER, arena.mVbo);
+	arena.mLayout.apply();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.mEbo);
+	GLStateCache::bindVertexArray(0);
+
+	arena.mDirty = false;
+}
+
+void MeshPool::prepare() {
+
+	// 1 Arenas that gained geometries this frame
+	bool rebuilt = false;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto& arena : mArenas) {
+
+		if (arena.mDirty) {
+			rebuild(arena);
+			rebuilt = true;
+		}
+	}
+
+	if (rebuilt) {
+
+		auto end = std::chrono::high_resolution_clock::now();
+		mStats.mBuildTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+		mStats.mVertexBytes = 0;
+		mStats.mIndexBytes = 0;
+		for (const auto& arena : mArenas) {
+			for (Geometry* geometry : arena.mGeometries) {
+
+				mStats.mVertexBytes += (size_t)geometry->getVertexCount() * arena.mLayout.getStride();
+				mStats.mIndexBytes += (size_t)geometry->getIndicesCount() * IndexLayout::getSize(arena.mIndexType);
+			}
+		}
+	}
+
+	// 2 Batches are runs of equal keys
+	std::sort(mDraws.begin(), mDraws.end(), [](const FrameDraw& a, const FrameDraw& b) { return a.mKey < b.mKey; });
+
+	mBatches.clear();
+	mCommands.clear();
+	mDrawData.clear();
+
+	for (size_t i = 0; i < mDraws.size(); i++) {
+
+		const FrameDraw& draw = mDraws[i];
+		const PoolRange& range = mRanges[draw.mRange];
+
+		if (i == 0 || draw.mKey != mDraws[i - 1].mKey) {
+
+			PoolBatch batch;
+			batch.mArena = range.mArena;
+			batch.mMaterial = draw.mMaterial;
+			batch.mFirstCommand = (uint32_t)i;
+			mBatches.push_back(batch);
+		}
+		mBatches.back().mCommandCount++;
+
+		// baseInstance is the draw index, the vertex shader reads gl_BaseInstance
+		DrawElementsIndirectCommand command;
+		command.count = range.mIndexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.mFirstIndex;
+		command.baseVertex = range.mBaseVertex;
+		command.baseInstance = (GLuint)i;
+		mCommands.push_back(command);
+
+		PoolDrawData data;
+		data.mModelMatrix = draw.mMesh->getModelMatrix();
+		data.mNormalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(data.mModelMatrix))));
+		data.mMaterial = draw.mMaterialIndex;
+		mDrawData.push_back(data);
+	}
+
+	// 3 Materials may be edited at any time, the table is small
+	mMaterialData.resize(mMaterials.size());
+	for (size_t i = 0; i < mMaterials.size(); i++) {
+
+		mMaterialData[i].mShiness = mMaterials[i]->mShiness;
+		mMaterialData[i].mOpacity = mMaterials[i]->mOpacity;
+	}
+
+	mStats.mGeometries = (unsigned int)mRanges.size();
+	mStats.mArenas = (unsigned int)mArenas.size();
+	mStats.mDraws = (unsigned int)mDraws.size();
+	mStats.mBatches = (unsigned int)mBatches.size();
+
+	if (mDraws.empty()) {
+		return;
+	}
+
+	// 4 One write per buffer for the frame
+	uploadBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer, mCommandCapacity, mCommands.data(), mCommands.size() * sizeof(DrawElementsIndirectCommand));
+	uploadBuffer(GL_SHADER_STORAGE_BUFFER, mDrawSsbo, mDrawCapacity, mDrawData.data(), mDrawData.size() * sizeof(PoolDrawData));
+	uploadBuffer(GL_SHADER_STORAGE_BUFFER, mMaterialSsbo, mMaterialCapacity, mMaterialData.data(), mMaterialData.size() * sizeof(PoolMaterialData));
+}
+
+void MeshPool::bind() const {
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PoolDrawBinding, mDrawSsbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PoolMaterialBinding, mMaterialSsbo);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+}
+
+void MeshPool::draw(const PoolBatch& batch) const {
+
+	const Arena& arena = mArenas[batch.mArena];
+
+	GLStateCache::bindVertexArray(arena.mVao);
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES,
+		arena.mIndexType,
+		(const void*)(sizeof(DrawElementsIndirectCommand) * batch.mFirstCommand),
+		batch.mCommandCount,
+		0);
+}
+
+void MeshPool::readOccluder(uint32_t range) {
+
+	Geometry* geometry = mRanges[range].mGeometry;
+	const VertexLayout& layout = geometry->getLayout();
+	Occluder& occluder = mOccluders[range];
+
+	// 1 Positions, the first attribute of every layout
+	uint32_t stride = layout.getStride();
+	std::vector<uint8_t> vertices((size_t)geometry->getVertexCount() * stride);
+	glBindBuffer(GL_COPY_READ_BUFFER, geometry->getVbo());
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices.size(), vertices.data());
+
+	occluder.mPositions.resize(geometry->getVertexCount());
+	for (uint32_t i = 0; i < geometry->getVertexCount(); i++) {
+
+		const uint8_t* vertex = vertices.data() + (size_t)i * stride;
+		if (layout.mPosition == PositionFormat::Half4) {
+
+			uint16_t half[3];
+			std::memcpy(half, vertex, sizeof(half));
+			occluder.mPositions[i] = glm::vec3(glm::unpackHalf1x16(half[0]), glm::unpackHalf1x16(half[1]), glm::unpackHalf1x16(half[2]));
+		}
+		else {
+
+			std::memcpy(&occluder.mPositions[i], vertex, sizeof(glm::vec3));
+		}
+	}
+
+	// 2 Indices widened to 32 bit
+	uint32_t count = geometry->getIndicesCount();
+	occluder.mIndices.resize(count);
+	glBindBuffer(GL_COPY_READ_BUFFER, geometry->getEbo());
+	if (geometry->getIndexType() == GL_UNSIGNED_SHORT) {
+
+		std::vector<uint16_t> indices(count);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (size_t)count * sizeof(uint16_t), indices.data());
+		std::copy(indices.begin(), indices.end(), occluder.mIndices.begin());
+	}
+	else {
+
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (size_t)count * sizeof(uint32_t), occluder.mIndices.data());
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void MeshPool::rasterizeOccluders(DepthPyramid& pyramid, const glm::mat4& viewProjection) {
+
+	if (mOccluders.size() < mRanges.size()) {
+		mOccluders.resize(mRanges.size());
+	}
+
+	for (const auto& draw : mDraws) {
+
+		Occluder& occluder = mOccluders[draw.mRange];
+		if (occluder.mIndices.empty()) {
+			readOccluder(draw.mRange);
+		}
+
+		pyramid.rasterize(
+			occluder.mPositions.data(),
+			occluder.mIndices.data(),
+			(uint32_t)occluder.mIndices.size(),
+			viewProjection * draw.mMesh->getModelMatrix());
+	}
+}
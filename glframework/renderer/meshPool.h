@@ -0,0 +1,156 @@
+#pragma once
+
+#include "../core.h"
+#include "../mesh/mesh.h"
+#include "../mesh/instancedMesh.h"
+#include "../material/phongMaterial.h"
+#include "../culling/depthPyramid.h"
+#include <cstdint>
+#include <unordered_map>
+
+// Shader storage bindings of the pool, past the texture table
+static const GLuint PoolDrawBinding = 4;
+static const GLuint PoolMaterialBinding = 5;
+
+// std430 image of PoolDraw in phong.vert under POOL, indexed by the baseInstance of the command
+struct PoolDrawData {
+	glm::mat4 mModelMatrix{ 1.0f };
+	glm::mat4 mNormalMatrix{ 1.0f };	// mat3 in the upper left
+	uint32_t mMaterial{ 0 };
+	uint32_t mPadding[3]{};
+};
+
+// std430 image of PoolMaterial in phong.frag under POOL
+struct PoolMaterialData {
+	float mShiness{ 1.0f };
+	float mOpacity{ 1.0f };
+	float mPadding[2]{};
+};
+
+static_assert(sizeof(PoolDrawData) == 144, "PoolDrawData must match the std430 layout");
+static_assert(sizeof(PoolMaterialData) == 16, "PoolMaterialData must match the std430 layout");
+
+// Where a geometry landed in the megabuffers of its arena
+struct PoolRange {
+	Geometry* mGeometry{ nullptr };
+	uint32_t mArena{ 0 };
+	uint32_t mFirstIndex{ 0 };
+	uint32_t mIndexCount{ 0 };
+	int32_t mBaseVertex{ 0 };
+};
+
+// Commands [mFirstCommand, mFirstCommand + mCommandCount) of one glMultiDrawElementsIndirect.
+// Every draw of the batch shares the arena, the diffuse texture and the render state of mMaterial
+struct PoolBatch {
+	uint32_t mArena{ 0 };
+	PhongMaterial* mMaterial{ nullptr };
+	uint32_t mFirstCommand{ 0 };
+	uint32_t mCommandCount{ 0 };
+};
+
+struct MeshPoolStats {
+	unsigned int mGeometries{ 0 };
+	unsigned int mArenas{ 0 };
+	unsigned int mDraws{ 0 };		// pooled meshes of the last frame
+	unsigned int mBatches{ 0 };		// multi draw calls of the last frame
+	size_t mVertexBytes{ 0 };
+	size_t mIndexBytes{ 0 };
+	float mBuildTime{ 0.0f };		// ms, last arena rebuild
+};
+
+// Static opaque Phong meshes suballocated into shared vertex and index buffers, one arena per
+// vertex layout and index type. Geometries are copied on the GPU the first frame they are drawn,
+// their own buffers stay for the unpooled paths (global material passes) and must outlive the pool.
+// Every frame is sorted into batches, each drawn with one glMultiDrawElementsIndirect
+class MeshPool {
+
+public:
+	MeshPool();
+	~MeshPool();
+
+	// Plain mesh, Phong material without blending or stencil
+	static bool accepts(Mesh* mesh, Material* material);
+
+	void begin();
+
+	void push(Mesh* mesh, PhongMaterial* material);
+
+	// Copy new geometries into their arena, sort the frame into batches and upload
+	// the commands, per draw data and materials
+	void prepare();
+
+	// Draw data and materials on their bindings, commands on GL_DRAW_INDIRECT_BUFFER
+	void bind() const;
+
+	// One glMultiDrawElementsIndirect, bind() first
+	void draw(const PoolBatch& batch) const;
+
+	// Pooled draws of the frame as occluders of pyramid. Geometries are read back from the GPU
+	// the first time, the copies stay for later frames
+	void rasterizeOccluders(DepthPyramid& pyramid, const glm::mat4& viewProjection);
+
+	const std::vector<PoolBatch>& getBatches() const { return mBatches; }
+
+	const MeshPoolStats& getStats() const { return mStats; }
+
+private:
+	struct Arena {
+		VertexLayout mLayout{};
+		GLenum mIndexType{ GL_UNSIGNED_INT };
+		GLuint mVao{ 0 };
+		GLuint mVbo{ 0 };
+		GLuint mEbo{ 0 };
+		std::vector<Geometry*> mGeometries{};
+		bool mDirty{ false };
+	};
+
+	struct FrameDraw {
+		uint64_t mKey{ 0 };
+		Mesh* mMesh{ nullptr };
+		PhongMaterial* mMaterial{ nullptr };
+		uint32_t mRange{ 0 };
+		uint32_t mMaterialIndex{ 0 };
+	};
+
+	uint32_t registerGeometry(Geometry* geometry);
+	uint32_t registerMaterial(PhongMaterial* material);
+
+	// Reallocate the megabuffers of arena and copy every geometry of it
+	void rebuild(Arena& arena);
+
+	void readOccluder(uint32_t range);
+
+	// arena:8 | render state:24 | diffuse texture:32, equal keys share a batch
+	static uint64_t makeBatchKey(uint32_t arena, PhongMaterial* material);
+
+private:
+	std::vector<Arena> mArenas{};
+	std::vector<PoolRange> mRanges{};
+	std::unordered_map<Geometry*, uint32_t> mRangeIndices{};
+
+	// CPU positions and 32 bit indices per range, empty until first rasterized
+	struct Occluder {
+		std::vector<glm::vec3> mPositions{};
+		std::vector<uint32_t> mIndices{};
+	};
+	std::vector<Occluder> mOccluders{};
+
+	std::vector<PhongMaterial*> mMaterials{};
+	std::unordered_map<Material*, uint32_t> mMaterialIndices{};
+
+	// Frame data, capacities kept between frames
+	std::vector<FrameDraw> mDraws{};
+	std::vector<PoolBatch> mBatches{};
+	std::vector<DrawElementsIndirectCommand> mCommands{};
+	std::vector<PoolDrawData> mDrawData{};
+	std::vector<PoolMaterialData> mMaterialData{};
+
+	GLuint mCommandBuffer{ 0 };
+	GLuint mDrawSsbo{ 0 };
+	GLuint mMaterialSsbo{ 0 };
+	size_t mCommandCapacity{ 0 };	// bytes
+	size_t mDrawCapacity{ 0 };
+	size_t mMaterialCapacity{ 0 };
+
+	MeshPoolStats mStats{};
+};
@@ -0,0 +1,139 @@
+#include "renderQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static const uint64_t DepthBits = 24;
+static const uint64_t DepthMax = (1ull << DepthBits) - 1;
+
+RenderQueue::RenderQueue() {}
+
+RenderQueue::~RenderQueue() {}
+
+void RenderQueue::begin(float far) {
+
+	mItems.clear();
+	mFar = far > 0.0f ? far : 1.0f;
+	mSubmission = 0;
+	mStats = RenderQueueStats();
+}
+
+uint64_t RenderQueue::quantizeDepth(float viewDepth) const {
+
+	float depth = glm::clamp(viewDepth / mFar, 0.0f, 1.0f);
+	return (uint64_t)(depth * (float)DepthMax);
+}
+
+void RenderQueue::push(
+	Mesh* mesh,
+	Material* material,
+	RenderLayer layer,
+	unsigned int shader,
+	unsigned int textureSet,
+	float viewDepth) {
+
+	RenderItem item;
+	item.mMesh = mesh;
+	item.mMaterial = material;
+	item.mShader = shader;
+	if (shader >= MaxShaders && !mShaderOverflow) {
+		// Programs past the key field would alias in the sort, widen the shader bits instead
+		std::cout << "Error: RenderQueue shader index " << shader << " exceeds " << MaxShaders << std::endl;
+		mShaderOverflow = true;
+	}
+	item.mTextureSet = textureSet & 0xFFFF;
+
+	uint64_t state =
+		((uint64_t)(item.mShader & (MaxShaders - 1)) << 32) |
+		((uint64_t)item.mTextureSet << 16) |
+		((uint64_t)material->getId() & 0xFFFF);
+
+	switch (layer) {
+	case RenderLayer::Opaque:
+		item.mKey = (state << DepthBits) | quantizeDepth(viewDepth);
+		mStats.mOpaqueDraws++;
+		break;
+	case RenderLayer::Ordered:
+		item.mKey = mSubmission;
+		mStats.mOrderedDraws++;
+		break;
+	case RenderLayer::Transparent:
+		item.mKey = ((DepthMax - quantizeDepth(viewDepth)) << 38) | state;
+		mStats.mTransparentDraws++;
+		break;
+	}
+
+	item.mKey |= (uint64_t)layer << 62;
+	mSubmission++;
+
+	mItems.push_back(item);
+}
+
+void RenderQueue::sort() {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	radixSort(mItems, mScratch);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.mSortTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+	// Switches the renderer will see along the sorted order
+	for (size_t i = 0; i < mItems.size(); i++) {
+
+		if (i == 0 || mItems[i].mShader != mItems[i - 1].mShader) {
+			mStats.mProgramSwitches++;
+		}
+		if (i == 0 || mItems[i].mTextureSet != mItems[i - 1].mTextureSet) {
+			mStats.mTextureSwitches++;
+		}
+	}
+}
+
+void RenderQueue::radixSort(std::vector<RenderItem>& items, std::vector<RenderItem>& scratch) {
+
+	if (items.size() < 2) {
+		return;
+	}
+
+	scratch.resize(items.size());
+
+	// 1 Every byte histogram in one read
+	unsigned int histograms[8][256] = {};
+	for (const auto& item : items) {
+		for (int pass = 0; pass < 8; pass++) {
+			histograms[pass][(item.mKey >> (pass * 8)) & 0xFF]++;
+		}
+	}
+
+	// 2 Stable scatter per byte, least significant first
+	std::vector<RenderItem>* source = &items;
+	std::vector<RenderItem>* target = &scratch;
+
+	for (int pass = 0; pass < 8; pass++) {
+
+		unsigned int* histogram = histograms[pass];
+
+		// Every key shares this byte
+		if (histogram[((*source)[0].mKey >> (pass * 8)) & 0xFF] == items.size()) {
+			continue;
+		}
+
+		unsigned int offsets[256];
+		unsigned int sum = 0;
+		for (int i = 0; i < 256; i++) {
+			offsets[i] = sum;
+			sum += histogram[i];
+		}
+
+		for (const auto& item : *source) {
+			(*target)[offsets[(item.mKey >> (pass * 8)) & 0xFF]++] = item;
+		}
+
+		std::swap(source, target);
+	}
+
+	if (source != &items) {
+		items.swap(scratch);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../core.h"
+#include "../mesh/mesh.h"
+#include <cstdint>
+
+// Draws are ordered by layer first, lower layers are drawn first
+enum class RenderLayer : uint64_t {
+	Opaque = 0,
+	Ordered = 1,		// stencil users, kept in scene order
+	Transparent = 2
+};
+
+struct RenderItem {
+	uint64_t mKey{ 0 };
+	Mesh* mMesh{ nullptr };
+	Material* mMaterial{ nullptr };
+	unsigned int mShader{ 0 };
+	unsigned int mTextureSet{ 0 };
+};
+
+struct RenderQueueStats {
+	unsigned int mOpaqueDraws{ 0 };
+	unsigned int mOrderedDraws{ 0 };
+	unsigned int mTransparentDraws{ 0 };
+	unsigned int mProgramSwitches{ 0 };
+	unsigned int mTextureSwitches{ 0 };
+	float mSortTime{ 0.0f }; // ms
+};
+
+// Frame draw list of 64 bit keys:
+//   opaque       layer:2 | shader:6 | texture set:16 | material:16 | depth:24 (front to back)
+//   ordered      layer:2 | submission index:62
+//   transparent  layer:2 | inverted depth:24 | shader:6 | texture set:16 | material:16 (back to front)
+class RenderQueue {
+
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	// Clear the frame, depths are quantized against the camera far plane
+	void begin(float far);
+
+	// Draw programs that fit the shader field of the key, see Shader::getDrawIndex
+	static const unsigned int MaxShaders = 64;
+
+	// viewDepth is the distance in front of the camera, computed once per draw.
+	// shader is the dense draw index, never the GL program name
+	void push(
+		Mesh* mesh,
+		Material* material,
+		RenderLayer layer,
+		unsigned int shader,
+		unsigned int textureSet,
+		float viewDepth);
+
+	// Radix sort the frame and count state switches along the final order
+	void sort();
+
+	const std::vector<RenderItem>& getItems() const { return mItems; }
+	const RenderQueueStats& getStats() const { return mStats; }
+
+	// LSD radix sort on the keys, byte passes that cannot reorder anything are skipped.
+	// scratch is resized to items and keeps its capacity between frames
+	static void radixSort(std::vector<RenderItem>& items, std::vector<RenderItem>& scratch);
+
+private:
+	uint64_t quantizeDepth(float viewDepth) const;
+
+private:
+	std::vector<RenderItem> mItems{};
+	std::vector<RenderItem> mScratch{};
+
+	float mFar{ 1.0f };
+	uint64_t mSubmission{ 0 };
+	bool mShaderOverflow{ false };
+
+	RenderQueueStats mStats{};
+};
@@ -8,21 +8,73 @@
 #include "../material/phongEnvMaterial.h"
 #include "../material/phongInstanceMaterial.h"
 #include "../material/grassInstanceMaterial.h"
+#include "../material/proceduralGrassMaterial.h"
 #include "../mesh/instancedMesh.h"
+#include "../glStateCache.h"
+#include "../bindlessTextures.h"
 #include <string>
 #include <algorithm>
 
 Renderer::Renderer() {
 
-	mPhongShader = new Shader("assets/shaders/phong.vert", "assets/shaders/phong.frag");
+	// Without the extension (Mesa software drivers) the same shaders declare plain samplers
+	mBindless = BindlessTextures::isSupported();
+	std::string defines = mBindless ? BindlessTextures::getShaderDefines() : "";
+
+	mPhongShader = new Shader("assets/shaders/phong.vert", "assets/shaders/phong.frag", defines);
 	mWhiteShader = new Shader("assets/shaders/white.vert", "assets/shaders/white.frag");
 	mDepthShader = new Shader("assets/shaders/depth.vert", "assets/shaders/depth.frag");
-	mOpacityMaskShader = new Shader("assets/shaders/phongOpacityMask.vert", "assets/shaders/phongOpacityMask.frag");
+	mOpacityMaskShader = new Shader("assets/shaders/phongOpacityMask.vert", "assets/shaders/phongOpacityMask.frag", defines);
 	mScreenShader = new Shader("assets/shaders/screen.vert", "assets/shaders/screen.frag");
 	mCubeShader = new Shader("assets/shaders/cube.vert", "assets/shaders/cube.frag");
-	mPhongEnvShader = new Shader("assets/shaders/phongEnv.vert", "assets/shaders/phongEnv.frag");
-	mPhongInstanceShader = new Shader("assets/shaders/phongInstance.vert", "assets/shaders/phongInstance.frag");
+	mPhongEnvShader = new Shader("assets/shaders/phongEnv.vert", "assets/shaders/phongEnv.frag", defines);
+	mPhongInstanceShader = new Shader("assets/shaders/phongInstance.vert", "assets/shaders/phongInstance.frag", defines);
 	mGrassInstanceShader = new Shader("assets/shaders/grassInstance.vert", "assets/shaders/grassInstance.frag");
+	mGrassInstanceCompactShader = new Shader("assets/shaders/grassInstanceCompact.vert", "assets/shaders/grassInstance.frag");
+	mGrassProceduralShader = new Shader("assets/shaders/grassProcedural.vert", "assets/shaders/grassInstance.frag");
+	// Same Phong stages, model, normal matrix and material come from the pool tables
+	mPhongPoolShader = new Shader("assets/shaders/phong.vert", "assets/shaders/phong.frag", "#define POOL\n");
+
+	mGrassUniforms.resolve(mGrassInstanceShader);
+	mGrassCompactUniforms.resolve(mGrassInstanceCompactShader);
+	mGrassProceduralUniforms.resolve(mGrassProceduralShader);
+
+	// Names past the small string buffer would allocate on every draw
+	mOpacityMaskSampler = mOpacityMaskShader->uniform("opacityMaskSampler");
+	mScreenSampler = mScreenShader->uniform("screemTexSampler");
+
+	mInstanceCuller = new InstanceCuller();
+	mUniformBuffers = new UniformBuffers();
+	mTextureTable = new TextureTable();
+	mMeshPool = new MeshPool();
+	mHiZCuller = new HiZCuller(mDepthPyramid.getWidth(), mDepthPyramid.getHeight());
+}
+
+void GrassUniforms::resolve(Shader* shader) {
+
+	mTextures = shader->uniform("grassTextures");
+	mMasks = shader->uniform("grassMasks");
+	mDiffuseLayer = shader->uniform("diffuseLayer");
+	mOpacityLayer = shader->uniform("opacityLayer");
+	mCloudLayer = shader->uniform("cloudLayer");
+
+	mModelMatrix = shader->uniform("modelMatrix");
+
+	mShiness = shader->uniform("shiness");
+
+	mOpacity = shader->uniform("opacity");
+	mUVScale = shader->uniform("uvScale");
+	mBrightness = shader->uniform("brightness");
+
+	mWindScale = shader->uniform("windScale");
+	mPhaseScale = shader->uniform("phaseScale");
+	mWindDirection = shader->uniform("windDirection");
+
+	mCloudWhiteColor = shader->uniform("cloudWhiteColor");
+	mCloudBlackColor = shader->uniform("cloudBlackColor");
+	mCloudUVScale = shader->uniform("cloudUVScale");
+	mCloudSpeed = shader->uniform("cloudSpeed");
+	mCloudLerp = shader->uniform("cloudLerp");
 }
 
 Renderer::~Renderer() {
@@ -44,97 +96,192 @@ void Renderer::render(
 
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
+	// 0 Anything outside the renderer (ImGui) may have moved the GL state
+	GLStateCache::invalidate();
+	GLStateCache::resetStats();
+
 
 	// 1 Depth and stencil test
 	// 1.1 Depth test
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	glDepthMask(GL_TRUE);
+	GLStateCache::enable(GL_DEPTH_TEST);
+	GLStateCache::depthFunc(GL_LESS);
+	GLStateCache::depthMask(GL_TRUE);
 
 	// 1.2 Polygon offset
-	glDisable(GL_POLYGON_OFFSET_FILL);
-	glDisable(GL_POLYGON_OFFSET_LINE);
+	GLStateCache::disable(GL_POLYGON_OFFSET_FILL);
+	GLStateCache::disable(GL_POLYGON_OFFSET_LINE);
 
 	// 1.3 Stencil test
-	glEnable(GL_STENCIL_TEST);
+	GLStateCache::enable(GL_STENCIL_TEST);
 
-	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	GLStateCache::stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 
-	glStencilMask(0xFF);
+	GLStateCache::stencilMask(0xFF);
 
 
 	// 1.4 Blend
-	glDisable(GL_BLEND);
+	GLStateCache::disable(GL_BLEND);
 
 
-	// 2 Clear canvas
+	// 2 Clear canvas and per frame counters
+	InstancedMesh::resetUploadBytes();
+	Shader::resetUniformStats();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-	// 3 Clear two containers
-	mOpacityObjects.clear();
-	mTransparentObjects.clear();
+	// 3 Frustum for culling
+	mViewProjectionMatrix = camera->getProjectionMatrix() * camera->getViewMatrix();
+	mFrustum.setFromMatrix(mViewProjectionMatrix);
 
-	projectObject(scene);
+	// 3.1 Camera and light blocks, shared by every program of the frame
+	mUniformBuffers->update(camera, dirLight, ambLight, (float)glfwGetTime());
 
-	std::sort(
-		mTransparentObjects.begin(),
-		mTransparentObjects.end(),
-		[camera](const Mesh* a, const Mesh* b) {
+	// 3.2 Skyboxes follow the camera, moved before the transforms of the frame are flushed
+	scene->forEachDescendant<Mesh>(ObjectType::Mesh, [camera](Mesh* mesh) {
+		if (mesh->mMaterial->mType == MaterialType::CubeMaterial) {
+			mesh->setPosition(camera->mPosition);
+		}
+	});
+
+	// 4 Build and sort the frame queue, view depths are computed once per draw
+	TransformSystem::getDefault().update();
+	mRenderQueue.begin(camera->mFar);
+	mMeshPool->begin();
+	projectObject(scene, camera->getViewMatrix());
+	mRenderQueue.sort();
+	mMeshPool->prepare();
+
+	// 4.1 Handles of every draw in one upload, entry i belongs to item i
+	const auto& items = mRenderQueue.getItems();
+	if (mBindless) {
+
+		mTextureTable->begin();
+		for (const auto& item : items) {
+
+			Texture* textures[3] = { nullptr, nullptr, nullptr };
+			if (isBindlessMaterial(item.mMaterial->mType)) {
+				getTextures(item.mMaterial, textures);
+			}
+			mTextureTable->push(textures[0], textures[1]);
+		}
+		mTextureTable->upload();
+	}
+
+	// 4.2 Occluders of the frame are the pooled static meshes, one pyramid per culling path
+	mOccludedMeshes = 0;
+	if (mOcclusionCulling) {
 
+		mDepthPyramid.clear();
+		mMeshPool->rasterizeOccluders(mDepthPyramid, mViewProjectionMatrix);
+		mDepthPyramid.build();
 
-			auto viewMatrix = camera->getViewMatrix();
+		mHiZCuller->build(mMeshPool, mViewProjectionMatrix, fbo);
+	}
+
+	// 5 Pooled static meshes are opaque, drawn before the queue
+	renderPool();
 
-			auto modelMatrixA = a->getModelMatrix();
-			auto worldPositionA = modelMatrixA * glm::vec4(0.0, 0.0, 0.0, 1.0);
-			auto cameraPositionA = viewMatrix * worldPositionA;
+	// 5.1 Render in key order
+	for (size_t i = 0; i < items.size(); i++) {
 
-			auto modelMatrixB = b->getModelMatrix();
-			auto worldPositionB = modelMatrixB * glm::vec4(0.0, 0.0, 0.0, 1.0);
-			auto cameraPositionB = viewMatrix * worldPositionB;
+		if (mOcclusionCulling && isOccluded(items[i].mMesh, items[i].mMaterial)) {
 
-			return cameraPositionA.z < cameraPositionB.z;
+			mOccludedMeshes++;
+			continue;
 		}
-	);
 
-	// 4 Render two containers
-	for (int i = 0; i < mOpacityObjects.size(); i++) {
+		renderObject(items[i].mMesh, camera, (unsigned int)i);
+	}
+}
 
-		renderObject(mOpacityObjects[i], camera, dirLight, ambLight);
+bool Renderer::isOccluded(Mesh* mesh, Material* material) const {
 
+	// Instances are tested one by one while culling, skyboxes and overlays ignore depth,
+	// stencil writers may act on a failed depth test
+	if (mesh->getType() != ObjectType::Mesh || !material->mDepthTest || material->mStencilTest) {
+		return false;
 	}
 
+	// Procedural blades are placed in the vertex shader, the geometry bounds hold one blade only
+	if (material->mType == MaterialType::ProceduralGrassMaterial) {
+		return false;
+	}
 
-	for (int i = 0; i < mTransparentObjects.size(); i++) {
+	return mDepthPyramid.isOccluded(
+		mesh->mGeometry->getBoundingMin(),
+		mesh->mGeometry->getBoundingMax(),
+		mViewProjectionMatrix * mesh->getModelMatrix());
+}
 
-		renderObject(mTransparentObjects[i], camera, dirLight, ambLight);
 
-	}
+void Renderer::projectObject(Object* obj, const glm::mat4& viewMatrix) {
 
+	obj->forEachDescendant([&](Object* node) {
 
-}
+		if (node->getType() != ObjectType::Mesh && node->getType() != ObjectType::InstancedMesh) {
+			return;
+		}
 
+		Mesh* mesh = (Mesh*)node;
+		Material* material = mGlobalMaterial != nullptr ? mGlobalMaterial : mesh->mMaterial;
 
-void Renderer::projectObject(Object* obj) {
+		// A global material pass draws every mesh through its own geometry
+		if (mGlobalMaterial == nullptr && MeshPool::accepts(mesh, material)) {
 
-	if (obj->getType() == ObjectType::Mesh || obj->getType() == ObjectType::InstancedMesh) {
+			mMeshPool->push(mesh, (PhongMaterial*)material);
+			return;
+		}
 
-		Mesh* mesh = (Mesh*)obj;
-		auto material = mesh->mMaterial;
+		RenderLayer layer = RenderLayer::Opaque;
 		if (material->mBlend) {
 
-			mTransparentObjects.push_back(mesh);
+			layer = RenderLayer::Transparent;
 		}
-		else {
+		else if (material->mStencilTest) {
 
-			mOpacityObjects.push_back(mesh);
+			// Stencil writers and readers depend on the scene order
+			layer = RenderLayer::Ordered;
 		}
+
+		glm::vec4 viewPosition = viewMatrix * mesh->getModelMatrix() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		mRenderQueue.push(
+			mesh,
+			material,
+			layer,
+			selectShader(mesh, material)->getDrawIndex(),
+			getTextureSet(material),
+			-viewPosition.z);
+	});
+}
+
+void Renderer::renderPool() {
+
+	const auto& batches = mMeshPool->getBatches();
+	if (batches.empty()) {
+		return;
 	}
 
-	auto children = obj->getChildren();
-	for (int i = 0; i < children.size(); i++) {
+	mPhongPoolShader->begin();
+	mPhongPoolShader->setInt("sampler", 0);
+	mMeshPool->bind();
+
+	for (const auto& batch : batches) {
+
+		// 1 State and diffuse are shared by the whole batch
+		PhongMaterial* material = batch.mMaterial;
+		setDepthState(material);
+		setPolygonOffsetState(material);
+		setStencilState(material);
+		setBlendState(material);
+		setFaceCullingState(material);
+
+		material->mDiffuse->bind();
 
-		projectObject(children[i]);
+		// 2 One call for every sub-mesh of the batch
+		mMeshPool->draw(batch);
 	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
 
 Shader* Renderer::pickShader(MaterialType type) {
@@ -170,6 +317,9 @@ Shader* Renderer::pickShader(MaterialType type) {
 	case MaterialType::GrassInstanceMaterial:
 		result = mGrassInstanceShader;
 		break;
+	case MaterialType::ProceduralGrassMaterial:
+		result = mGrassProceduralShader;
+		break;
 	default:
 		std::cout << "Unkown material type to shader" << std::endl;
 		break;
@@ -178,12 +328,101 @@ Shader* Renderer::pickShader(MaterialType type) {
 	return result;
 }
 
+Shader* Renderer::selectShader(Mesh* mesh, Material* material) {
+
+	Shader* shader = pickShader(material->mType);
+	if (material->mType == MaterialType::GrassInstanceMaterial &&
+		mesh->getType() == ObjectType::InstancedMesh &&
+		((InstancedMesh*)mesh)->isCompactDrawn()) {
+
+		// Same fragment stage, the instance transform is rebuilt from the packed attributes
+		shader = mGrassInstanceCompactShader;
+	}
+
+	return shader;
+}
+
+bool Renderer::isBindlessMaterial(MaterialType type) {
+
+	// Grass keeps its array bound, its sampler is edited at runtime and a handle would freeze it
+	switch (type) {
+	case MaterialType::PhongMaterial:
+	case MaterialType::OpacityMaskMaterial:
+	case MaterialType::PhongEnvMaterial:
+	case MaterialType::PhongInstanceMaterial:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Renderer::getTextures(Material* material, Texture* textures[3]) {
+
+	switch (material->mType) {
+
+	case MaterialType::PhongMaterial:
+		textures[0] = ((PhongMaterial*)material)->mDiffuse;
+		break;
+	case MaterialType::OpacityMaskMaterial:
+		textures[0] = ((OpacityMaskMaterial*)material)->mDiffuse;
+		textures[1] = ((OpacityMaskMaterial*)material)->mOpacityMask;
+		break;
+	case MaterialType::ScreenMaterial:
+		textures[0] = ((ScreenMaterial*)material)->mScreenTexture;
+		break;
+	case MaterialType::CubeMaterial:
+		textures[0] = ((CubeMaterial*)material)->mDiffuse;
+		break;
+	case MaterialType::PhongEnvMaterial:
+		textures[0] = ((PhongEnvMaterial*)material)->mDiffuse;
+		textures[1] = ((PhongEnvMaterial*)material)->mEnv;
+		break;
+	case MaterialType::PhongInstanceMaterial:
+		textures[0] = ((PhongInstanceMaterial*)material)->mDiffuse;
+		break;
+	case MaterialType::GrassInstanceMaterial:
+	case MaterialType::ProceduralGrassMaterial:
+		textures[0] = ((GrassInstanceMaterial*)material)->mTextures;
+		textures[1] = ((GrassInstanceMaterial*)material)->mMasks;
+		break;
+	default:
+		break;
+	}
+}
+
+unsigned int Renderer::getTextureSet(Material* material) {
+
+	Texture* textures[3] = { nullptr, nullptr, nullptr };
+	getTextures(material, textures);
+
+	// Texture names folded into the 16 bit key field, materials sharing textures sort together
+	unsigned int hash = 2166136261u;
+	for (Texture* texture : textures) {
+
+		hash ^= texture != nullptr ? texture->getTexture() : 0u;
+		hash *= 16777619u;
+	}
+
+	return (hash ^ (hash >> 16)) & 0xFFFF;
+}
+
+const GrassUniforms& Renderer::getGrassUniforms(Shader* shader) const {
+
+	if (shader == mGrassInstanceCompactShader) {
+		return mGrassCompactUniforms;
+	}
+	if (shader == mGrassProceduralShader) {
+		return mGrassProceduralUniforms;
+	}
+
+	return mGrassUniforms;
+}
+
 // Render single object 
 void Renderer::renderObject(
 	Object* object,
 	Camera* camera,
-	DirectionalLight* dirLight,
-	AmbientLight* ambLight
+	unsigned int textureIndex
 ) {
 
 	// 1 Render only mesh
@@ -211,8 +450,39 @@ void Renderer::renderObject(
 		setBlendState(material);
 		setFaceCullingState(material);
 
+		// 2.1 Cull instances before the draw program is bound
+		if (object->getType() == ObjectType::InstancedMesh) {
+
+			InstancedMesh* im = (InstancedMesh*)mesh;
+
+			// Only edited instances are uploaded
+			im->updateMatrices();
+
+			float boundsMargin = 0.0f;
+			if (material->mType == MaterialType::GrassInstanceMaterial) {
+
+				// Wind moves blades outside their rest bounds
+				boundsMargin = ((GrassInstanceMaterial*)material)->mWindScale;
+			}
+
+			if (im->getGpuCulling()) {
+
+				mInstanceCuller->cull(im, mFrustum, boundsMargin, mOcclusionCulling ? mHiZCuller : nullptr);
+			}
+			else if (im->getChunkCulling()) {
+
+				im->getGrassField()->cull(mViewProjectionMatrix * im->getModelMatrix(), boundsMargin, mOcclusionCulling ? &mDepthPyramid : nullptr);
+			}
+
+			if (im->getLodEnabled() && !im->getGpuCulling()) {
+
+				glm::vec3 localCameraPosition = glm::vec3(glm::inverse(im->getModelMatrix()) * glm::vec4(camera->mPosition, 1.0f));
+				im->updateLods(localCameraPosition);
+			}
+		}
+
 		// 3.1 Choose shader
-		Shader* shader = pickShader(material->mType);
+		Shader* shader = selectShader(mesh, material);
 
 		// 3.2 Update uniform
 		// 3.2.1 Create program
@@ -224,9 +494,16 @@ void Renderer::renderObject(
 			// pointer type change
 			PhongMaterial* phongMat = (PhongMaterial*)material;
 
-			// Texture bind and sampling
-			shader->setInt("sampler", 0);
-			phongMat->mDiffuse->bind();
+			// Texture bind and sampling, a bindless draw only selects its table entry
+			if (mBindless) {
+
+				shader->setUnsignedInt("textureIndex", textureIndex);
+			}
+			else {
+
+				shader->setInt("sampler", 0);
+				phongMat->mDiffuse->bind();
+			}
 
 			//// Specular mask bind and sampling
 			//shader->setInt("specularMaskSampler", 1);
@@ -234,26 +511,13 @@ void Renderer::renderObject(
 
 			// 3.2.3 MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
 
 			auto normalMatrix = glm::mat3(glm::transpose(glm::inverse(mesh->getModelMatrix())));
 			shader->setMatrix3x3("normalMatrix", normalMatrix);
 
-			// 3.2.3 Light
-			shader->setVector3("directionalLight.color", dirLight->mColor);
-			shader->setVector3("directionalLight.direction", dirLight->mDirection);
-			shader->setFloat("directionalLight.specularIntensity", dirLight->mSpecularIntensity);
-			shader->setFloat("directionalLight.intensity", dirLight->mIntensity);
-
+			// 3.2.3 Shininess, directional and ambient light are in LightBlock
 			shader->setFloat("shiness", phongMat->mShiness);
 
-			shader->setVector3("ambientColor", ambLight->mColor);
-
-
-			// 3.2.4 Camera
-			shader->setVector3("cameraPosition", camera->mPosition);
-
 			// 3.2.5 Opacity
 			shader->setFloat("opacity", material->mOpacity);
 		}
@@ -261,19 +525,12 @@ void Renderer::renderObject(
 		case MaterialType::WhiteMaterial: {
 			// MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
 		}
 										break;
 		case MaterialType::DepthMaterial: {
 
 			// MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
-
-			shader->setFloat("near", camera->mNear);
-			shader->setFloat("far", camera->mFar);
 		}
 										break;
 		case MaterialType::OpacityMaskMaterial: {
@@ -282,34 +539,29 @@ void Renderer::renderObject(
 			OpacityMaskMaterial* opacityMat = (OpacityMaskMaterial*)material;
 
 			// Texture bind and sampling
-			shader->setInt("sampler", 0);
-			opacityMat->mDiffuse->bind();
+			if (mBindless) {
 
-			//// Specular mask bind and sampling
-			shader->setInt("opacityMaskSampler", 1);
-			opacityMat->mOpacityMask->bind();
+				shader->setUnsignedInt("textureIndex", textureIndex);
+			}
+			else {
+
+				shader->setInt("sampler", 0);
+				opacityMat->mDiffuse->bind();
+
+				//// Specular mask bind and sampling
+				shader->setInt(mOpacityMaskSampler, 1);
+				opacityMat->mOpacityMask->bind();
+			}
 
 			// 3.2.3 MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
 
 			auto normalMatrix = glm::mat3(glm::transpose(glm::inverse(mesh->getModelMatrix())));
 			shader->setMatrix3x3("normalMatrix", normalMatrix);
 
-			// 3.2.3 Light
-			shader->setVector3("directionalLight.color", dirLight->mColor);
-			shader->setVector3("directionalLight.direction", dirLight->mDirection);
-			shader->setFloat("directionalLight.specularIntensity", dirLight->mSpecularIntensity);
-
+			// 3.2.3 Shininess, directional and ambient light are in LightBlock
 			shader->setFloat("shiness", opacityMat->mShiness);
 
-			shader->setVector3("ambientColor", ambLight->mColor);
-
-
-			// 3.2.4 Camera
-			shader->setVector3("cameraPosition", camera->mPosition);
-
 			// 3.2.5 Opacity
 			shader->setFloat("opacity", material->mOpacity);
 										}
@@ -319,7 +571,7 @@ void Renderer::renderObject(
 			ScreenMaterial* screenMat = (ScreenMaterial*)material;
 
 			// Texture bind and sampling
-			shader->setInt("screemTexSampler", 0);
+			shader->setInt(mScreenSampler, 0);
 			screenMat->mScreenTexture->bind();
 
 			shader->setFloat("texWidth", 1600);
@@ -329,11 +581,8 @@ void Renderer::renderObject(
 		case MaterialType::CubeMaterial: {
 
 			CubeMaterial* cubeMat = (CubeMaterial*)material;
-			mesh->setPosition(camera->mPosition);
 			// MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
 
 			// Texture bind and sampling
 			shader->setInt("cubeSampler", 0);
@@ -345,33 +594,28 @@ void Renderer::renderObject(
 			PhongEnvMaterial* phongMat = (PhongEnvMaterial*)material;
 
 			// Texture bind and sampling
-			shader->setInt("sampler", 0);
-			phongMat->mDiffuse->bind();
+			if (mBindless) {
+
+				shader->setUnsignedInt("textureIndex", textureIndex);
+			}
+			else {
 
-			shader->setInt("envSampler", 1);
-			phongMat->mEnv->bind();
+				shader->setInt("sampler", 0);
+				phongMat->mDiffuse->bind();
+
+				shader->setInt("envSampler", 1);
+				phongMat->mEnv->bind();
+			}
 
 			// 3.2.3 MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
 
 			auto normalMatrix = glm::mat3(glm::transpose(glm::inverse(mesh->getModelMatrix())));
 			shader->setMatrix3x3("normalMatrix", normalMatrix);
 
-			// 3.2.3 Light
-			shader->setVector3("directionalLight.color", dirLight->mColor);
-			shader->setVector3("directionalLight.direction", dirLight->mDirection);
-			shader->setFloat("directionalLight.specularIntensity", dirLight->mSpecularIntensity);
-
+			// 3.2.3 Shininess, directional and ambient light are in LightBlock
 			shader->setFloat("shiness", phongMat->mShiness);
 
-			shader->setVector3("ambientColor", ambLight->mColor);
-
-
-			// 3.2.4 Camera
-			shader->setVector3("cameraPosition", camera->mPosition);
-
 			// 3.2.5 Opacity
 			shader->setFloat("opacity", material->mOpacity);
 
@@ -383,8 +627,15 @@ void Renderer::renderObject(
 			InstancedMesh* im = (InstancedMesh*)mesh;
 
 			// Texture bind and sampling
-			shader->setInt("sampler", 0);
-			phongMat->mDiffuse->bind();
+			if (mBindless) {
+
+				shader->setUnsignedInt("textureIndex", textureIndex);
+			}
+			else {
+
+				shader->setInt("sampler", 0);
+				phongMat->mDiffuse->bind();
+			}
 
 			//// Specular mask bind and sampling
 			//shader->setInt("specularMaskSampler", 1);
@@ -392,85 +643,72 @@ void Renderer::renderObject(
 
 			// 3.2.3 MVP matrix
 			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
 
 			auto normalMatrix = glm::mat3(glm::transpose(glm::inverse(mesh->getModelMatrix())));
 			shader->setMatrix3x3("normalMatrix", normalMatrix);
 
-			// 3.2.3 Light
-			shader->setVector3("directionalLight.color", dirLight->mColor);
-			shader->setVector3("directionalLight.direction", dirLight->mDirection);
-			shader->setFloat("directionalLight.specularIntensity", dirLight->mSpecularIntensity);
-
+			// 3.2.3 Shininess, directional and ambient light are in LightBlock
 			shader->setFloat("shiness", phongMat->mShiness);
 
-			shader->setVector3("ambientColor", ambLight->mColor);
-
-
-			// 3.2.4 Camera
-			shader->setVector3("cameraPosition", camera->mPosition);
-
 			// 3.2.5 Opacity
 			shader->setFloat("opacity", material->mOpacity);
 		}
 									     break;
+		case MaterialType::ProceduralGrassMaterial: {
+
+			ProceduralGrassMaterial* proceduralMat = (ProceduralGrassMaterial*)material;
+
+			// Placement, everything else is shared with the instanced grass below
+			shader->setUnsignedInt("gridRows", proceduralMat->mRows);
+			shader->setUnsignedInt("gridColumns", proceduralMat->mColumns);
+			shader->setFloat("gridSpacing", proceduralMat->mSpacing);
+			shader->setUnsignedInt("seed", proceduralMat->mSeed);
+			shader->setFloat("maxYaw", proceduralMat->mMaxYaw);
+
+			shader->setInt("useDensityMap", proceduralMat->mDensityMap != nullptr);
+			if (proceduralMat->mDensityMap != nullptr) {
+
+				shader->setInt("densityMap", 3);
+				proceduralMat->mDensityMap->bind();
+			}
+		}
+			[[fallthrough]];
 		case MaterialType::GrassInstanceMaterial: {
 			
 			// pointer type change
 			GrassInstanceMaterial* grassMat = (GrassInstanceMaterial*)material;
-			InstancedMesh* im = (InstancedMesh*)mesh;
 
-			im->sortMatrices(camera->getViewMatrix());
-			im->updateMatrices();
-
-			// Texture bind and sampling
-			shader->setInt("sampler", 0);
-			grassMat->mDiffuse->bind();
+			const GrassUniforms& uniforms = getGrassUniforms(shader);
 
-			// Opacity mask
-			shader->setInt("opacityMask", 1);
-			grassMat->mOpacityMask->bind();
-
-			shader->setInt("cloudMask", 2);
-			grassMat->mCloudMask->bind();
+			// Diffuse array on unit 0, opacity and cloud mask array on unit 1
+			shader->setInt(uniforms.mTextures, 0);
+			grassMat->mTextures->bind();
+			shader->setInt(uniforms.mMasks, 1);
+			grassMat->mMasks->bind();
+			shader->setInt(uniforms.mDiffuseLayer, grassMat->mDiffuseLayer);
+			shader->setInt(uniforms.mOpacityLayer, grassMat->mOpacityLayer);
+			shader->setInt(uniforms.mCloudLayer, grassMat->mCloudLayer);
 
 			// 3.2.3 MVP matrix
-			shader->setMatrix4x4("modelMatrix", mesh->getModelMatrix());
-			shader->setMatrix4x4("viewMatrix", camera->getViewMatrix());
-			shader->setMatrix4x4("projectionMatrix", camera->getProjectionMatrix());
-
-			//auto normalMatrix = glm::mat3(glm::transpose(glm::inverse(mesh->getModelMatrix())));
-			//shader->setMatrix3x3("normalMatrix", normalMatrix);
-
-			// 3.2.3 Light
-			shader->setVector3("directionalLight.color", dirLight->mColor);
-			shader->setVector3("directionalLight.direction", dirLight->mDirection);
-			shader->setFloat("directionalLight.specularIntensity", dirLight->mSpecularIntensity);
-
-			shader->setFloat("shiness", grassMat->mShiness);
-
-			shader->setVector3("ambientColor", ambLight->mColor);
-
+			shader->setMatrix4x4(uniforms.mModelMatrix, mesh->getModelMatrix());
 
-			// 3.2.4 Camera
-			shader->setVector3("cameraPosition", camera->mPosition);
+			// 3.2.3 Shininess, directional and ambient light are in LightBlock
+			shader->setFloat(uniforms.mShiness, grassMat->mShiness);
 
 			// 3.2.5 Opacity
-			shader->setFloat("opacity", grassMat->mOpacity);
-			shader->setFloat("uvScale", grassMat->mUVScale);
-			shader->setFloat("brightness", grassMat->mBrightness);
-			shader->setFloat("time", glfwGetTime());
-
-			shader->setFloat("windScale", grassMat->mWindScale);
-			shader->setFloat("phaseScale", grassMat->mPhaseScale);
-			shader->setVector3("windDirection", grassMat->mWindDirection);
-
-			shader->setVector3("cloudWhiteColor", grassMat->mCloudWhiteColor);
-			shader->setVector3("cloudBlackColor", grassMat->mCloudBlackColor);
-			shader->setFloat("cloudUVScale", grassMat->mCloudUVScale);
-			shader->setFloat("cloudSpeed", grassMat->mCloudSpeed);
-			shader->setFloat("cloudLerp", grassMat->mCloudLerp);
+			shader->setFloat(uniforms.mOpacity, grassMat->mOpacity);
+			shader->setFloat(uniforms.mUVScale, grassMat->mUVScale);
+			shader->setFloat(uniforms.mBrightness, grassMat->mBrightness);
+
+			shader->setFloat(uniforms.mWindScale, grassMat->mWindScale);
+			shader->setFloat(uniforms.mPhaseScale, grassMat->mPhaseScale);
+			shader->setVector3(uniforms.mWindDirection, grassMat->mWindDirection);
+
+			shader->setVector3(uniforms.mCloudWhiteColor, grassMat->mCloudWhiteColor);
+			shader->setVector3(uniforms.mCloudBlackColor, grassMat->mCloudBlackColor);
+			shader->setFloat(uniforms.mCloudUVScale, grassMat->mCloudUVScale);
+			shader->setFloat(uniforms.mCloudSpeed, grassMat->mCloudSpeed);
+			shader->setFloat(uniforms.mCloudLerp, grassMat->mCloudLerp);
 		}
 												break;
 		default:
@@ -478,18 +716,56 @@ void Renderer::renderObject(
 		}
 
 		// 3.3 VAO
-		glBindVertexArray(geometry->getVao());
+		GLStateCache::bindVertexArray(geometry->getVao());
 
 		// 3.4 Draw
 		if (object->getType() == ObjectType::InstancedMesh) {
 
 			InstancedMesh* im = (InstancedMesh*)mesh;
-			glDrawElementsInstanced(GL_TRIANGLES, geometry->getIndicesCount(), GL_UNSIGNED_INT, 0, im->mInstanceCount);
+			if (im->getGpuCulling()) {
+
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, im->mIndirectBuffer);
+				glDrawElementsIndirect(GL_TRIANGLES, geometry->getIndexType(), 0);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			}
+			else if (im->getLodEnabled()) {
+
+				// Every distance bucket is drawn with its own geometry
+				for (const auto& lod : im->mLods) {
+
+					if (lod.mInstanceCount == 0) {
+						continue;
+					}
+
+					GLStateCache::bindVertexArray(lod.mGeometry->getVao());
+					glDrawElementsInstanced(GL_TRIANGLES, lod.mGeometry->getIndicesCount(), lod.mGeometry->getIndexType(), 0, lod.mInstanceCount);
+				}
+			}
+			else if (im->getChunkCulling()) {
+
+				// baseInstance offsets the instanced attributes to the first instance of the range
+				for (const auto& range : im->getGrassField()->getDrawRanges()) {
+
+					glDrawElementsInstancedBaseInstance(GL_TRIANGLES, geometry->getIndicesCount(), geometry->getIndexType(), 0, range.mInstanceCount, range.mBaseInstance);
+				}
+			}
+			else {
+
+				glDrawElementsInstanced(GL_TRIANGLES, geometry->getIndicesCount(), geometry->getIndexType(), 0, im->mInstanceCount);
+			}
+
+			im->fenceMatrices();
+
+		}
+		else if (material->mType == MaterialType::ProceduralGrassMaterial) {
 
+			// Blades come from gl_InstanceID, no instance attributes
+			unsigned int instanceCount = ((ProceduralGrassMaterial*)material)->getInstanceCount();
+			glDrawElementsInstanced(GL_TRIANGLES, geometry->getIndicesCount(), geometry->getIndexType(), 0, instanceCount);
 		}
 		else {
 
-			glDrawElements(GL_TRIANGLES, geometry->getIndicesCount(), GL_UNSIGNED_INT, 0);
+			glDrawElements(GL_TRIANGLES, geometry->getIndicesCount(), geometry->getIndexType(), 0);
 
 		}
 	}
@@ -500,22 +776,22 @@ void Renderer::setDepthState(Material* material) {
 
 	if (material->mDepthTest) {
 
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(material->mDepthFunc);
+		GLStateCache::enable(GL_DEPTH_TEST);
+		GLStateCache::depthFunc(material->mDepthFunc);
 	}
 	else {
 
-		glDisable(GL_DEPTH_TEST);
+		GLStateCache::disable(GL_DEPTH_TEST);
 	}
 
 	// 2.2 Depth write
 	if (material->mDepthWrite) {
 
-		glDepthMask(GL_TRUE);
+		GLStateCache::depthMask(GL_TRUE);
 	}
 	else {
 
-		glDepthMask(GL_FALSE);
+		GLStateCache::depthMask(GL_FALSE);
 	}
 
 }
@@ -524,13 +800,13 @@ void Renderer::setPolygonOffsetState(Material* material) {
 
 	if (material->mPolygonOffset) {
 
-		glEnable(material->mPolygonOffsetType);
-		glPolygonOffset(material->mFactor, material->mUnit);
+		GLStateCache::enable(material->mPolygonOffsetType);
+		GLStateCache::polygonOffset(material->mFactor, material->mUnit);
 
 	}
 	else {
-		glDisable(GL_POLYGON_OFFSET_FILL);
-		glDisable(GL_POLYGON_OFFSET_LINE);
+		GLStateCache::disable(GL_POLYGON_OFFSET_FILL);
+		GLStateCache::disable(GL_POLYGON_OFFSET_LINE);
 
 	}
 
@@ -540,16 +816,16 @@ void Renderer::setStencilState(Material* material) {
 
 	if (material->mStencilTest) {
 
-		glEnable(GL_STENCIL_TEST);
+		GLStateCache::enable(GL_STENCIL_TEST);
 
-		glStencilOp(material->mSFail, material->mZFail, material->mZPass);
-		glStencilMask(material->mStencilMask);
-		glStencilFunc(material->mStencilFunc, material->mStencilRef, material->mStencilFuncMask);
+		GLStateCache::stencilOp(material->mSFail, material->mZFail, material->mZPass);
+		GLStateCache::stencilMask(material->mStencilMask);
+		GLStateCache::stencilFunc(material->mStencilFunc, material->mStencilRef, material->mStencilFuncMask);
 
 	}
 	else {
 
-		glDisable(GL_STENCIL_TEST);
+		GLStateCache::disable(GL_STENCIL_TEST);
 	}
 }
 
@@ -557,12 +833,12 @@ void Renderer::setBlendState(Material* material) {
 
 	if (material->mBlend) {
 
-		glEnable(GL_BLEND);
-		glBlendFunc(material->mSFactor, material->mDFactor);
+		GLStateCache::enable(GL_BLEND);
+		GLStateCache::blendFunc(material->mSFactor, material->mDFactor);
 	}
 	else {
 
-		glDisable(GL_BLEND);
+		GLStateCache::disable(GL_BLEND);
 	}
 }
 
@@ -570,13 +846,13 @@ void Renderer::setFaceCullingState(Material* material) {
 
 	if (material->mFaceCulling) {
 
-		glEnable(GL_CULL_FACE);
-		glFrontFace(material->mFrontFace);
-		glCullFace(material->mCullFace);
+		GLStateCache::enable(GL_CULL_FACE);
+		GLStateCache::frontFace(material->mFrontFace);
+		GLStateCache::cullFace(material->mCullFace);
 
 	}
 	else {
 
-		glDisable(GL_CULL_FACE);
+		GLStateCache::disable(GL_CULL_FACE);
 	}
 }
\ No newline at end of file
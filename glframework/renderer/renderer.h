@@ -10,6 +10,23 @@
 #include "../light/ambientLight.h"
 #include "../shader.h"
 #include "../scene.h"
+#include "../culling/frustum.h"
+#include "../culling/instanceCuller.h"
+#include "uniformBuffers.h"
+#include "renderQueue.h"
+#include "textureTable.h"
+#include "meshPool.h"
+
+// Uniform handles of one grass program, resolved once so the per draw block skips name lookups
+struct GrassUniforms {
+	UniformId mTextures, mMasks, mDiffuseLayer, mOpacityLayer, mCloudLayer;
+	UniformId mModelMatrix, mShiness;
+	UniformId mOpacity, mUVScale, mBrightness;
+	UniformId mWindScale, mPhaseScale, mWindDirection;
+	UniformId mCloudWhiteColor, mCloudBlackColor, mCloudUVScale, mCloudSpeed, mCloudLerp;
+
+	void resolve(Shader* shader);
+};
 
 class Renderer {
 
@@ -26,21 +43,51 @@ public:
 		unsigned int fbo = 0
 	);
 
+	// textureIndex is the TextureTable entry of the draw, read by the bindless shaders only
 	void renderObject(
 		Object* object,
 		Camera* camera,
-		DirectionalLight* dirLight,
-		AmbientLight* ambLight
+		unsigned int textureIndex = 0
 	);
 
 	void setClearColor(glm::vec3 color);
 
 	Material* mGlobalMaterial{ nullptr };
 
+	InstanceCuller* getInstanceCuller() const { return mInstanceCuller; }
+	const Frustum& getFrustum() const { return mFrustum; }
+	UniformBuffers* getUniformBuffers() const { return mUniformBuffers; }
+	const RenderQueueStats& getRenderQueueStats() const { return mRenderQueue.getStats(); }
+
+	// Phong family sampled through resident handles, bound per draw otherwise
+	bool isBindless() const { return mBindless; }
+	const TextureTableStats& getTextureTableStats() const { return mTextureTable->getStats(); }
+	const MeshPoolStats& getMeshPoolStats() const { return mMeshPool->getStats(); }
+
+	// Pooled static meshes occlude everything drawn after them: GPU culled instances through the
+	// HiZ pyramid, grass chunks and queued meshes through the software one
+	void setOcclusionCulling(bool enabled) { mOcclusionCulling = enabled; }
+	bool getOcclusionCulling() const { return mOcclusionCulling; }
+	const DepthPyramid& getDepthPyramid() const { return mDepthPyramid; }
+	const HiZCuller* getHiZCuller() const { return mHiZCuller; }
+	const glm::mat4& getViewProjectionMatrix() const { return mViewProjectionMatrix; }
+	unsigned int getOccludedMeshes() const { return mOccludedMeshes; }
+
 private:
-	void projectObject(Object* obj);
+	void projectObject(Object* obj, const glm::mat4& viewMatrix);
+
+	// Pooled static meshes, one multi draw per batch
+	void renderPool();
+
+	// Queued mesh hidden by the pooled occluders, depth tested materials only
+	bool isOccluded(Mesh* mesh, Material* material) const;
 
 	Shader* pickShader(MaterialType type);
+	Shader* selectShader(Mesh* mesh, Material* material);
+	void getTextures(Material* material, Texture* textures[3]);
+	unsigned int getTextureSet(Material* material);
+	static bool isBindlessMaterial(MaterialType type);
+	const GrassUniforms& getGrassUniforms(Shader* shader) const;
 
 	void setDepthState(Material* material);
 	void setPolygonOffsetState(Material* material);
@@ -58,7 +105,27 @@ private:
 	Shader* mPhongEnvShader{ nullptr };
 	Shader* mPhongInstanceShader{ nullptr };
 	Shader* mGrassInstanceShader{ nullptr };
+	Shader* mGrassInstanceCompactShader{ nullptr };
+	Shader* mGrassProceduralShader{ nullptr };
+	Shader* mPhongPoolShader{ nullptr };
+
+	GrassUniforms mGrassUniforms{};
+	GrassUniforms mGrassCompactUniforms{};
+	GrassUniforms mGrassProceduralUniforms{};
+	UniformId mOpacityMaskSampler{};
+	UniformId mScreenSampler{};
+
+	InstanceCuller* mInstanceCuller{ nullptr };
+	UniformBuffers* mUniformBuffers{ nullptr };
+	TextureTable* mTextureTable{ nullptr };
+	MeshPool* mMeshPool{ nullptr };
+	HiZCuller* mHiZCuller{ nullptr };
+	DepthPyramid mDepthPyramid{};
+	bool mBindless{ false };
+	bool mOcclusionCulling{ false };
+	unsigned int mOccludedMeshes{ 0 };
+	Frustum mFrustum{};
+	glm::mat4 mViewProjectionMatrix{ 1.0f };
 
-	std::vector<Mesh*> mOpacityObjects{};
-	std::vector<Mesh*> mTransparentObjects{};
+	RenderQueue mRenderQueue{};
 };
\ No newline at end of file
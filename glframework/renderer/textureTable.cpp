@@ -0,0 +1,53 @@
+#include "textureTable.h"
+#include <algorithm>
+
+TextureTable::TextureTable() {
+
+	glGenBuffers(1, &mSsbo);
+}
+
+TextureTable::~TextureTable() {
+
+	if (mSsbo != 0) {
+		glDeleteBuffers(1, &mSsbo);
+	}
+}
+
+void TextureTable::begin() {
+
+	mHandles.clear();
+	mStats = TextureTableStats();
+}
+
+unsigned int TextureTable::push(Texture* first, Texture* second) {
+
+	unsigned int index = (unsigned int)(mHandles.size() / 2);
+
+	mHandles.push_back(first != nullptr ? first->getHandle() : 0);
+	mHandles.push_back(second != nullptr ? second->getHandle() : 0);
+
+	return index;
+}
+
+void TextureTable::upload() {
+
+	size_t entries = mHandles.size() / 2;
+	mStats.mEntries = (unsigned int)entries;
+	if (entries == 0) {
+		return;
+	}
+
+	size_t bytes = mHandles.size() * sizeof(GLuint64);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSsbo);
+	if (entries > mCapacity) {
+
+		mCapacity = std::max(entries, mCapacity * 2);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, mCapacity * 2 * sizeof(GLuint64), nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, mHandles.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TextureTableBinding, mSsbo);
+	mStats.mUploadBytes = (unsigned int)bytes;
+}
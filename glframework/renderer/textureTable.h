@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../core.h"
+#include "../texture.h"
+
+// Shader storage binding of the table, past the instance culling buffers 0 to 2
+static const GLuint TextureTableBinding = 3;
+
+struct TextureTableStats {
+	unsigned int mEntries{ 0 };		// draws of the last frame
+	unsigned int mUploadBytes{ 0 };
+};
+
+// One entry of two resident handles per draw of the frame, std430 uvec4 on the shader side.
+// Filled in queue order and uploaded once, a bindless draw then only sets textureIndex
+class TextureTable {
+
+public:
+	TextureTable();
+	~TextureTable();
+
+	void begin();
+
+	// Index of the new entry, a null texture leaves its handle 0
+	unsigned int push(Texture* first, Texture* second);
+
+	// One write for the frame, the buffer grows by doubling and stays bound
+	void upload();
+
+	const TextureTableStats& getStats() const { return mStats; }
+
+private:
+	GLuint mSsbo{ 0 };
+	size_t mCapacity{ 0 };	// entries
+
+	std::vector<GLuint64> mHandles{};
+
+	TextureTableStats mStats{};
+};
@@ -0,0 +1,54 @@
+#include "uniformBuffers.h"
+
+UniformBuffers::UniformBuffers() {
+
+	glGenBuffers(1, &mFrameUbo);
+	glBindBuffer(GL_UNIFORM_BUFFER, mFrameUbo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &mLightUbo);
+	glBindBuffer(GL_UNIFORM_BUFFER, mLightUbo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+UniformBuffers::~UniformBuffers() {
+
+	if (mFrameUbo != 0) {
+		glDeleteBuffers(1, &mFrameUbo);
+	}
+	if (mLightUbo != 0) {
+		glDeleteBuffers(1, &mLightUbo);
+	}
+}
+
+void UniformBuffers::update(Camera* camera, DirectionalLight* dirLight, AmbientLight* ambLight, float time) {
+
+	// 1 Frame block
+	mFrameBlock.mViewMatrix = camera->getViewMatrix();
+	mFrameBlock.mProjectionMatrix = camera->getProjectionMatrix();
+	mFrameBlock.mCameraPosition = camera->mPosition;
+	mFrameBlock.mTime = time;
+	mFrameBlock.mNear = camera->mNear;
+	mFrameBlock.mFar = camera->mFar;
+
+	// 2 Light block
+	mLightBlock.mDirection = dirLight->mDirection;
+	mLightBlock.mColor = dirLight->mColor;
+	mLightBlock.mSpecularIntensity = dirLight->mSpecularIntensity;
+	mLightBlock.mIntensity = dirLight->mIntensity;
+	mLightBlock.mAmbientColor = ambLight->mColor;
+
+	// 3 Upload, the blocks stay bound for every program of the frame
+	glBindBuffer(GL_UNIFORM_BUFFER, mFrameUbo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &mFrameBlock);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, mLightUbo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &mLightBlock);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameBinding, mFrameUbo);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LightBinding, mLightUbo);
+}
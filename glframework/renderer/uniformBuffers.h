@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../core.h"
+#include "../../application/camera/camera.h"
+#include "../light/directionalLight.h"
+#include "../light/ambientLight.h"
+
+// Binding points of the shared blocks, must match the layout(binding) of the shaders
+enum UniformBinding {
+	FrameBinding = 0,
+	LightBinding = 1
+};
+
+// std140 image of FrameBlock
+struct FrameBlock {
+	glm::mat4 mViewMatrix{ 1.0f };
+	glm::mat4 mProjectionMatrix{ 1.0f };
+	glm::vec3 mCameraPosition{ 0.0f };
+	float mTime{ 0.0f };
+	float mNear{ 0.0f };
+	float mFar{ 0.0f };
+	float mPadding[2]{};
+};
+
+// std140 image of LightBlock, the DirectionalLight struct is padded to 48 bytes
+struct LightBlock {
+	glm::vec3 mDirection{ 0.0f };
+	float mPadding0{ 0.0f };
+	glm::vec3 mColor{ 0.0f };
+	float mSpecularIntensity{ 0.0f };
+	float mIntensity{ 0.0f };
+	float mPadding1[3]{};
+	glm::vec3 mAmbientColor{ 0.0f };
+	float mPadding2{ 0.0f };
+};
+
+static_assert(sizeof(FrameBlock) == 160, "FrameBlock must match the std140 layout");
+static_assert(sizeof(LightBlock) == 64, "LightBlock must match the std140 layout");
+
+class UniformBuffers {
+
+public:
+	UniformBuffers();
+	~UniformBuffers();
+
+	// Upload camera and light data and bind both blocks, once per frame
+	void update(Camera* camera, DirectionalLight* dirLight, AmbientLight* ambLight, float time);
+
+	const FrameBlock& getFrameBlock() const { return mFrameBlock; }
+	const LightBlock& getLightBlock() const { return mLightBlock; }
+
+private:
+	GLuint mFrameUbo{ 0 };
+	GLuint mLightUbo{ 0 };
+
+	FrameBlock mFrameBlock{};
+	LightBlock mLightBlock{};
+};
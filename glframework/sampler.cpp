@@ -0,0 +1,65 @@
+#include "sampler.h"
+#include "glStateCache.h"
+#include <algorithm>
+
+Sampler::Sampler(TextureFilter filter, float anisotropy, GLenum wrap) {
+
+	glGenSamplers(1, &mSampler);
+
+	setFilter(filter);
+	setAnisotropy(anisotropy);
+	setWrap(wrap);
+}
+
+Sampler::~Sampler() {
+
+	GLStateCache::forgetSampler(mSampler);
+	glDeleteSamplers(1, &mSampler);
+}
+
+void Sampler::setFilter(TextureFilter filter) {
+
+	mFilter = filter;
+
+	GLenum minFilter = GL_NEAREST;
+	GLenum magFilter = GL_NEAREST;
+	switch (filter) {
+	case TextureFilter::Nearest:
+		break;
+	case TextureFilter::Bilinear:
+		minFilter = GL_LINEAR_MIPMAP_NEAREST;
+		magFilter = GL_LINEAR;
+		break;
+	case TextureFilter::Trilinear:
+		minFilter = GL_LINEAR_MIPMAP_LINEAR;
+		magFilter = GL_LINEAR;
+		break;
+	}
+
+	glSamplerParameteri(mSampler, GL_TEXTURE_MIN_FILTER, minFilter);
+	glSamplerParameteri(mSampler, GL_TEXTURE_MAG_FILTER, magFilter);
+}
+
+void Sampler::setAnisotropy(float anisotropy) {
+
+	mAnisotropy = glm::clamp(anisotropy, 1.0f, getMaxAnisotropy());
+	glSamplerParameterf(mSampler, GL_TEXTURE_MAX_ANISOTROPY, mAnisotropy);
+}
+
+void Sampler::setWrap(GLenum wrap) {
+
+	glSamplerParameteri(mSampler, GL_TEXTURE_WRAP_S, wrap);
+	glSamplerParameteri(mSampler, GL_TEXTURE_WRAP_T, wrap);
+}
+
+float Sampler::getMaxAnisotropy() {
+
+	static float maxAnisotropy = 0.0f;
+	if (maxAnisotropy == 0.0f) {
+
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+		maxAnisotropy = std::max(maxAnisotropy, 1.0f);
+	}
+
+	return maxAnisotropy;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "core.h"
+
+enum class TextureFilter {
+	Nearest,	// nearest texel, base level only
+	Bilinear,	// linear inside the nearest mip level
+	Trilinear	// linear inside and between the two nearest mip levels
+};
+
+// GL sampler object. Bound to a texture unit it overrides the filter and wrap parameters of
+// whatever texture is bound there, so one sampler can be shared and changed for many textures
+class Sampler {
+public:
+	Sampler(TextureFilter filter = TextureFilter::Trilinear, float anisotropy = 1.0f, GLenum wrap = GL_REPEAT);
+	~Sampler();
+
+	void setFilter(TextureFilter filter);
+
+	// Samples along the longer footprint axis, clamped to the driver maximum, 1 disables
+	void setAnisotropy(float anisotropy);
+
+	void setWrap(GLenum wrap);
+
+	GLuint getSampler() const { return mSampler; }
+	TextureFilter getFilter() const { return mFilter; }
+	float getAnisotropy() const { return mAnisotropy; }
+
+	// GL_MAX_TEXTURE_MAX_ANISOTROPY, queried once
+	static float getMaxAnisotropy();
+
+private:
+	GLuint mSampler{ 0 };
+	TextureFilter mFilter{ TextureFilter::Trilinear };
+	float mAnisotropy{ 1.0f };
+};
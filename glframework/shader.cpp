@@ -1,12 +1,20 @@
 #include "shader.h""
+#include "glStateCache.h"
 #include "../wrapper/checkError.h"
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath){
-	
+UniformStats Shader::mUniformStats{};
+unsigned int Shader::mNextId = 0;
+unsigned int Shader::mNextDrawIndex = 0;
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines){
+
+	mId = mNextId++;
+	mDrawIndex = mNextDrawIndex++;
+
     // Save the vertex and fragment shader code 
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -35,8 +43,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath){
 		fShaderFile.close();
 
 		// Save to the code
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		vertexCode = injectDefines(vShaderStream.str(), defines);
+		fragmentCode = injectDefines(fShaderStream.str(), defines);
 
 	}
 
@@ -79,23 +87,53 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath){
     // 8 Clear
     GL_CALL(glDeleteShader(vertex));
     GL_CALL(glDeleteShader(fragment));
+
+    // 9 Uniform locations
+    reflectUniforms();
+}
+
+Shader::Shader(const char* computePath) {
+
+	mId = mNextId++;
+
+    std::string computeCode = readFile(computePath);
+    const char* computeShaderSource = computeCode.c_str();
+
+    // 1 Create and compile compute shader
+    GLuint compute;
+    compute = GL_CALL(glCreateShader(GL_COMPUTE_SHADER));
+    GL_CALL(glShaderSource(compute, 1, &computeShaderSource, NULL));
+    GL_CALL(glCompileShader(compute));
+    checkShaderErrors(compute, "COMPILE");
+
+    // 2 Link program
+    mProgram = glCreateProgram();
+    GL_CALL(glAttachShader(mProgram, compute));
+    GL_CALL(glLinkProgram(mProgram));
+    checkShaderErrors(mProgram, "LINK");
+
+    // 3 Clear
+    GL_CALL(glDeleteShader(compute));
+
+    // 4 Uniform locations
+    reflectUniforms();
 }
 
 Shader::~Shader(){
 }
 
 void Shader::begin() {
-	GL_CALL(glUseProgram(mProgram));
+	GLStateCache::useProgram(mProgram);
 }
 
 void Shader::end() {
-	GL_CALL(glUseProgram(0));	
+	GLStateCache::useProgram(0);
 }
 
 void Shader::setFloat(const std::string& name, float value) {
     
     // 1 Get the uniform location
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     // 2 Input value to uniform
     glUniform1f(location, value);
@@ -103,43 +141,71 @@ void Shader::setFloat(const std::string& name, float value) {
 
 void Shader::setVector3(const std::string& name, float x, float y, float z) {
 
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniform3f(location, x, y, z);
 }
 
 void Shader::setVector3(const std::string& name, const float* values) {
     
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniform3fv(location, 1, values);
 }
 
 void Shader::setVector3(const std::string& name, const glm::vec3 value) {
 
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniform3f(location, value.x, value.y, value.z);
 
 }
 
+void Shader::setVector4(const std::string& name, const glm::vec4 value) {
+
+    GLint location = getLocation(name);
+
+    glUniform4f(location, value.x, value.y, value.z, value.w);
+}
+
+void Shader::setVector4Array(const std::string& name, const glm::vec4* value, int count) {
+
+    GLint location = getLocation(name);
+
+    glUniform4fv(location, count, glm::value_ptr(value[0]));
+}
+
 void Shader::setInt(const std::string& name, int value) {
 
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniform1i(location, value);
 }
 
+void Shader::setIntVector2(const std::string& name, int x, int y) {
+
+    GLint location = getLocation(name);
+
+    glUniform2i(location, x, y);
+}
+
+void Shader::setUnsignedInt(const std::string& name, unsigned int value) {
+
+    GLint location = getLocation(name);
+
+    glUniform1ui(location, value);
+}
+
 void Shader::setMatrix4x4(const std::string& name, glm::mat4 value) {
 
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::setMatrix4x4Array(const std::string& name, glm::mat4* value, int count) {
 
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniformMatrix4fv(location, count, GL_FALSE, glm::value_ptr(value[0]));
 
@@ -147,11 +213,153 @@ void Shader::setMatrix4x4Array(const std::string& name, glm::mat4* value, int co
 
 void Shader::setMatrix3x3(const std::string& name, glm::mat3 value) {
 
-    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    GLint location = getLocation(name);
 
     glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
+UniformId Shader::uniform(const std::string& name) {
+
+    return UniformId{ getLocation(name) };
+}
+
+void Shader::setFloat(UniformId id, float value) {
+
+    mUniformStats.mHandleSets++;
+    glUniform1f(id.mLocation, value);
+}
+
+void Shader::setVector3(UniformId id, const glm::vec3 value) {
+
+    mUniformStats.mHandleSets++;
+    glUniform3f(id.mLocation, value.x, value.y, value.z);
+}
+
+void Shader::setVector4(UniformId id, const glm::vec4 value) {
+
+    mUniformStats.mHandleSets++;
+    glUniform4f(id.mLocation, value.x, value.y, value.z, value.w);
+}
+
+void Shader::setInt(UniformId id, int value) {
+
+    mUniformStats.mHandleSets++;
+    glUniform1i(id.mLocation, value);
+}
+
+void Shader::setUnsignedInt(UniformId id, unsigned int value) {
+
+    mUniformStats.mHandleSets++;
+    glUniform1ui(id.mLocation, value);
+}
+
+void Shader::setMatrix4x4(UniformId id, const glm::mat4& value) {
+
+    mUniformStats.mHandleSets++;
+    glUniformMatrix4fv(id.mLocation, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setMatrix3x3(UniformId id, const glm::mat3& value) {
+
+    mUniformStats.mHandleSets++;
+    glUniformMatrix3fv(id.mLocation, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::reflectUniforms() {
+
+    mUniformLocations.clear();
+
+    GLint count = 0;
+    GLint maxNameLength = 0;
+    glGetProgramInterfaceiv(mProgram, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+    glGetProgramInterfaceiv(mProgram, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+    std::vector<char> nameBuffer(maxNameLength + 1);
+    const GLenum properties[] = { GL_LOCATION, GL_ARRAY_SIZE };
+
+    for (GLint i = 0; i < count; i++) {
+
+        // 1 Uniform block members have no location
+        GLint values[2] = { -1, 0 };
+        glGetProgramResourceiv(mProgram, GL_UNIFORM, i, 2, properties, 2, nullptr, values);
+        if (values[0] < 0) {
+            continue;
+        }
+
+        glGetProgramResourceName(mProgram, GL_UNIFORM, i, (GLsizei)nameBuffer.size(), nullptr, nameBuffer.data());
+        std::string name(nameBuffer.data());
+        mUniformLocations[name] = values[0];
+
+        // 2 Arrays are reported as "name[0]", also accept "name" and every element
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+
+            std::string base = name.substr(0, name.size() - 3);
+            mUniformLocations[base] = values[0];
+
+            for (GLint element = 1; element < values[1]; element++) {
+                mUniformLocations[base + "[" + std::to_string(element) + "]"] = values[0] + element;
+            }
+        }
+    }
+}
+
+GLint Shader::getLocation(const std::string& name) {
+
+    mUniformStats.mHashedLookups++;
+
+    auto iter = mUniformLocations.find(name);
+    if (iter != mUniformLocations.end()) {
+
+        return iter->second;
+    }
+
+    // Not active after link, ask the driver once and remember the answer
+    mUniformStats.mDriverLookups++;
+    GLint location = glGetUniformLocation(mProgram, name.c_str());
+    mUniformLocations[name] = location;
+
+    return location;
+}
+
+std::string Shader::injectDefines(const std::string& code, const std::string& defines) {
+
+    if (defines.empty()) {
+        return code;
+    }
+
+    // #version has to stay the first line, #extension has to precede every declaration.
+    // #line keeps the compile errors pointing at the lines of the file
+    size_t lineEnd = code.find('\n');
+    if (lineEnd == std::string::npos) {
+        return code;
+    }
+
+    return code.substr(0, lineEnd + 1) + defines + "#line 2\n" + code.substr(lineEnd + 1);
+}
+
+std::string Shader::readFile(const char* path) {
+
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    std::string code;
+    try {
+
+        file.open(path);
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+
+        file.close();
+        code = stream.str();
+    }
+    catch (std::ifstream::failure& e) {
+        std::cout << "ERROR: Shader File ERROR: " << e.what() << std::endl;
+    }
+
+    return code;
+}
+
 void Shader::checkShaderErrors(GLuint target, std::string type) {
     int success = 0;
     char infoLog[1024];
@@ -2,32 +2,85 @@
 
 #include "core.h"
 #include <string>
+#include <unordered_map>
+
+// Location resolved once, setters taking it skip the name lookup
+struct UniformId {
+	GLint mLocation{ -1 };
+};
+
+struct UniformStats {
+	unsigned int mDriverLookups{ 0 };	// glGetUniformLocation calls
+	unsigned int mHashedLookups{ 0 };	// setters called by name
+	unsigned int mHandleSets{ 0 };		// setters called by UniformId
+};
 
 class Shader {
 public:
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// defines is inserted after the #version line of both stages, e.g. "#define BINDLESS\n"
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
+	Shader(const char* computePath);
 	~Shader();
 
 	void begin(); //Begin using current shader
 
 	void end(); //End using current shader
 
+	// Unique per program
+	unsigned int getId() const { return mId; }
+
+	// Dense 0..n-1 over vertex/fragment programs only, the shader field of the render queue key
+	unsigned int getDrawIndex() const { return mDrawIndex; }
+
 	void setFloat(const std::string& name, float value);
 
 	void setVector3(const std::string& name, float x, float y, float z);
 	void setVector3(const std::string& name, const float* values);
 	void setVector3(const std::string& name, const glm::vec3 value);
 
+	void setVector4(const std::string& name, const glm::vec4 value);
+	void setVector4Array(const std::string& name, const glm::vec4* value, int count);
+
 
 	void setInt(const std::string& name, int value);
+	void setIntVector2(const std::string& name, int x, int y);
+	void setUnsignedInt(const std::string& name, unsigned int value);
 
 	void setMatrix4x4(const std::string& name, glm::mat4 value);
 	void setMatrix4x4Array(const std::string& name, glm::mat4* value, int count);
 	void setMatrix3x3(const std::string& name, glm::mat3 value);
 
+	// Pre-resolved handles for hot paths
+	UniformId uniform(const std::string& name);
+
+	void setFloat(UniformId id, float value);
+	void setVector3(UniformId id, const glm::vec3 value);
+	void setVector4(UniformId id, const glm::vec4 value);
+	void setInt(UniformId id, int value);
+	void setUnsignedInt(UniformId id, unsigned int value);
+	void setMatrix4x4(UniformId id, const glm::mat4& value);
+	void setMatrix3x3(UniformId id, const glm::mat3& value);
+
+	static const UniformStats& getUniformStats() { return mUniformStats; }
+	static void resetUniformStats() { mUniformStats = UniformStats(); }
+
 private:
+	std::string readFile(const char* path);
+	static std::string injectDefines(const std::string& code, const std::string& defines);
 	void checkShaderErrors(GLuint target, std::string type);
 
+	// Fill the location table with every active uniform after link
+	void reflectUniforms();
+	GLint getLocation(const std::string& name);
+
 private:
 	GLuint mProgram{ 0 };
+	unsigned int mId{ 0 };
+	unsigned int mDrawIndex{ 0 };
+
+	std::unordered_map<std::string, GLint> mUniformLocations{};
+
+	static UniformStats mUniformStats;
+	static unsigned int mNextId;
+	static unsigned int mNextDrawIndex;
 };
\ No newline at end of file
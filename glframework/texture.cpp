@@ -1,4 +1,8 @@
 #include "texture.h"
+#include "glStateCache.h"
+#include "bindlessTextures.h"
+#include "textureLoader.h"
+#include "tools/mipmapGenerator.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../application/stb_image.h"
@@ -6,7 +10,7 @@
 std::map<std::string, Texture*> Texture::mTextureCache{};
 
 // Texture cache from drive
-Texture* Texture::createTexture(const std::string& path, unsigned int unit) {
+Texture* Texture::createTexture(const std::string& path, unsigned int unit, MipmapMode mipmaps, TextureFormat format) {
     
     // 1 Check if generate before
     auto iter = mTextureCache.find(path);
@@ -16,7 +20,10 @@ Texture* Texture::createTexture(const std::string& path, unsigned int unit) {
     }
 
 
-    auto texture = new Texture(path, unit);
+    // 2 Decode on the loader threads
+    resolveFormat(mipmaps, format);
+    auto texture = createPending(unit);
+    TextureLoader::getDefault().request(texture, path, mipmaps, format);
     mTextureCache[path] = texture;
 
     return texture;
@@ -28,7 +35,9 @@ Texture* Texture::createTextureFromMemory(
     unsigned int unit,
     unsigned char* dataIn,
     uint32_t widthIn,
-    uint32_t heightIn
+    uint32_t heightIn,
+    MipmapMode mipmaps,
+    TextureFormat format
 ) {
 
     auto iter = mTextureCache.find(path);
@@ -37,13 +46,92 @@ Texture* Texture::createTextureFromMemory(
         return iter->second;
     }
 
-    auto texture = new Texture(unit, dataIn, widthIn, heightIn);
+    // Assimp rules: png or jpg file, height = 0, width is the size of image
+    size_t dataInSize = heightIn ? (size_t)widthIn * heightIn * 4 : widthIn;
 
+    resolveFormat(mipmaps, format);
+    auto texture = createPending(unit);
+    TextureLoader::getDefault().request(texture, dataIn, dataInSize, mipmaps, format);
     mTextureCache[path] = texture;
 
     return texture;
 }
 
+Texture* Texture::createTextureFromTexels(
+    const std::string& key,
+    unsigned int unit,
+    std::vector<unsigned char>&& texels,
+    int width,
+    int height,
+    MipmapMode mipmaps,
+    TextureFormat format
+) {
+
+    auto iter = mTextureCache.find(key);
+    if (iter != mTextureCache.end()) {
+
+        return iter->second;
+    }
+
+    resolveFormat(mipmaps, format);
+    auto texture = createPending(unit);
+    TextureLoader::getDefault().request(texture, std::move(texels), width, height, mipmaps, format);
+    mTextureCache[key] = texture;
+
+    return texture;
+}
+
+Texture* Texture::createTextureFromBuilder(
+    const std::string& key,
+    unsigned int unit,
+    TextureBuilder&& build,
+    MipmapMode mipmaps,
+    TextureFormat format
+) {
+
+    auto iter = mTextureCache.find(key);
+    if (iter != mTextureCache.end()) {
+
+        return iter->second;
+    }
+
+    resolveFormat(mipmaps, format);
+    auto texture = createPending(unit);
+    TextureLoader::getDefault().request(texture, std::move(build), mipmaps, format);
+    mTextureCache[key] = texture;
+
+    return texture;
+}
+
+Texture* Texture::findTexture(const std::string& key) {
+
+    auto iter = mTextureCache.find(key);
+    return iter != mTextureCache.end() ? iter->second : nullptr;
+}
+
+void Texture::resolveFormat(MipmapMode& mipmaps, TextureFormat& format) {
+
+    // Extensions are queried here on the GL thread, the workers only encode
+    if (!BlockCompressor::isSupported(format)) {
+        format = TextureFormat::Bc7;
+    }
+
+    if (format != TextureFormat::Rgba8 && mipmaps == MipmapMode::Gpu) {
+        mipmaps = MipmapMode::Kaiser;
+    }
+}
+
+Texture* Texture::createPending(unsigned int unit) {
+
+    Texture* texture = new Texture();
+    texture->mUnit = unit;
+    texture->mTexture = TextureLoader::getDefault().getPlaceholder();
+    texture->mWidth = 1;
+    texture->mHeight = 1;
+    texture->mReady = false;
+
+    return texture;
+}
 
 Texture* Texture::createColorAttachment(
     unsigned int width,
@@ -63,7 +151,7 @@ Texture* Texture::createDepthStencilAttachment(
 
     unsigned int depthStencil;
     glGenTextures(1, &depthStencil);
-    glBindTexture(GL_TEXTURE_2D, depthStencil);
+    GLStateCache::bindTexture(unit, GL_TEXTURE_2D, depthStencil);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
 
@@ -100,8 +188,7 @@ Texture::Texture(const std::string &path, unsigned int unit){
 
     // 2 Generate
     glGenTextures(1, &mTexture);
-    glActiveTexture(GL_TEXTURE0 + mUnit);
-    glBindTexture(GL_TEXTURE_2D, mTexture);
+    GLStateCache::bindTexture(mUnit, GL_TEXTURE_2D, mTexture);
 
     // 3 Send data
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -109,9 +196,11 @@ Texture::Texture(const std::string &path, unsigned int unit){
     // 4 Release data
     stbi_image_free(data);
 
-    // 5 Set filter 
+    // 5 Set filter, trilinear over a generated mip chain
+    glGenerateMipmap(GL_TEXTURE_2D);
+    mLevels = MipmapGenerator::getLevelCount(mWidth, mHeight);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
     // 6 Set wrapping
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -151,8 +240,7 @@ Texture::Texture(
 
     // 2 Generate
     glGenTextures(1, &mTexture);
-    glActiveTexture(GL_TEXTURE0 + mUnit);
-    glBindTexture(GL_TEXTURE_2D, mTexture);
+    GLStateCache::bindTexture(mUnit, GL_TEXTURE_2D, mTexture);
 
     // 3 Send data
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -160,9 +248,11 @@ Texture::Texture(
     // 4 Release data
     stbi_image_free(data);
 
-    // 5 Set filter 
+    // 5 Set filter, trilinear over a generated mip chain
+    glGenerateMipmap(GL_TEXTURE_2D);
+    mLevels = MipmapGenerator::getLevelCount(mWidth, mHeight);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
     // 6 Set wrapping
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -178,8 +268,7 @@ Texture::Texture(unsigned int width, unsigned int height, unsigned int unit){
     mUnit = unit;
 
     glGenTextures(1, &mTexture);
-    glActiveTexture(GL_TEXTURE0 + mUnit);
-    glBindTexture(GL_TEXTURE_2D, mTexture);
+    GLStateCache::bindTexture(mUnit, GL_TEXTURE_2D, mTexture);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
@@ -197,8 +286,7 @@ Texture::Texture(const std::vector<std::string>& paths, unsigned int unit) {
 
     // 1 Create cubemap texture object
     glGenTextures(1, &mTexture);
-    glActiveTexture(GL_TEXTURE0 + mUnit);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, mTexture);
+    GLStateCache::bindTexture(mUnit, GL_TEXTURE_CUBE_MAP, mTexture);
 
     // 2 stb read the texture
     // 2,1 Define variable
@@ -233,13 +321,36 @@ Texture::Texture(const std::vector<std::string>& paths, unsigned int unit) {
 }
 
 Texture::~Texture(){
+
+    // The placeholder is shared
+    if (!mReady) {
+        TextureLoader::getDefault().cancel(this);
+        return;
+    }
+
     if (mTexture != 0) {
+        BindlessTextures::release(mTexture);
+        GLStateCache::forgetTexture(mTexture);
         glDeleteTextures(1, &mTexture);
     }
 }
 
 void Texture::bind() {
 
-    glActiveTexture(GL_TEXTURE0 + mUnit);
-    glBindTexture(mTextureTarget, mTexture);
+    GLStateCache::bindTexture(mUnit, mTextureTarget, mTexture);
+    GLStateCache::bindSampler(mUnit, mSampler != nullptr ? mSampler->getSampler() : 0);
+}
+
+GLuint64 Texture::getHandle() {
+
+    GLuint sampler = mSampler != nullptr ? mSampler->getSampler() : 0;
+    if (mHandle == 0 || mHandleTexture != mTexture || mHandleSampler != sampler) {
+
+        // The shared placeholder keeps its handle resident, it is never deleted
+        mHandle = BindlessTextures::acquire(mTexture, sampler);
+        mHandleTexture = mTexture;
+        mHandleSampler = sampler;
+    }
+
+    return mHandle;
 }
\ No newline at end of file
@@ -1,19 +1,67 @@
 #pragma once
 #include "core.h"
+#include "sampler.h"
+#include "tools/blockCompressor.h"
+#include <functional>
 #include <string>
 
+// Fills RGBA8 texels, rows bottom up, on a loader thread. False when nothing could be built
+using TextureBuilder = std::function<bool(std::vector<unsigned char>& texels, int& width, int& height)>;
+
+// Mip chain of a loaded image
+enum class MipmapMode {
+	None,		// base level only, nearest minification
+	Gpu,		// glGenerateMipmap once the base level is uploaded
+	Box,		// filtered on the loader threads, see MipmapGenerator
+	Kaiser
+};
+
 class Texture {
+	friend class TextureLoader;
+	friend class TextureArray;
+
 public:
 
-		static Texture* createTexture(const std::string& path, unsigned int unit);
+		// Returns at once, the texture shows a placeholder until TextureLoader uploaded it.
+		// A compressed format the driver lacks falls back to Bc7, Gpu mips of a compressed format to Kaiser
+		static Texture* createTexture(
+			const std::string& path,
+			unsigned int unit,
+			MipmapMode mipmaps = MipmapMode::Kaiser,
+			TextureFormat format = TextureFormat::Rgba8);
 		static Texture* createTextureFromMemory(
 			const std::string& path, 
 			unsigned int unit,
 			unsigned char* dataIn,
 			uint32_t widthIn,
-			uint32_t heightIn
+			uint32_t heightIn,
+			MipmapMode mipmaps = MipmapMode::Kaiser,
+			TextureFormat format = TextureFormat::Rgba8
+		);
+
+		// Decoded RGBA8 texels, rows bottom up, filtered and uploaded by TextureLoader. Cached under key
+		static Texture* createTextureFromTexels(
+			const std::string& key,
+			unsigned int unit,
+			std::vector<unsigned char>&& texels,
+			int width,
+			int height,
+			MipmapMode mipmaps = MipmapMode::Kaiser,
+			TextureFormat format = TextureFormat::Rgba8
+		);
+
+		// Texels assembled by build on a TextureLoader worker, e.g. an atlas of several decodes. Cached under key
+		static Texture* createTextureFromBuilder(
+			const std::string& key,
+			unsigned int unit,
+			TextureBuilder&& build,
+			MipmapMode mipmaps = MipmapMode::Kaiser,
+			TextureFormat format = TextureFormat::Rgba8
 		);
 
+		// Texture cached under key by one of the functions above, nullptr when there is none
+		static Texture* findTexture(const std::string& key);
+
 		static Texture* createColorAttachment(
 			unsigned int width, 
 			unsigned int height, 
@@ -49,6 +97,29 @@ public:
 		int getHeight() const { return mHeight; }
 		GLuint getTexture()const { return mTexture; }
 
+		// False while the placeholder is bound
+		bool isReady() const { return mReady; }
+
+		int getLevels() const { return mLevels; }
+		TextureFormat getFormat() const { return mFormat; }
+
+		// Layers of a GL_TEXTURE_2D_ARRAY, 1 otherwise
+		int getLayers() const { return mLayers; }
+
+		// Overrides the filter and wrap parameters of the texture while it is bound, not owned
+		void setSampler(Sampler* sampler) { mSampler = sampler; }
+		Sampler* getSampler() const { return mSampler; }
+
+		// Resident bindless handle of the current texture and sampler, 0 without GL_ARB_bindless_texture.
+		// Freezes the parameters of both, follows the placeholder swap of a pending texture
+		GLuint64 getHandle();
+
+
+private:
+	static Texture* createPending(unsigned int unit);
+
+	// Format and chain the loader can actually upload
+	static void resolveFormat(MipmapMode& mipmaps, TextureFormat& format);
 
 private:
 	GLuint mTexture{ 0 };
@@ -56,6 +127,15 @@ private:
 	int mHeight{ 0 };
 	unsigned int mUnit{ 0 };
 	unsigned int mTextureTarget{ GL_TEXTURE_2D };
+	bool mReady{ true };
+	int mLevels{ 1 };
+	int mLayers{ 1 };
+	TextureFormat mFormat{ TextureFormat::Rgba8 };
+	Sampler* mSampler{ nullptr };
+
+	GLuint64 mHandle{ 0 };
+	GLuint mHandleTexture{ 0 };
+	GLuint mHandleSampler{ 0 };
 
 	static std::map<std::string, Texture*> mTextureCache;
 };
\ No newline at end of file
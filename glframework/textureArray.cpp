@@ -0,0 +1,135 @@
+#include "textureArray.h"
+#include "glStateCache.h"
+#include "tools/textureCache.h"
+#include "../application/stb_image.h"
+
+#include <chrono>
+#include <thread>
+
+TextureArray::TextureArray(MipmapMode mipmaps, TextureFormat format) :mMipmaps(mipmaps), mFormat(format) {}
+
+TextureArray::~TextureArray() {}
+
+int TextureArray::add(const std::string& path) {
+
+	int layer = getLayer(path);
+	if (layer >= 0) {
+		return layer;
+	}
+
+	// Header only, the texels are read by build()
+	int width, height, channels;
+	if (stbi_info(path.c_str(), &width, &height, &channels)) {
+
+		if (mWidth == 0) {
+			mWidth = width;
+			mHeight = height;
+		}
+		else if (width != mWidth || height != mHeight) {
+
+			std::cout << "Warning: " << path << " is " << width << "x" << height << ", the array layers are "
+				<< mWidth << "x" << mHeight << std::endl;
+			return -1;
+		}
+	}
+	else {
+		std::cout << "Error: Texture failed to load at path - " << path << std::endl;
+	}
+
+	mPaths.push_back(path);
+	return (int)mPaths.size() - 1;
+}
+
+int TextureArray::getLayer(const std::string& path) const {
+
+	for (size_t i = 0; i < mPaths.size(); i++) {
+		if (mPaths[i] == path) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+Texture* TextureArray::build(unsigned int unit) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	MipmapMode mipmaps = mMipmaps;
+	TextureFormat format = mFormat;
+	Texture::resolveFormat(mipmaps, format);
+
+	int width = mWidth > 0 ? mWidth : 1;
+	int height = mHeight > 0 ? mHeight : 1;
+	int layerCount = std::max((int)mPaths.size(), 1);
+
+	// 1 Every layer on its own thread, Gpu chains are generated after the upload
+	bool cpuMipmaps = mipmaps == MipmapMode::Box || mipmaps == MipmapMode::Kaiser;
+	MipmapFilter filter = mipmaps == MipmapMode::Box ? MipmapFilter::Box : MipmapFilter::Kaiser;
+
+	std::vector<std::vector<CompressedLevel>> layers(layerCount);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < layerCount; i++) {
+
+		threads.emplace_back([&, i]() {
+
+			if (i < (int)mPaths.size() &&
+				TextureCache::load(mPaths[i], format, cpuMipmaps, filter, layers[i]) &&
+				layers[i][0].mWidth == width && layers[i][0].mHeight == height) {
+				return;
+			}
+
+			std::vector<unsigned char> gray((size_t)width * height * 4, 128);
+			TextureCache::encode(gray.data(), width, height, format, cpuMipmaps, filter, layers[i]);
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	// 2 Storage of every layer and level at once
+	int levelCount = mipmaps != MipmapMode::None ? MipmapGenerator::getLevelCount(width, height) : 1;
+	GLenum internalFormat = BlockCompressor::getGLFormat(format);
+
+	Texture* texture = new Texture();
+	texture->mUnit = unit;
+	texture->mTextureTarget = GL_TEXTURE_2D_ARRAY;
+	texture->mWidth = width;
+	texture->mHeight = height;
+	texture->mLevels = levelCount;
+	texture->mLayers = layerCount;
+	texture->mFormat = format;
+
+	glGenTextures(1, &texture->mTexture);
+	GLStateCache::bindTexture(unit, GL_TEXTURE_2D_ARRAY, texture->mTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount, internalFormat, width, height, layerCount);
+
+	// 3 Level by level, layers are one slice each
+	for (int i = 0; i < layerCount; i++) {
+		for (size_t level = 0; level < layers[i].size(); level++) {
+
+			const CompressedLevel& source = layers[i][level];
+			if (format == TextureFormat::Rgba8) {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, i, source.mWidth, source.mHeight, 1,
+					GL_RGBA, GL_UNSIGNED_BYTE, source.mBlocks.data());
+			}
+			else {
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, i, source.mWidth, source.mHeight, 1,
+					internalFormat, (GLsizei)source.mBlocks.size(), source.mBlocks.data());
+			}
+		}
+	}
+
+	if (mipmaps == MipmapMode::Gpu) {
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mBuildTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+	return texture;
+}
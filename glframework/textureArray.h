@@ -0,0 +1,34 @@
+#pragma once
+#include "core.h"
+#include "texture.h"
+#include <string>
+
+// Same size images packed into the layers of one GL_TEXTURE_2D_ARRAY, a material family binds a
+// single texture and picks its layers in the shader. Layers are decoded, filtered and compressed
+// on a thread each when the array is built, compressed chains go through the .texcache
+class TextureArray {
+public:
+	TextureArray(MipmapMode mipmaps = MipmapMode::Kaiser, TextureFormat format = TextureFormat::Rgba8);
+	~TextureArray();
+
+	// Layer of path, -1 when its size differs from the first layer. An unreadable file keeps a gray layer
+	int add(const std::string& path);
+
+	// Layer of an added path, -1 if it was not added
+	int getLayer(const std::string& path) const;
+
+	int getLayerCount() const { return (int)mPaths.size(); }
+
+	// Decode and upload every layer, blocking. The texture is owned by the caller
+	Texture* build(unsigned int unit);
+
+	float getBuildTime() const { return mBuildTime; } // ms
+
+private:
+	std::vector<std::string> mPaths{};
+	int mWidth{ 0 };
+	int mHeight{ 0 };
+	MipmapMode mMipmaps{ MipmapMode::Kaiser };
+	TextureFormat mFormat{ TextureFormat::Rgba8 };
+	float mBuildTime{ 0.0f };
+};
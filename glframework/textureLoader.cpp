@@ -0,0 +1,519 @@
+#include "textureLoader.h"
+#include "glStateCache.h"
+#include "../application/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+TextureLoader::TextureLoader() {}
+
+TextureLoader::~TextureLoader() {
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for (auto& worker : mWorkers) {
+		worker.join();
+	}
+
+	// The context is gone by now, only the decoded texels are released
+	for (auto* jobs : { &mQueued, &mReady, &mUploading }) {
+		for (auto& job : *jobs) {
+			stbi_image_free(job.mTexels);
+		}
+	}
+}
+
+TextureLoader& TextureLoader::getDefault() {
+
+	static TextureLoader loader;
+	return loader;
+}
+
+void TextureLoader::start() {
+
+	// One core stays with the GL thread
+	unsigned int cores = std::thread::hardware_concurrency();
+	unsigned int count = std::min(std::max(cores > 1 ? cores - 1 : 1u, 1u), 4u);
+
+	for (unsigned int i = 0; i < count; i++) {
+		mWorkers.emplace_back(&TextureLoader::work, this);
+	}
+}
+
+void TextureLoader::request(Texture* texture, const std::string& path, MipmapMode mipmaps, TextureFormat format) {
+
+	Job job;
+	job.mTexture = texture;
+	job.mPath = path;
+	job.mMipmaps = mipmaps;
+	job.mFormat = format;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mWorkers.empty()) {
+			start();
+		}
+		mQueued.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+void TextureLoader::request(Texture* texture, const unsigned char* data, size_t size, MipmapMode mipmaps, TextureFormat format) {
+
+	// The source usually lives in a mapping that is closed before the decode runs
+	Job job;
+	job.mTexture = texture;
+	job.mEncoded.assign(data, data + size);
+	job.mMipmaps = mipmaps;
+	job.mFormat = format;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mWorkers.empty()) {
+			start();
+		}
+		mQueued.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+void TextureLoader::request(Texture* texture, std::vector<unsigned char>&& texels, int width, int height, MipmapMode mipmaps, TextureFormat format) {
+
+	Job job;
+	job.mTexture = texture;
+	job.mEncoded = std::move(texels);
+	job.mRaw = true;
+	job.mWidth = width;
+	job.mHeight = height;
+	job.mMipmaps = mipmaps;
+	job.mFormat = format;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mWorkers.empty()) {
+			start();
+		}
+		mQueued.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+void TextureLoader::request(Texture* texture, TextureBuilder&& build, MipmapMode mipmaps, TextureFormat format) {
+
+	Job job;
+	job.mTexture = texture;
+	job.mBuild = std::move(build);
+	job.mMipmaps = mipmaps;
+	job.mFormat = format;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mWorkers.empty()) {
+			start();
+		}
+		mQueued.push_back(std::move(job));
+	}
+	mWake.notify_one();
+}
+
+void TextureLoader::cancel(Texture* texture) {
+
+	auto matches = [texture](const Job& job) { return job.mTexture == texture; };
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		mQueued.erase(std::remove_if(mQueued.begin(), mQueued.end(), matches), mQueued.end());
+
+		for (auto& job : mReady) {
+			if (matches(job)) {
+				stbi_image_free(job.mTexels);
+			}
+		}
+		mReady.erase(std::remove_if(mReady.begin(), mReady.end(), matches), mReady.end());
+
+		if (mDecoding.count(texture) > 0) {
+			mCancelled.insert(texture);
+		}
+	}
+
+	for (auto& job : mUploading) {
+		if (matches(job)) {
+
+			stbi_image_free(job.mTexels);
+			GLStateCache::forgetTexture(job.mStaging);
+			glDeleteTextures(1, &job.mStaging);
+		}
+	}
+	mUploading.erase(std::remove_if(mUploading.begin(), mUploading.end(), matches), mUploading.end());
+}
+
+void TextureLoader::work() {
+
+	// Per thread flag, the GL thread keeps its own
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	for (;;) {
+
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStop || !mQueued.empty(); });
+			if (mStop) {
+				return;
+			}
+
+			job = std::move(mQueued.front());
+			mQueued.pop_front();
+			mDecoding.insert(job.mTexture);
+		}
+
+		bool compressed = job.mFormat != TextureFormat::Rgba8;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bool cacheHit = compressed && readCache(job);
+		if (!cacheHit) {
+			decode(job);
+		}
+		auto decoded = std::chrono::high_resolution_clock::now();
+
+		if (job.mTexels != nullptr && compressed) {
+			compress(job);
+		}
+		else if (job.mTexels != nullptr && (job.mMipmaps == MipmapMode::Box || job.mMipmaps == MipmapMode::Kaiser)) {
+
+			MipmapFilter filter = job.mMipmaps == MipmapMode::Kaiser ? MipmapFilter::Kaiser : MipmapFilter::Box;
+			MipmapGenerator::generate(job.mTexels, job.mWidth, job.mHeight, filter, job.mLevels);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDecoding.erase(job.mTexture);
+			mStats.mDecodeTime += std::chrono::duration<float, std::milli>(decoded - start).count();
+			(compressed ? mStats.mEncodeTime : mStats.mMipmapTime) += std::chrono::duration<float, std::milli>(end - decoded).count();
+			mStats.mCacheHits += cacheHit ? 1 : 0;
+
+			if (mCancelled.erase(job.mTexture) > 0 || (job.mTexels == nullptr && job.mBlocks.empty())) {
+				stbi_image_free(job.mTexels);
+			}
+			else {
+				mReady.push_back(std::move(job));
+			}
+		}
+		mDecoded.notify_all();
+	}
+}
+
+void TextureLoader::decode(Job& job) {
+
+	int channels;
+	if (job.mBuild) {
+
+		// A failed build leaves no texels, the job is dropped like a failed decode
+		job.mRaw = job.mBuild(job.mEncoded, job.mWidth, job.mHeight) && !job.mEncoded.empty();
+		job.mBuild = nullptr;
+		if (!job.mRaw) {
+			std::cout << "Error: Texture builder produced no texels" << std::endl;
+			job.mEncoded = std::vector<unsigned char>();
+			return;
+		}
+	}
+
+	if (job.mRaw) {
+
+		// stbi_image_free is free(), raw texels join the decoded ones in a malloc block
+		job.mTexels = static_cast<unsigned char*>(malloc(job.mEncoded.size()));
+		if (job.mTexels != nullptr) {
+			std::memcpy(job.mTexels, job.mEncoded.data(), job.mEncoded.size());
+		}
+		job.mEncoded = std::vector<unsigned char>();
+	}
+	else if (job.mEncoded.empty()) {
+		job.mTexels = stbi_load(job.mPath.c_str(), &job.mWidth, &job.mHeight, &channels, STBI_rgb_alpha);
+	}
+	else {
+		job.mTexels = stbi_load_from_memory(job.mEncoded.data(), (int)job.mEncoded.size(), &job.mWidth, &job.mHeight, &channels, STBI_rgb_alpha);
+		job.mEncoded = std::vector<unsigned char>();
+	}
+
+	if (job.mTexels == nullptr) {
+		std::cout << "Error: Texture failed to load at path - " << job.mPath << std::endl;
+	}
+}
+
+bool TextureLoader::readCache(Job& job) {
+
+	if (job.mPath.empty()) {
+		return false;
+	}
+
+	bool found = false;
+	job.mSourceHash = TextureCache::hashFile(job.mPath, found);
+
+	bool mipmaps = job.mMipmaps != MipmapMode::None;
+	MipmapFilter filter = job.mMipmaps == MipmapMode::Box ? MipmapFilter::Box : MipmapFilter::Kaiser;
+	if (!found || !TextureCache::read(TextureCache::getCachePath(job.mPath), job.mSourceHash, job.mFormat, mipmaps, filter, job.mBlocks)) {
+		return false;
+	}
+
+	job.mWidth = job.mBlocks[0].mWidth;
+	job.mHeight = job.mBlocks[0].mHeight;
+	return true;
+}
+
+void TextureLoader::compress(Job& job) {
+
+	// Compressed storage cannot be filled by glGenerateMipmap, Gpu chains are filtered here
+	bool mipmaps = job.mMipmaps != MipmapMode::None;
+	MipmapFilter filter = job.mMipmaps == MipmapMode::Box ? MipmapFilter::Box : MipmapFilter::Kaiser;
+	TextureCache::encode(job.mTexels, job.mWidth, job.mHeight, job.mFormat, mipmaps, filter, job.mBlocks);
+
+	stbi_image_free(job.mTexels);
+	job.mTexels = nullptr;
+
+	if (!job.mPath.empty()) {
+		TextureCache::write(TextureCache::getCachePath(job.mPath), job.mSourceHash, job.mFormat, mipmaps, filter, job.mBlocks);
+	}
+}
+
+void TextureLoader::update() {
+
+	upload(mUploadBudget);
+}
+
+void TextureLoader::finish() {
+
+	for (;;) {
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			if (mQueued.empty() && mDecoding.empty() && mReady.empty() && mUploading.empty()) {
+				break;
+			}
+
+			// Wait for a decode only when nothing is left to upload
+			if (mUploading.empty()) {
+				mDecoded.wait(lock, [this]() { return !mReady.empty() || (mQueued.empty() && mDecoding.empty()); });
+			}
+		}
+
+		upload(std::numeric_limits<size_t>::max());
+	}
+}
+
+GLuint TextureLoader::getPlaceholder() {
+
+	if (mPlaceholder == 0) {
+
+		const unsigned char gray[4] = { 128, 128, 128, 255 };
+
+		glGenTextures(1, &mPlaceholder);
+		GLStateCache::bindTexture(0, GL_TEXTURE_2D, mPlaceholder);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+
+	return mPlaceholder;
+}
+
+void TextureLoader::upload(size_t budget) {
+
+	mStats.mUploadedBytes = 0;
+
+	// 1 Take over what the workers finished
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		while (!mReady.empty()) {
+
+			mUploading.push_back(std::move(mReady.front()));
+			mReady.pop_front();
+		}
+		mStats.mPending = (unsigned int)(mQueued.size() + mDecoding.size() + mUploading.size());
+	}
+
+	// 2 Oldest first, a large image spans several frames
+	while (budget > 0 && !mUploading.empty()) {
+
+		Job& job = mUploading.front();
+		size_t copied = uploadRows(job, budget);
+		budget = copied < budget ? budget - copied : 0;
+		mStats.mUploadedBytes += copied;
+
+		if (advance(job)) {
+
+			complete(job);
+			mUploading.pop_front();
+			mStats.mPending--;
+		}
+	}
+}
+
+size_t TextureLoader::uploadRows(Job& job, size_t budget) {
+
+	bool compressed = job.mFormat != TextureFormat::Rgba8;
+	GLenum format = BlockCompressor::getGLFormat(job.mFormat);
+
+	// 1 Storage of the whole chain, filled while the placeholder is still bound
+	if (job.mStaging == 0) {
+
+		bool mipmapped = job.mMipmaps != MipmapMode::None;
+		if (compressed) {
+			job.mLevelCount = (int)job.mBlocks.size();
+		}
+		else {
+			job.mLevelCount = mipmapped ? MipmapGenerator::getLevelCount(job.mWidth, job.mHeight) : 1;
+		}
+
+		glGenTextures(1, &job.mStaging);
+		GLStateCache::bindTexture(0, GL_TEXTURE_2D, job.mStaging);
+		glTexStorage2D(GL_TEXTURE_2D, job.mLevelCount, format, job.mWidth, job.mHeight);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	}
+
+	const unsigned char* texels = job.mTexels;
+	int width = job.mWidth;
+	int height = job.mHeight;
+	if (compressed) {
+
+		const CompressedLevel& level = job.mBlocks[job.mUploadedLevel];
+		texels = level.mBlocks.data();
+		width = level.mWidth;
+		height = level.mHeight;
+	}
+	else if (job.mUploadedLevel > 0) {
+
+		const MipLevel& level = job.mLevels[job.mUploadedLevel - 1];
+		texels = level.mTexels.data();
+		width = level.mWidth;
+		height = level.mHeight;
+	}
+
+	// A compressed row is one row of 4x4 blocks
+	size_t rowSize = compressed ? BlockCompressor::getSize(job.mFormat, width, 1) : (size_t)width * 4;
+
+	// 2 Buffers hold one budget, at least one row
+	size_t pboSize = std::max(mUploadBudget, rowSize);
+	if (mPboSize != pboSize) {
+
+		if (mPbos[0] == 0) {
+			glGenBuffers(2, mPbos);
+		}
+		for (GLuint pbo : mPbos) {
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, pboSize, NULL, GL_STREAM_DRAW);
+		}
+		mPboSize = pboSize;
+	}
+
+	// 3 Whole rows, never less than one so a narrow budget still progresses
+	size_t rows = std::min(std::min(budget, mPboSize) / rowSize, (size_t)(getRowCount(job) - job.mUploadedRows));
+	rows = std::max(rows, (size_t)1);
+	size_t size = rows * rowSize;
+
+	// 4 Invalidated mapping, the driver renames the buffer instead of waiting on the last copy
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mPbos[mPboIndex]);
+	mPboIndex ^= 1;
+
+	const unsigned char* source = texels + (size_t)job.mUploadedRows * rowSize;
+	const void* pixels = (const void*)0;
+
+	void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (target != nullptr) {
+
+		std::memcpy(target, source, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else {
+
+		// Mapping failed, copy straight from the decoded texels
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		pixels = source;
+	}
+
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, job.mStaging);
+	if (compressed) {
+
+		// Only the last block row may end inside a block
+		int y = job.mUploadedRows * 4;
+		int rowsHeight = std::min((int)rows * 4, height - y);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, job.mUploadedLevel, 0, y, width, rowsHeight, format, (GLsizei)size, pixels);
+	}
+	else {
+		glTexSubImage2D(GL_TEXTURE_2D, job.mUploadedLevel, 0, job.mUploadedRows, width, (GLsizei)rows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	job.mUploadedRows += (int)rows;
+	return size;
+}
+
+int TextureLoader::getRowCount(const Job& job) {
+
+	if (job.mFormat != TextureFormat::Rgba8) {
+		return (job.mBlocks[job.mUploadedLevel].mHeight + 3) / 4;
+	}
+	return job.mUploadedLevel > 0 ? job.mLevels[job.mUploadedLevel - 1].mHeight : job.mHeight;
+}
+
+bool TextureLoader::advance(Job& job) {
+
+	if (job.mUploadedRows < getRowCount(job)) {
+		return false;
+	}
+
+	job.mUploadedLevel++;
+	job.mUploadedRows = 0;
+
+	// Levels the workers did not filter are built by the GPU from the base
+	if (job.mFormat == TextureFormat::Rgba8 && job.mUploadedLevel > (int)job.mLevels.size() && job.mUploadedLevel < job.mLevelCount) {
+
+		GLStateCache::bindTexture(0, GL_TEXTURE_2D, job.mStaging);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		return true;
+	}
+
+	return job.mUploadedLevel >= job.mLevelCount;
+}
+
+void TextureLoader::complete(Job& job) {
+
+	// Storage of every level against the RGBA8 chain of the same size
+	int width = job.mWidth, height = job.mHeight;
+	for (int i = 0; i < job.mLevelCount; i++) {
+
+		mStats.mGpuBytes += BlockCompressor::getSize(job.mFormat, width, height);
+		mStats.mRgbaBytes += BlockCompressor::getSize(TextureFormat::Rgba8, width, height);
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+
+	stbi_image_free(job.mTexels);
+	job.mTexels = nullptr;
+	job.mLevels = std::vector<MipLevel>();
+	job.mBlocks = std::vector<CompressedLevel>();
+
+	Texture* texture = job.mTexture;
+	texture->mTexture = job.mStaging;
+	texture->mWidth = job.mWidth;
+	texture->mHeight = job.mHeight;
+	texture->mLevels = job.mLevelCount;
+	texture->mFormat = job.mFormat;
+	texture->mReady = true;
+
+	mStats.mCompleted++;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "core.h"
+#include "texture.h"
+#include "tools/mipmapGenerator.h"
+#include "tools/textureCache.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+struct TextureLoaderStats {
+	unsigned int mPending{ 0 };			// requested, not on the GPU yet
+	unsigned int mCompleted{ 0 };
+	size_t mUploadedBytes{ 0 };			// last update()
+	float mDecodeTime{ 0.0f };			// ms, summed over the workers
+	float mMipmapTime{ 0.0f };			// ms of CPU mip filtering, summed over the workers
+	float mEncodeTime{ 0.0f };			// ms of mip filtering and block encoding of compressed formats
+	unsigned int mCacheHits{ 0 };		// compressed chains read from a .texcache
+	size_t mGpuBytes{ 0 };				// storage of every completed texture, all levels
+	size_t mRgbaBytes{ 0 };				// the same textures as RGBA8
+};
+
+// Texture files are decoded by a pool of worker threads, the GL thread uploads the texels
+// through a pixel unpack buffer in row chunks of at most the upload budget per update().
+// Box and Kaiser mip chains are filtered on the workers too, every level is uploaded the same way.
+// Block compressed formats read their chain from the .texcache next to the source, or encode it
+// on the workers and write it there. A requested texture shows a shared placeholder until its last row arrived
+class TextureLoader {
+
+public:
+	TextureLoader();
+	~TextureLoader();
+
+	// Shared by every Texture
+	static TextureLoader& getDefault();
+
+	// Decode a file, or an encoded image copied out of data, into texture
+	// Compressed formats need a CPU filtered chain, see Texture::createTexture
+	void request(Texture* texture, const std::string& path, MipmapMode mipmaps, TextureFormat format);
+	void request(Texture* texture, const unsigned char* data, size_t size, MipmapMode mipmaps, TextureFormat format);
+
+	// RGBA8 texels, rows bottom up like a flipped decode, only filtered and uploaded
+	void request(Texture* texture, std::vector<unsigned char>&& texels, int width, int height, MipmapMode mipmaps, TextureFormat format);
+
+	// Texels assembled by build on a worker, then filtered and uploaded like raw texels
+	void request(Texture* texture, TextureBuilder&& build, MipmapMode mipmaps, TextureFormat format);
+
+	// Drop the requests of a texture that is being deleted
+	void cancel(Texture* texture);
+
+	// Upload decoded texels, call once per frame on the GL thread
+	void update();
+
+	// Upload everything requested so far, blocking on the workers
+	void finish();
+
+	// Bytes copied to the GPU per update()
+	void setUploadBudget(size_t bytes) { mUploadBudget = bytes > 0 ? bytes : 1; }
+	size_t getUploadBudget() const { return mUploadBudget; }
+
+	// 1x1 texture bound in place of pending ones
+	GLuint getPlaceholder();
+
+	const TextureLoaderStats& getStats() const { return mStats; }
+
+private:
+	struct Job {
+		Texture* mTexture{ nullptr };
+		std::string mPath{};
+		std::vector<unsigned char> mEncoded{};	// memory request, empty for a file
+		bool mRaw{ false };						// mEncoded already holds mWidth x mHeight texels
+		TextureBuilder mBuild{};				// fills mEncoded and the size on the worker, then raw
+		MipmapMode mMipmaps{ MipmapMode::None };
+		TextureFormat mFormat{ TextureFormat::Rgba8 };
+		uint64_t mSourceHash{ 0 };
+
+		unsigned char* mTexels{ nullptr };		// RGBA8, freed by stbi_image_free
+		int mWidth{ 0 };
+		int mHeight{ 0 };
+		std::vector<MipLevel> mLevels{};		// CPU filtered levels below the base
+		std::vector<CompressedLevel> mBlocks{};	// compressed formats, every level, base first
+
+		GLuint mStaging{ 0 };					// filled row by row, swapped in when complete
+		int mLevelCount{ 1 };
+		int mUploadedLevel{ 0 };
+		int mUploadedRows{ 0 };					// of mUploadedLevel, block rows when compressed
+	};
+
+	void start();
+	void work();
+	void decode(Job& job);
+
+	// Chain of a compressed file job from its cache, false when it has to be encoded
+	bool readCache(Job& job);
+
+	// Filter and compress the decoded texels, then cache the chain of a file job
+	void compress(Job& job);
+
+	// Upload ready jobs until budget bytes were copied
+	void upload(size_t budget);
+
+	// Copy rows of the current level of one job through the next pixel unpack buffer,
+	// rows of 4x4 blocks when compressed, returns the bytes copied
+	size_t uploadRows(Job& job, size_t budget);
+
+	// Rows of the current level
+	static int getRowCount(const Job& job);
+
+	// Advance past finished levels, true when nothing is left to upload
+	bool advance(Job& job);
+
+	void complete(Job& job);
+
+private:
+	std::vector<std::thread> mWorkers{};
+	std::mutex mMutex{};
+	std::condition_variable mWake{};
+	std::condition_variable mDecoded{};
+
+	// Guarded by mMutex
+	std::deque<Job> mQueued{};
+	std::deque<Job> mReady{};
+	std::unordered_set<Texture*> mDecoding{};
+	std::unordered_set<Texture*> mCancelled{};	// deleted while a worker decoded them
+	bool mStop{ false };
+
+	// GL thread only
+	std::deque<Job> mUploading{};
+	GLuint mPbos[2]{ 0, 0 };
+	size_t mPboSize{ 0 };
+	unsigned int mPboIndex{ 0 };
+	GLuint mPlaceholder{ 0 };
+
+	size_t mUploadBudget{ 4 * 1024 * 1024 };
+	TextureLoaderStats mStats{};
+};
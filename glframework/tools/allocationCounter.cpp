@@ -0,0 +1,96 @@
+#include "allocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> allocationCount{ 0 };
+
+size_t AllocationCounter::getCount() {
+
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+static void* countedAllocate(size_t size) {
+
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* pointer = std::malloc(size == 0 ? 1 : size);
+	if (pointer == nullptr) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new(size_t size) {
+	return countedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+	return countedAllocate(size);
+}
+
+// Over-aligned types (alignas beyond max_align_t) take these, counted the same way
+static void* countedAllocateAligned(size_t size, std::align_val_t alignment) {
+
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+	void* pointer = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	void* pointer = std::aligned_alloc(align, ((size == 0 ? 1 : size) + align - 1) / align * align);
+#endif
+	if (pointer == nullptr) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+static void countedFreeAligned(void* pointer) {
+#ifdef _WIN32
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	return countedAllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return countedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+	countedFreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+	countedFreeAligned(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+	countedFreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+	countedFreeAligned(pointer);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+
+// Counts every global operator new of the process, the replacement lives in allocationCounter.cpp.
+// Take the difference around a block to see how often it reaches the heap
+class AllocationCounter {
+public:
+
+	static size_t getCount();
+};
@@ -0,0 +1,665 @@
+#include "blockCompressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// BC7 interpolation weights of 4 bit indices, out of 64
+static const int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+namespace {
+
+	// Mean and principal axis of count points of dims floats, the axis is zero for a flat block
+	void principalAxis(const float* points, int count, int dims, float* mean, float* axis) {
+
+		for (int d = 0; d < dims; d++) {
+
+			mean[d] = 0.0f;
+			for (int i = 0; i < count; i++) {
+				mean[d] += points[i * dims + d];
+			}
+			mean[d] /= count;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < count; i++) {
+			for (int a = 0; a < dims; a++) {
+				for (int b = 0; b < dims; b++) {
+					covariance[a][b] += (points[i * dims + a] - mean[a]) * (points[i * dims + b] - mean[b]);
+				}
+			}
+		}
+
+		// Power iteration converges quickly on the dominant axis of a 4x4 block
+		for (int d = 0; d < dims; d++) {
+			axis[d] = 1.0f;
+		}
+		for (int iteration = 0; iteration < 8; iteration++) {
+
+			float next[4] = {};
+			float length = 0.0f;
+			for (int a = 0; a < dims; a++) {
+				for (int b = 0; b < dims; b++) {
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+
+			length = std::sqrt(length);
+			if (length < 1e-6f) {
+				for (int d = 0; d < dims; d++) {
+					axis[d] = 0.0f;
+				}
+				return;
+			}
+			for (int d = 0; d < dims; d++) {
+				axis[d] = next[d] / length;
+			}
+		}
+	}
+
+	// Endpoints at the extremes of the projections on the axis, first one at the top
+	void fitEndpoints(const float* points, int count, int dims, float* end0, float* end1) {
+
+		float mean[4], axis[4];
+		principalAxis(points, count, dims, mean, axis);
+
+		float minT = 0.0f, maxT = 0.0f;
+		for (int i = 0; i < count; i++) {
+
+			float t = 0.0f;
+			for (int d = 0; d < dims; d++) {
+				t += (points[i * dims + d] - mean[d]) * axis[d];
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+
+		for (int d = 0; d < dims; d++) {
+			end0[d] = glm::clamp(mean[d] + axis[d] * maxT, 0.0f, 255.0f);
+			end1[d] = glm::clamp(mean[d] + axis[d] * minT, 0.0f, 255.0f);
+		}
+	}
+
+	// Least squares endpoints for fixed weights of end0, false when the weights are degenerate
+	bool refineEndpoints(const float* points, const float* weights, int count, int dims, float* end0, float* end1) {
+
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < count; i++) {
+
+			float a = weights[i], b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int d = 0; d < dims; d++) {
+				ax[d] += a * points[i * dims + d];
+				bx[d] += b * points[i * dims + d];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f) {
+			return false;
+		}
+
+		for (int d = 0; d < dims; d++) {
+			end0[d] = glm::clamp((bb * ax[d] - ab * bx[d]) / determinant, 0.0f, 255.0f);
+			end1[d] = glm::clamp((aa * bx[d] - ab * ax[d]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	uint16_t packRgb565(const float* color) {
+
+		int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+		int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+		int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRgb565(uint16_t packed, int* color) {
+
+		int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Four color palette of c0 > c1, or three colors and black of c0 <= c1
+	void bc1Palette(uint16_t c0, uint16_t c1, int palette[4][3]) {
+
+		unpackRgb565(c0, palette[0]);
+		unpackRgb565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+
+			if (c0 > c1) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	// Quantize endpoints and pick indices, returns the squared error
+	float bc1Quantize(const float* colors, const float* end0, const float* end1, uint16_t& c0, uint16_t& c1, uint8_t* indices) {
+
+		c0 = packRgb565(end0);
+		c1 = packRgb565(end1);
+		if (c0 < c1) {
+			std::swap(c0, c1);
+		}
+
+		int palette[4][3];
+		bc1Palette(c0, c1, palette);
+
+		// Equal endpoints select the three color mode, index 0 still decodes to c0
+		int entries = c0 == c1 ? 1 : 4;
+
+		float error = 0.0f;
+		for (int i = 0; i < 16; i++) {
+
+			float best = 1e30f;
+			for (int e = 0; e < entries; e++) {
+
+				float distance = 0.0f;
+				for (int c = 0; c < 3; c++) {
+					float d = colors[i * 3 + c] - palette[e][c];
+					distance += d * d;
+				}
+				if (distance < best) {
+					best = distance;
+					indices[i] = (uint8_t)e;
+				}
+			}
+			error += best;
+		}
+
+		return error;
+	}
+
+	uint8_t bc4Value(int r0, int r1, int index) {
+
+		if (index == 0) {
+			return (uint8_t)r0;
+		}
+		if (index == 1) {
+			return (uint8_t)r1;
+		}
+		if (r0 > r1) {
+			return (uint8_t)(((8 - index) * r0 + (index - 1) * r1) / 7);
+		}
+		if (index == 6) {
+			return 0;
+		}
+		if (index == 7) {
+			return 255;
+		}
+		return (uint8_t)(((6 - index) * r0 + (index - 1) * r1) / 5);
+	}
+
+	// Endpoint with its shared p bit, 7 bits plus 1
+	void bc7Quantize(const float* end, int* quantized, int& pBit) {
+
+		float bestError = 1e30f;
+		for (int p = 0; p < 2; p++) {
+
+			float error = 0.0f;
+			int values[4];
+			for (int c = 0; c < 4; c++) {
+
+				values[c] = glm::clamp((int)std::lround((end[c] - p) / 2.0f), 0, 127);
+				float d = (float)((values[c] << 1) | p) - end[c];
+				error += d * d;
+			}
+
+			if (error < bestError) {
+				bestError = error;
+				pBit = p;
+				std::memcpy(quantized, values, sizeof(values));
+			}
+		}
+	}
+
+	float bc7Indices(const float* texels, const int* q0, int p0, const int* q1, int p1, uint8_t* indices) {
+
+		int palette[16][4];
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+
+				int e0 = (q0[c] << 1) | p0;
+				int e1 = (q1[c] << 1) | p1;
+				palette[i][c] = ((64 - Bc7Weights[i]) * e0 + Bc7Weights[i] * e1 + 32) >> 6;
+			}
+		}
+
+		float error = 0.0f;
+		for (int i = 0; i < 16; i++) {
+
+			float best = 1e30f;
+			for (int e = 0; e < 16; e++) {
+
+				float distance = 0.0f;
+				for (int c = 0; c < 4; c++) {
+					float d = texels[i * 4 + c] - palette[e][c];
+					distance += d * d;
+				}
+				if (distance < best) {
+					best = distance;
+					indices[i] = (uint8_t)e;
+				}
+			}
+			error += best;
+		}
+
+		return error;
+	}
+
+	void writeBits(uint8_t* block, int& position, uint32_t value, int count) {
+
+		for (int i = 0; i < count; i++, position++) {
+			if ((value >> i) & 1) {
+				block[position >> 3] |= (uint8_t)(1 << (position & 7));
+			}
+		}
+	}
+
+	uint32_t readBits(const uint8_t* block, int& position, int count) {
+
+		uint32_t value = 0;
+		for (int i = 0; i < count; i++, position++) {
+			value |= (uint32_t)((block[position >> 3] >> (position & 7)) & 1) << i;
+		}
+		return value;
+	}
+}
+
+size_t BlockCompressor::getBlockSize(TextureFormat format) {
+
+	switch (format) {
+	case TextureFormat::Bc1:
+	case TextureFormat::Bc4:
+		return 8;
+	case TextureFormat::Bc3:
+	case TextureFormat::Bc7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t BlockCompressor::getSize(TextureFormat format, int width, int height) {
+
+	if (format == TextureFormat::Rgba8) {
+		return (size_t)width * height * 4;
+	}
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+GLenum BlockCompressor::getGLFormat(TextureFormat format) {
+
+	switch (format) {
+	case TextureFormat::Bc1:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TextureFormat::Bc3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TextureFormat::Bc4:
+		return GL_COMPRESSED_RED_RGTC1;
+	case TextureFormat::Bc7:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default:
+		return GL_RGBA8;
+	}
+}
+
+bool BlockCompressor::parseFormat(const std::string& name, TextureFormat& format) {
+
+	static const std::pair<const char*, TextureFormat> names[] = {
+		{ "rgba8", TextureFormat::Rgba8 },
+		{ "bc1", TextureFormat::Bc1 },
+		{ "bc3", TextureFormat::Bc3 },
+		{ "bc4", TextureFormat::Bc4 },
+		{ "bc7", TextureFormat::Bc7 }
+	};
+
+	for (const auto& entry : names) {
+		if (name == entry.first) {
+			format = entry.second;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool BlockCompressor::isSupported(TextureFormat format) {
+
+	if (format != TextureFormat::Bc1 && format != TextureFormat::Bc3) {
+		return true;
+	}
+
+	static int s3tc = -1;
+	if (s3tc < 0) {
+
+		s3tc = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+
+			const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (name != nullptr && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+				s3tc = 1;
+				break;
+			}
+		}
+	}
+
+	return s3tc == 1;
+}
+
+void BlockCompressor::encodeBc1(const unsigned char* texels, uint8_t* block) {
+
+	float colors[16 * 3];
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			colors[i * 3 + c] = texels[i * 4 + c];
+		}
+	}
+
+	// 1 Principal axis fit
+	float end0[3], end1[3];
+	fitEndpoints(colors, 16, 3, end0, end1);
+
+	uint16_t c0, c1;
+	uint8_t indices[16];
+	float error = bc1Quantize(colors, end0, end1, c0, c1, indices);
+
+	// 2 One least squares pass over the chosen indices
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float texelWeights[16];
+	for (int i = 0; i < 16; i++) {
+		texelWeights[i] = weights[indices[i]];
+	}
+
+	if (c0 != c1 && refineEndpoints(colors, texelWeights, 16, 3, end0, end1)) {
+
+		uint16_t r0, r1;
+		uint8_t refined[16];
+		if (bc1Quantize(colors, end0, end1, r0, r1, refined) < error) {
+			c0 = r0;
+			c1 = r1;
+			std::memcpy(indices, refined, sizeof(indices));
+		}
+	}
+
+	// 3 Endpoints, then 2 bit indices in row order
+	block[0] = (uint8_t)(c0 & 0xFF);
+	block[1] = (uint8_t)(c0 >> 8);
+	block[2] = (uint8_t)(c1 & 0xFF);
+	block[3] = (uint8_t)(c1 >> 8);
+
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++) {
+		bits |= (uint32_t)indices[i] << (i * 2);
+	}
+	std::memcpy(block + 4, &bits, sizeof(bits));
+}
+
+void BlockCompressor::encodeBc4(const unsigned char* texels, int channel, uint8_t* block) {
+
+	int r0 = 0, r1 = 255;
+	for (int i = 0; i < 16; i++) {
+		r0 = std::max(r0, (int)texels[i * 4 + channel]);
+		r1 = std::min(r1, (int)texels[i * 4 + channel]);
+	}
+
+	// r0 > r1 selects 8 interpolated values, a flat block only uses index 0.
+	// Zero stays exact both ways, masks are discarded on it
+	uint64_t bits = 0;
+	for (int i = 0; i < 16 && r0 != r1; i++) {
+
+		int value = texels[i * 4 + channel];
+		int bestIndex = 0, best = 256;
+		for (int index = 0; index < 8; index++) {
+
+			uint8_t decoded = bc4Value(r0, r1, index);
+			int distance = std::abs(decoded - value);
+			if (distance < best && (decoded == 0) == (value == 0)) {
+				best = distance;
+				bestIndex = index;
+			}
+		}
+		bits |= (uint64_t)bestIndex << (i * 3);
+	}
+
+	block[0] = (uint8_t)r0;
+	block[1] = (uint8_t)r1;
+	for (int i = 0; i < 6; i++) {
+		block[2 + i] = (uint8_t)(bits >> (i * 8));
+	}
+}
+
+void BlockCompressor::encodeBc7(const unsigned char* texels, uint8_t* block) {
+
+	float points[16 * 4];
+	for (int i = 0; i < 16 * 4; i++) {
+		points[i] = texels[i];
+	}
+
+	// 1 Principal axis fit in RGBA
+	float end0[4], end1[4];
+	fitEndpoints(points, 16, 4, end0, end1);
+
+	int q0[4], q1[4], p0, p1;
+	bc7Quantize(end0, q0, p0);
+	bc7Quantize(end1, q1, p1);
+
+	uint8_t indices[16];
+	float error = bc7Indices(points, q0, p0, q1, p1, indices);
+
+	// 2 One least squares pass over the chosen indices
+	float weights[16];
+	for (int i = 0; i < 16; i++) {
+		weights[i] = 1.0f - Bc7Weights[indices[i]] / 64.0f;
+	}
+
+	if (refineEndpoints(points, weights, 16, 4, end0, end1)) {
+
+		int r0[4], r1[4], rp0, rp1;
+		bc7Quantize(end0, r0, rp0);
+		bc7Quantize(end1, r1, rp1);
+
+		uint8_t refined[16];
+		if (bc7Indices(points, r0, rp0, r1, rp1, refined) < error) {
+
+			std::memcpy(q0, r0, sizeof(q0));
+			std::memcpy(q1, r1, sizeof(q1));
+			p0 = rp0;
+			p1 = rp1;
+			std::memcpy(indices, refined, sizeof(indices));
+		}
+	}
+
+	// 3 The first index is stored without its top bit, swap the ends when it is set
+	if (indices[0] >= 8) {
+
+		std::swap(q0, q1);
+		std::swap(p0, p1);
+		for (uint8_t& index : indices) {
+			index = (uint8_t)(15 - index);
+		}
+	}
+
+	// 4 Mode 6: mode bit, RGBA endpoints channel by channel, p bits, indices
+	std::memset(block, 0, 16);
+	int position = 0;
+	writeBits(block, position, 1 << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writeBits(block, position, (uint32_t)q0[c], 7);
+		writeBits(block, position, (uint32_t)q1[c], 7);
+	}
+	writeBits(block, position, (uint32_t)p0, 1);
+	writeBits(block, position, (uint32_t)p1, 1);
+	for (int i = 0; i < 16; i++) {
+		writeBits(block, position, indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+void BlockCompressor::decodeBc1(const uint8_t* block, unsigned char* texels) {
+
+	uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+
+	int palette[4][3];
+	bc1Palette(c0, c1, palette);
+
+	uint32_t bits;
+	std::memcpy(&bits, block + 4, sizeof(bits));
+	for (int i = 0; i < 16; i++) {
+
+		int index = (bits >> (i * 2)) & 3;
+		for (int c = 0; c < 3; c++) {
+			texels[i * 4 + c] = (unsigned char)palette[index][c];
+		}
+		texels[i * 4 + 3] = (c0 <= c1 && index == 3) ? 0 : 255;
+	}
+}
+
+void BlockCompressor::decodeBc4(const uint8_t* block, int channel, unsigned char* texels) {
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++) {
+		bits |= (uint64_t)block[2 + i] << (i * 8);
+	}
+
+	for (int i = 0; i < 16; i++) {
+		texels[i * 4 + channel] = bc4Value(block[0], block[1], (int)((bits >> (i * 3)) & 7));
+	}
+}
+
+void BlockCompressor::decodeBc7(const uint8_t* block, unsigned char* texels) {
+
+	// Only mode 6 is produced here, other modes decode to black
+	if ((block[0] & 0x7F) != (1 << 6)) {
+		std::memset(texels, 0, 16 * 4);
+		return;
+	}
+
+	int position = 7;
+	int q0[4], q1[4];
+	for (int c = 0; c < 4; c++) {
+		q0[c] = (int)readBits(block, position, 7);
+		q1[c] = (int)readBits(block, position, 7);
+	}
+	int p0 = (int)readBits(block, position, 1);
+	int p1 = (int)readBits(block, position, 1);
+
+	for (int i = 0; i < 16; i++) {
+
+		int index = (int)readBits(block, position, i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++) {
+
+			int e0 = (q0[c] << 1) | p0;
+			int e1 = (q1[c] << 1) | p1;
+			texels[i * 4 + c] = (unsigned char)(((64 - Bc7Weights[index]) * e0 + Bc7Weights[index] * e1 + 32) >> 6);
+		}
+	}
+}
+
+void BlockCompressor::compress(const unsigned char* rgba, int width, int height, TextureFormat format, std::vector<uint8_t>& blocks) {
+
+	if (format == TextureFormat::Rgba8) {
+		blocks.assign(rgba, rgba + getSize(format, width, height));
+		return;
+	}
+
+	size_t blockSize = getBlockSize(format);
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	blocks.resize((size_t)blocksX * blocksY * blockSize);
+
+	unsigned char texels[16 * 4];
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+
+			// 1 Gather, edges repeat
+			for (int y = 0; y < 4; y++) {
+				for (int x = 0; x < 4; x++) {
+
+					int sx = std::min(bx * 4 + x, width - 1);
+					int sy = std::min(by * 4 + y, height - 1);
+					std::memcpy(texels + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+				}
+			}
+
+			// 2 Encode
+			uint8_t* block = blocks.data() + ((size_t)by * blocksX + bx) * blockSize;
+			switch (format) {
+			case TextureFormat::Bc1:
+				encodeBc1(texels, block);
+				break;
+			case TextureFormat::Bc3:
+				encodeBc4(texels, 3, block);
+				encodeBc1(texels, block + 8);
+				break;
+			case TextureFormat::Bc4:
+				encodeBc4(texels, 0, block);
+				break;
+			case TextureFormat::Bc7:
+				encodeBc7(texels, block);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void BlockCompressor::decompress(const uint8_t* blocks, int width, int height, TextureFormat format, std::vector<unsigned char>& rgba) {
+
+	if (format == TextureFormat::Rgba8) {
+		rgba.assign(blocks, blocks + getSize(format, width, height));
+		return;
+	}
+
+	size_t blockSize = getBlockSize(format);
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	rgba.assign((size_t)width * height * 4, 0);
+
+	unsigned char texels[16 * 4];
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+
+			// 1 Decode, a single channel reads as (r, 0, 0, 1) like the sampler returns it
+			const uint8_t* block = blocks + ((size_t)by * blocksX + bx) * blockSize;
+			std::memset(texels, 0, sizeof(texels));
+			switch (format) {
+			case TextureFormat::Bc1:
+				decodeBc1(block, texels);
+				break;
+			case TextureFormat::Bc3:
+				decodeBc1(block + 8, texels);
+				decodeBc4(block, 3, texels);
+				break;
+			case TextureFormat::Bc4:
+				decodeBc4(block, 0, texels);
+				for (int i = 0; i < 16; i++) {
+					texels[i * 4 + 3] = 255;
+				}
+				break;
+			case TextureFormat::Bc7:
+				decodeBc7(block, texels);
+				break;
+			default:
+				break;
+			}
+
+			// 2 Scatter the texels inside the image
+			for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+				for (int x = 0; x < 4 && bx * 4 + x < width; x++) {
+					std::memcpy(rgba.data() + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
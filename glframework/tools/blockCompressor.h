@@ -0,0 +1,53 @@
+#pragma once
+#include "../core.h"
+#include <cstdint>
+#include <string>
+
+// S3TC is an extension the loader header was generated without, the values are fixed by the spec
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// GPU storage of a loaded image
+enum class TextureFormat : uint32_t {
+	Rgba8 = 0,
+	Bc1 = 1,	// RGB, 4 bits per texel, alpha dropped
+	Bc3 = 2,	// RGBA, 8 bits per texel, BC4 alpha over a BC1 color block
+	Bc4 = 3,	// R only, 4 bits per texel, for masks
+	Bc7 = 4		// RGBA, 8 bits per texel, encoded in mode 6 (one subset, 4 bit indices)
+};
+
+// CPU encoder and reference decoder of 4x4 texel blocks. Images whose sides are not a multiple
+// of 4 are padded by repeating the last row and column, like the hardware expects
+class BlockCompressor {
+public:
+	// Bytes of one 4x4 block, 0 for Rgba8
+	static size_t getBlockSize(TextureFormat format);
+
+	// Bytes of a whole image
+	static size_t getSize(TextureFormat format, int width, int height);
+
+	static GLenum getGLFormat(TextureFormat format);
+
+	// bc1, bc3, bc4, bc7 or rgba8
+	static bool parseFormat(const std::string& name, TextureFormat& format);
+
+	// S3TC needs the extension, the RGTC and BPTC formats are core since 3.0 and 4.2
+	static bool isSupported(TextureFormat format);
+
+	// Rgba8 copies the texels
+	static void compress(const unsigned char* rgba, int width, int height, TextureFormat format, std::vector<uint8_t>& blocks);
+	static void decompress(const uint8_t* blocks, int width, int height, TextureFormat format, std::vector<unsigned char>& rgba);
+
+	// One block, texels are 16 RGBA8 values in row order
+	static void encodeBc1(const unsigned char* texels, uint8_t* block);
+	static void encodeBc4(const unsigned char* texels, int channel, uint8_t* block);
+	static void encodeBc7(const unsigned char* texels, uint8_t* block);
+
+	static void decodeBc1(const uint8_t* block, unsigned char* texels);
+	static void decodeBc4(const uint8_t* block, int channel, unsigned char* texels);
+	static void decodeBc7(const uint8_t* block, unsigned char* texels);
+};
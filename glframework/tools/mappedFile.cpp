@@ -0,0 +1,123 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {}
+
+MappedFile::~MappedFile() {
+
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+
+	close();
+
+	// 1 Open the file and read its size
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	// 2 Map the whole file read only
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = static_cast<const uint8_t*>(data);
+	mSize = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+
+	if (mData != nullptr) {
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping != nullptr) {
+		CloseHandle((HANDLE)mMapping);
+	}
+	if (mFile != nullptr) {
+		CloseHandle((HANDLE)mFile);
+	}
+
+	mData = nullptr;
+	mSize = 0;
+	mMapping = nullptr;
+	mFile = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+
+	close();
+
+	// 1 Open the file and read its size
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		::close(file);
+		return false;
+	}
+
+	// 2 Map the whole file read only
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED) {
+		::close(file);
+		return false;
+	}
+
+	mFile = file;
+	mData = static_cast<const uint8_t*>(data);
+	mSize = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+
+	if (mData != nullptr) {
+		munmap((void*)mData, mSize);
+	}
+	if (mFile >= 0) {
+		::close(mFile);
+	}
+
+	mData = nullptr;
+	mSize = 0;
+	mFile = -1;
+}
+
+#endif
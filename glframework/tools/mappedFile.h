@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read only mapping of a whole file, the pages are faulted in on first touch.
+// Unmapped on close or destruction
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const uint8_t* getData() const { return mData; }
+	size_t getSize() const { return mSize; }
+
+private:
+	const uint8_t* mData{ nullptr };
+	size_t mSize{ 0 };
+
+#ifdef _WIN32
+	void* mFile{ nullptr };
+	void* mMapping{ nullptr };
+#else
+	int mFile{ -1 };
+#endif
+};
@@ -0,0 +1,259 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <cstring>
+
+VertexCacheStats MeshOptimizer::analyze(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, unsigned int cacheSize) {
+
+	VertexCacheStats stats;
+	if (indexCount < 3 || vertexCount == 0) {
+		return stats;
+	}
+
+	// A vertex is cached while fewer than cacheSize misses happened since it was loaded
+	std::vector<uint64_t> loadedAt(vertexCount, 0);
+	uint64_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+
+		uint32_t v = indices[i];
+		if (loadedAt[v] == 0 || misses - loadedAt[v] >= cacheSize) {
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+
+	stats.mAcmr = (float)misses / (float)(indexCount / 3);
+	stats.mAtvr = (float)misses / (float)vertexCount;
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(
+	uint32_t* indices,
+	size_t indexCount,
+	uint32_t vertexCount,
+	unsigned int cacheSize,
+	std::vector<uint32_t>* clusters) {
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// 1 Vertex to triangle adjacency
+	std::vector<uint32_t> liveCount(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		liveCount[indices[i]]++;
+	}
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] = offsets[v] + liveCount[v];
+	}
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int c = 0; c < 3; c++) {
+			adjacency[fill[indices[t * 3 + c]]++] = (uint32_t)t;
+		}
+	}
+
+	// 2 Fan around the current vertex, pick the next one still in cache with the most live triangles
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+
+	uint32_t timeStamp = cacheSize + 1;
+	uint32_t cursor = 0;
+
+	auto skipDeadEnd = [&]() -> int64_t {
+
+		while (!deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveCount[v] > 0) {
+				return v;
+			}
+		}
+
+		while (cursor < vertexCount) {
+			if (liveCount[cursor] > 0) {
+				return cursor;
+			}
+			cursor++;
+		}
+
+		return -1;
+	};
+
+	if (clusters != nullptr) {
+		clusters->clear();
+	}
+
+	int64_t fanning = skipDeadEnd();
+	bool flushed = true;
+	while (fanning >= 0) {
+
+		if (flushed && clusters != nullptr) {
+			clusters->push_back((uint32_t)(output.size() / 3));
+		}
+
+		candidates.clear();
+		for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+
+			uint32_t t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			emitted[t] = 1;
+
+			for (int c = 0; c < 3; c++) {
+
+				uint32_t v = indices[t * 3 + c];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+
+				if (timeStamp - cacheTime[v] > cacheSize) {
+					cacheTime[v] = timeStamp++;
+				}
+			}
+		}
+
+		// Candidates still in cache after fanning over their live triangles
+		int64_t next = -1;
+		int64_t best = -1;
+		for (uint32_t v : candidates) {
+
+			if (liveCount[v] == 0) {
+				continue;
+			}
+
+			int64_t priority = 0;
+			if (timeStamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize) {
+				priority = timeStamp - cacheTime[v];
+			}
+
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+
+		flushed = next < 0;
+		fanning = flushed ? skipDeadEnd() : next;
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void MeshOptimizer::optimizeOverdraw(
+	uint32_t* indices,
+	size_t indexCount,
+	const float* positions,
+	const std::vector<uint32_t>& clusters) {
+
+	size_t triangleCount = indexCount / 3;
+	if (clusters.size() < 2) {
+		return;
+	}
+
+	auto position = [positions](uint32_t v) {
+		return glm::vec3(positions[(size_t)v * 3], positions[(size_t)v * 3 + 1], positions[(size_t)v * 3 + 2]);
+	};
+
+	// 1 Area weighted centroid and normal of every cluster and of the mesh
+	std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+	glm::vec3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusters.size(); c++) {
+
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		float area = 0.0f;
+
+		for (size_t t = clusters[c]; t < end; t++) {
+
+			glm::vec3 p0 = position(indices[t * 3]);
+			glm::vec3 p1 = position(indices[t * 3 + 1]);
+			glm::vec3 p2 = position(indices[t * 3 + 2]);
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float weight = glm::length(normal);
+
+			centroids[c] += (p0 + p1 + p2) / 3.0f * weight;
+			normals[c] += normal;
+			area += weight;
+		}
+
+		meshCentroid += centroids[c];
+		meshArea += area;
+		if (area > 0.0f) {
+			centroids[c] /= area;
+		}
+	}
+
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+
+	// 2 Clusters facing out of the center first, they occlude the inner ones
+	std::vector<float> metric(clusters.size());
+	std::vector<uint32_t> order(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++) {
+
+		metric[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+		order[c] = (uint32_t)c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&metric](uint32_t a, uint32_t b) {
+		return metric[a] > metric[b];
+	});
+
+	// 3 Copy the clusters in the new order
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (uint32_t c : order) {
+
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		output.insert(output.end(), indices + (size_t)clusters[c] * 3, indices + end * 3);
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void MeshOptimizer::optimizeVertexFetch(uint32_t* indices, size_t indexCount, uint32_t vertexCount, std::vector<uint32_t>& remap) {
+
+	const uint32_t Unused = 0xFFFFFFFF;
+	remap.assign(vertexCount, Unused);
+
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+
+		uint32_t& target = remap[indices[i]];
+		if (target == Unused) {
+			target = next++;
+		}
+		indices[i] = target;
+	}
+
+	for (uint32_t& target : remap) {
+		if (target == Unused) {
+			target = next++;
+		}
+	}
+}
+
+void MeshOptimizer::remapStream(float* stream, int components, const std::vector<uint32_t>& remap) {
+
+	std::vector<float> source(stream, stream + remap.size() * components);
+	for (size_t v = 0; v < remap.size(); v++) {
+
+		std::memcpy(stream + (size_t)remap[v] * components, source.data() + v * components, sizeof(float) * components);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "../core.h"
+#include <cstdint>
+
+// Post-transform cache behaviour of an index buffer under a FIFO cache
+struct VertexCacheStats {
+	float mAcmr{ 0.0f };	// vertex shader runs per triangle, 0.5 is ideal for a closed grid, 3 the worst
+	float mAtvr{ 0.0f };	// vertex shader runs per vertex, 1 is ideal
+};
+
+// Import time triangle and vertex ordering of indexed triangle lists
+class MeshOptimizer {
+public:
+
+	enum Flags : unsigned int {
+		VertexCache = 1,	// Tipsify triangle order
+		Overdraw = 2,		// outward facing clusters first, needs VertexCache
+		VertexFetch = 4		// vertices renumbered in first use order
+	};
+
+	static const unsigned int CacheSize = 16;
+
+	static VertexCacheStats analyze(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, unsigned int cacheSize = CacheSize);
+
+	// Tipsify (Sander, Nehab, Barczak 2007). clusters receives the first triangle of every run
+	// that starts after a cache flush, usable by optimizeOverdraw
+	static void optimizeVertexCache(
+		uint32_t* indices,
+		size_t indexCount,
+		uint32_t vertexCount,
+		unsigned int cacheSize = CacheSize,
+		std::vector<uint32_t>* clusters = nullptr);
+
+	// Clusters sorted by how much they face away from the mesh center, a cheap view independent
+	// front to back order. Triangle order inside a cluster is kept
+	static void optimizeOverdraw(
+		uint32_t* indices,
+		size_t indexCount,
+		const float* positions,
+		const std::vector<uint32_t>& clusters);
+
+	// remap[old] = new in first use order, unreferenced vertices go last
+	static void optimizeVertexFetch(uint32_t* indices, size_t indexCount, uint32_t vertexCount, std::vector<uint32_t>& remap);
+
+	// Move components floats per vertex to their remapped slot
+	static void remapStream(float* stream, int components, const std::vector<uint32_t>& remap);
+};
@@ -0,0 +1,382 @@
+#include "meshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+// Border planes are weighted above the surface so outlines survive longer
+static const double BorderWeight = 10.0;
+
+namespace {
+
+	enum class VertexKind : uint8_t {
+		Manifold,
+		Border,
+		Locked
+	};
+
+	// Symmetric 3x3 A, b and c of x'Ax + 2b'x + c
+	struct Quadric {
+		double a00{ 0 }, a01{ 0 }, a02{ 0 }, a11{ 0 }, a12{ 0 }, a22{ 0 };
+		double b0{ 0 }, b1{ 0 }, b2{ 0 };
+		double c{ 0 };
+
+		static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+
+			Quadric q;
+			q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z;
+			q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z; q.a22 = weight * n.z * n.z;
+			q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+			q.c = weight * d * d;
+			return q;
+		}
+
+		void add(const Quadric& q) {
+
+			a00 += q.a00; a01 += q.a01; a02 += q.a02;
+			a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+		}
+
+		double evaluate(const glm::dvec3& p) const {
+
+			double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+			double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+			double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+			double value = p.x * rx + p.y * ry + p.z * rz + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			return value > 0.0 ? value : 0.0;
+		}
+	};
+
+	struct Collapse {
+		uint32_t mFrom{ 0 };
+		uint32_t mTo{ 0 };
+		double mCost{ 0.0 };
+	};
+
+	struct PositionKey {
+		uint32_t mBits[3];
+		bool operator==(const PositionKey& other) const { return std::memcmp(mBits, other.mBits, sizeof(mBits)) == 0; }
+	};
+
+	struct PositionHash {
+		size_t operator()(const PositionKey& key) const {
+			return (key.mBits[0] * 73856093u) ^ (key.mBits[1] * 19349663u) ^ (key.mBits[2] * 83492791u);
+		}
+	};
+}
+
+float MeshSimplifier::simplify(
+	const VertexStreams& streams,
+	const uint32_t* indices,
+	size_t indexCount,
+	size_t targetIndexCount,
+	float maxError,
+	std::vector<uint32_t>& result) {
+
+	uint32_t vertexCount = streams.mVertexCount;
+	size_t triangleCount = indexCount / 3;
+	result.assign(indices, indices + triangleCount * 3);
+
+	if (triangleCount == 0 || result.size() <= targetIndexCount) {
+		return 0.0f;
+	}
+
+	auto position = [&streams](uint32_t v) {
+		const float* p = streams.mPositions + (size_t)v * 3;
+		return glm::dvec3(p[0], p[1], p[2]);
+	};
+
+	// 1 Vertices sharing a position, the first one stands for all
+	std::vector<uint32_t> wedge(vertexCount);
+	std::vector<uint32_t> wedgeCount(vertexCount, 0);
+	{
+		std::unordered_map<PositionKey, uint32_t, PositionHash> positions;
+		positions.reserve(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++) {
+
+			PositionKey key;
+			std::memcpy(key.mBits, streams.mPositions + (size_t)v * 3, sizeof(key.mBits));
+			wedge[v] = positions.emplace(key, v).first->second;
+			wedgeCount[wedge[v]]++;
+		}
+	}
+
+	// 2 Directed edges between positions, an edge without its twin is on an open border
+	std::unordered_map<uint64_t, uint32_t> edges;
+	edges.reserve(triangleCount * 3);
+	auto edgeKey = [](uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; };
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int c = 0; c < 3; c++) {
+			edges[edgeKey(wedge[result[t * 3 + c]], wedge[result[t * 3 + (c + 1) % 3]])]++;
+		}
+	}
+
+	auto isBorderEdge = [&](uint32_t a, uint32_t b) {
+		return edges.find(edgeKey(wedge[b], wedge[a])) == edges.end();
+	};
+
+	// 3 Vertex kinds, seams and non manifold fans are locked
+	std::vector<VertexKind> kind(vertexCount, VertexKind::Manifold);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		if (wedgeCount[wedge[v]] > 1) {
+			kind[v] = VertexKind::Locked;
+		}
+	}
+
+	for (const auto& edge : edges) {
+
+		uint32_t a = (uint32_t)(edge.first >> 32);
+		uint32_t b = (uint32_t)(edge.first & 0xFFFFFFFF);
+		bool nonManifold = edge.second > 1;
+		bool border = edges.find(edgeKey(b, a)) == edges.end();
+
+		for (uint32_t v : { a, b }) {
+			if (nonManifold) {
+				kind[v] = VertexKind::Locked;
+			}
+			else if (border && kind[v] == VertexKind::Manifold) {
+				kind[v] = VertexKind::Border;
+			}
+		}
+	}
+
+	// 4 Area weighted plane quadrics, plus planes through every border edge
+	std::vector<Quadric> quadrics(vertexCount);
+	glm::dvec3 boundsMin{ std::numeric_limits<double>::max() };
+	glm::dvec3 boundsMax{ -std::numeric_limits<double>::max() };
+
+	for (size_t t = 0; t < triangleCount; t++) {
+
+		uint32_t v[3] = { result[t * 3], result[t * 3 + 1], result[t * 3 + 2] };
+		glm::dvec3 p[3] = { position(v[0]), position(v[1]), position(v[2]) };
+
+		glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+		double area = glm::length(normal);
+		if (area <= 0.0) {
+			continue;
+		}
+		normal /= area;
+
+		Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p[0]), area * 0.5);
+		for (int c = 0; c < 3; c++) {
+
+			quadrics[wedge[v[c]]].add(plane);
+			boundsMin = glm::min(boundsMin, p[c]);
+			boundsMax = glm::max(boundsMax, p[c]);
+
+			uint32_t next = v[(c + 1) % 3];
+			if (isBorderEdge(v[c], next)) {
+
+				glm::dvec3 edge = p[(c + 1) % 3] - p[c];
+				double length = glm::length(edge);
+				if (length <= 0.0) {
+					continue;
+				}
+
+				glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+				Quadric border = Quadric::fromPlane(borderNormal, -glm::dot(borderNormal, p[c]), length * length * BorderWeight);
+				quadrics[wedge[v[c]]].add(border);
+				quadrics[wedge[next]].add(border);
+			}
+		}
+	}
+
+	double attributeScale = glm::length(boundsMax - boundsMin) * AttributeWeight;
+	attributeScale *= attributeScale;
+
+	auto attributeError = [&](uint32_t a, uint32_t b) {
+
+		double error = 0.0;
+		if (streams.mUvs != nullptr) {
+			for (int c = 0; c < 2; c++) {
+				double d = streams.mUvs[(size_t)a * 2 + c] - streams.mUvs[(size_t)b * 2 + c];
+				error += d * d;
+			}
+		}
+		if (streams.mColors != nullptr) {
+			for (int c = 0; c < 3; c++) {
+				double d = streams.mColors[(size_t)a * 3 + c] - streams.mColors[(size_t)b * 3 + c];
+				error += d * d;
+			}
+		}
+		return error * attributeScale;
+	};
+
+	// 5 Triangles around every vertex, kept current as collapses move them
+	std::vector<std::vector<uint32_t>> adjacency(vertexCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int c = 0; c < 3; c++) {
+			adjacency[result[t * 3 + c]].push_back((uint32_t)t);
+		}
+	}
+
+	std::vector<uint8_t> deadTriangle(triangleCount, 0);
+	size_t liveTriangles = triangleCount;
+	size_t targetTriangles = targetIndexCount / 3;
+	double errorLimit = (double)maxError * maxError;
+	double worstError = 0.0;
+
+	auto canCollapse = [&](uint32_t from, uint32_t to) {
+
+		if (kind[from] == VertexKind::Locked) {
+			return false;
+		}
+		if (kind[from] == VertexKind::Border && (kind[to] == VertexKind::Manifold || !(isBorderEdge(from, to) || isBorderEdge(to, from)))) {
+			return false;
+		}
+
+		glm::dvec3 target = position(to);
+		for (uint32_t t : adjacency[from]) {
+
+			if (deadTriangle[t]) {
+				continue;
+			}
+
+			uint32_t* tri = &result[(size_t)t * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to) {
+				continue;
+			}
+
+			// Another wedge of the target would leave a sliver across the seam
+			glm::dvec3 p[3];
+			for (int c = 0; c < 3; c++) {
+
+				if (tri[c] != from && wedge[tri[c]] == wedge[to]) {
+					return false;
+				}
+				p[c] = position(tri[c]);
+			}
+
+			glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			for (int c = 0; c < 3; c++) {
+				if (tri[c] == from) {
+					p[c] = target;
+				}
+			}
+			glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+			// No flipped or collapsed triangles
+			if (glm::dot(before, after) <= 0.0) {
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	// 6 Passes of the cheapest independent collapses
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> touched(vertexCount, 0);
+	std::vector<uint8_t> removed(vertexCount, 0);
+
+	while (liveTriangles > targetTriangles) {
+
+		// 6.1 Cheaper direction of every live edge
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; t++) {
+
+			if (deadTriangle[t]) {
+				continue;
+			}
+
+			for (int c = 0; c < 3; c++) {
+
+				uint32_t a = result[t * 3 + c];
+				uint32_t b = result[t * 3 + (c + 1) % 3];
+				if (a > b && !isBorderEdge(a, b)) {
+					continue; // the twin half edge adds it
+				}
+
+				Quadric q = quadrics[wedge[a]];
+				q.add(quadrics[wedge[b]]);
+				double attribute = attributeError(a, b);
+
+				Collapse ab{ a, b, q.evaluate(position(b)) + attribute };
+				Collapse ba{ b, a, q.evaluate(position(a)) + attribute };
+				bool abValid = kind[a] != VertexKind::Locked;
+				bool baValid = kind[b] != VertexKind::Locked;
+
+				if (abValid && (!baValid || ab.mCost <= ba.mCost)) {
+					collapses.push_back(ab);
+				}
+				else if (baValid) {
+					collapses.push_back(ba);
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) {
+			return l.mCost < r.mCost;
+		});
+
+		// 6.2 Apply in cost order, a vertex takes part in one collapse per pass
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t applied = 0;
+
+		for (const Collapse& collapse : collapses) {
+
+			if (liveTriangles <= targetTriangles || collapse.mCost > errorLimit) {
+				break;
+			}
+
+			uint32_t from = collapse.mFrom;
+			uint32_t to = collapse.mTo;
+			if (touched[from] || touched[to] || removed[from] || removed[to] || !canCollapse(from, to)) {
+				continue;
+			}
+
+			for (uint32_t t : adjacency[from]) {
+
+				if (deadTriangle[t]) {
+					continue;
+				}
+
+				uint32_t* tri = &result[(size_t)t * 3];
+				if (tri[0] == to || tri[1] == to || tri[2] == to) {
+					deadTriangle[t] = 1;
+					liveTriangles--;
+					continue;
+				}
+
+				for (int c = 0; c < 3; c++) {
+					if (tri[c] == from) {
+						tri[c] = to;
+					}
+				}
+				adjacency[to].push_back(t);
+			}
+			adjacency[from].clear();
+
+			quadrics[wedge[to]].add(quadrics[wedge[from]]);
+			removed[from] = 1;
+			touched[from] = 1;
+			touched[to] = 1;
+
+			worstError = std::max(worstError, collapse.mCost);
+			applied++;
+		}
+
+		if (applied == 0) {
+			break;
+		}
+	}
+
+	// 7 Live triangles only
+	size_t write = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+
+		if (deadTriangle[t]) {
+			continue;
+		}
+		for (int c = 0; c < 3; c++) {
+			result[write++] = result[t * 3 + c];
+		}
+	}
+	result.resize(write);
+
+	return (float)std::sqrt(worstError);
+}
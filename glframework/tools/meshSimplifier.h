@@ -0,0 +1,26 @@
+#pragma once
+#include "../core.h"
+#include "../vertexLayout.h"
+#include <cstdint>
+
+// Quadric error edge collapse (Garland, Heckbert 1997). Collapses are half edge collapses onto
+// an existing vertex, so uvs, normals and colors are kept exactly instead of interpolated.
+// Vertices sharing a position with different attributes (uv or color seams) are locked, open
+// borders only collapse along themselves
+class MeshSimplifier {
+public:
+
+	// Attribute differences count as distance, relative to the mesh extent
+	static constexpr float AttributeWeight = 0.05f;
+
+	// Collapse until at most targetIndexCount indices remain or the next collapse would exceed
+	// maxError (mesh units). result indexes the input vertices.
+	// Returns the error of the worst collapse taken, in mesh units
+	static float simplify(
+		const VertexStreams& streams,
+		const uint32_t* indices,
+		size_t indexCount,
+		size_t targetIndexCount,
+		float maxError,
+		std::vector<uint32_t>& result);
+};
@@ -0,0 +1,191 @@
+#include "mipmapGenerator.h"
+#include <algorithm>
+#include <cmath>
+
+// Kaiser window shape, larger is smoother with less ringing
+static const double KaiserAlpha = 4.0;
+static const int KaiserTaps = 6;
+
+namespace {
+
+	// Zeroth order modified Bessel function of the first kind
+	double besselI0(double x) {
+
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32; k++) {
+
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Weights of the source texels 2x - 2 .. 2x + 3 for target texel x, normalized
+	struct KaiserKernel {
+		float mWeights[KaiserTaps];
+
+		KaiserKernel() {
+
+			const double pi = 3.14159265358979323846;
+			double radius = KaiserTaps / 2.0;
+			double sum = 0.0;
+			for (int i = 0; i < KaiserTaps; i++) {
+
+				// Distance of the source texel center from the target center, in source texels
+				double d = i - KaiserTaps / 2 + 0.5;
+				double x = d / 2.0;
+				double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+				double t = d / radius;
+				double window = besselI0(KaiserAlpha * std::sqrt(std::max(0.0, 1.0 - t * t))) / besselI0(KaiserAlpha);
+
+				mWeights[i] = (float)(sinc * window);
+				sum += mWeights[i];
+			}
+
+			for (float& weight : mWeights) {
+				weight = (float)(weight / sum);
+			}
+		}
+	};
+
+	int wrap(int i, int size) {
+
+		i %= size;
+		return i < 0 ? i + size : i;
+	}
+}
+
+int MipmapGenerator::getLevelCount(int width, int height) {
+
+	int levels = 1;
+	int size = std::max(width, height);
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+void MipmapGenerator::generate(const unsigned char* texels, int width, int height, MipmapFilter filter, std::vector<MipLevel>& levels) {
+
+	levels.clear();
+	levels.resize(getLevelCount(width, height) - 1);
+
+	const unsigned char* source = texels;
+	for (auto& level : levels) {
+
+		if (filter == MipmapFilter::Kaiser) {
+			downsampleKaiser(source, width, height, level);
+		}
+		else {
+			downsampleBox(source, width, height, level);
+		}
+
+		source = level.mTexels.data();
+		width = level.mWidth;
+		height = level.mHeight;
+	}
+}
+
+void MipmapGenerator::downsampleBox(const unsigned char* source, int width, int height, MipLevel& level) {
+
+	level.mWidth = std::max(width / 2, 1);
+	level.mHeight = std::max(height / 2, 1);
+	level.mTexels.resize((size_t)level.mWidth * level.mHeight * 4);
+
+	// A 1 texel axis is not halved
+	int stepX = width > 1 ? 1 : 0;
+	int stepY = height > 1 ? 1 : 0;
+
+	for (int y = 0; y < level.mHeight; y++) {
+
+		const unsigned char* row0 = source + (size_t)(y * 2) * width * 4;
+		const unsigned char* row1 = source + (size_t)(y * 2 + stepY) * width * 4;
+		unsigned char* target = level.mTexels.data() + (size_t)y * level.mWidth * 4;
+
+		for (int x = 0; x < level.mWidth; x++) {
+
+			int x0 = x * 2 * 4;
+			int x1 = (x * 2 + stepX) * 4;
+			for (int c = 0; c < 4; c++) {
+				target[x * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+}
+
+void MipmapGenerator::downsampleKaiser(const unsigned char* source, int width, int height, MipLevel& level) {
+
+	static const KaiserKernel kernel;
+
+	level.mWidth = std::max(width / 2, 1);
+	level.mHeight = std::max(height / 2, 1);
+	level.mTexels.resize((size_t)level.mWidth * level.mHeight * 4);
+
+	// 1 Horizontal pass into floats, a 1 texel axis is copied
+	std::vector<int> columns((size_t)level.mWidth * KaiserTaps);
+	for (int x = 0; x < level.mWidth; x++) {
+		for (int i = 0; i < KaiserTaps; i++) {
+			columns[x * KaiserTaps + i] = wrap(x * 2 - KaiserTaps / 2 + 1 + i, width) * 4;
+		}
+	}
+
+	std::vector<float> rows((size_t)level.mWidth * height * 4);
+	for (int y = 0; y < height; y++) {
+
+		const unsigned char* row = source + (size_t)y * width * 4;
+		float* target = rows.data() + (size_t)y * level.mWidth * 4;
+
+		for (int x = 0; x < level.mWidth; x++) {
+
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			if (width == 1) {
+				for (int c = 0; c < 4; c++) {
+					sum[c] = row[c];
+				}
+			}
+			else {
+				for (int i = 0; i < KaiserTaps; i++) {
+
+					const unsigned char* texel = row + columns[x * KaiserTaps + i];
+					for (int c = 0; c < 4; c++) {
+						sum[c] += kernel.mWeights[i] * texel[c];
+					}
+				}
+			}
+
+			for (int c = 0; c < 4; c++) {
+				target[x * 4 + c] = sum[c];
+			}
+		}
+	}
+
+	// 2 Vertical pass, negative lobes can overshoot
+	size_t stride = (size_t)level.mWidth * 4;
+	std::vector<float> sums(stride);
+	for (int y = 0; y < level.mHeight; y++) {
+
+		// Whole rows at a time, the inner loop runs over contiguous floats
+		if (height == 1) {
+			std::copy(rows.begin(), rows.begin() + stride, sums.begin());
+		}
+		else {
+
+			std::fill(sums.begin(), sums.end(), 0.0f);
+			for (int t = 0; t < KaiserTaps; t++) {
+
+				const float* row = rows.data() + wrap(y * 2 - KaiserTaps / 2 + 1 + t, height) * stride;
+				float weight = kernel.mWeights[t];
+				for (size_t i = 0; i < stride; i++) {
+					sums[i] += weight * row[i];
+				}
+			}
+		}
+
+		unsigned char* target = level.mTexels.data() + y * stride;
+		for (size_t i = 0; i < stride; i++) {
+			target[i] = (unsigned char)glm::clamp(sums[i] + 0.5f, 0.0f, 255.0f);
+		}
+	}
+}
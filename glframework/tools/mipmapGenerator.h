@@ -0,0 +1,27 @@
+#pragma once
+#include "../core.h"
+
+enum class MipmapFilter {
+	Box,	// 2x2 average
+	Kaiser	// 6 tap Kaiser windowed sinc, sharper distant levels
+};
+
+struct MipLevel {
+	int mWidth{ 0 };
+	int mHeight{ 0 };
+	std::vector<unsigned char> mTexels{};	// RGBA8
+};
+
+// Offline mip chain of RGBA8 images, every level filtered from the one above it.
+// Edges wrap, like the GL_REPEAT textures the chains are built for
+class MipmapGenerator {
+public:
+	// Levels of a full chain down to 1x1, the base level included
+	static int getLevelCount(int width, int height);
+
+	// Every level below the base, largest first
+	static void generate(const unsigned char* texels, int width, int height, MipmapFilter filter, std::vector<MipLevel>& levels);
+
+	static void downsampleBox(const unsigned char* source, int width, int height, MipLevel& level);
+	static void downsampleKaiser(const unsigned char* source, int width, int height, MipLevel& level);
+};
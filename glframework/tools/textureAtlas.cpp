@@ -0,0 +1,150 @@
+#include "textureAtlas.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+TextureAtlas::TextureAtlas(int maxSize, int padding) :mMaxSize(maxSize), mPadding(padding) {}
+
+TextureAtlas::~TextureAtlas() {}
+
+int TextureAtlas::add(int width, int height) {
+
+	AtlasRect rect;
+	rect.mWidth = width;
+	rect.mHeight = height;
+	mRects.push_back(rect);
+	return (int)mRects.size() - 1;
+}
+
+bool TextureAtlas::pack() {
+
+	// 1 Start at the padded area, a square first and then twice as wide
+	size_t area = 0;
+	for (const auto& rect : mRects) {
+		area += (size_t)(rect.mWidth + 2 * mPadding) * (rect.mHeight + 2 * mPadding);
+	}
+
+	int size = 1;
+	while ((size_t)size * size < area && size < mMaxSize) {
+		size *= 2;
+	}
+
+	// 2 Grow until everything fits
+	for (; size <= mMaxSize; size *= 2) {
+
+		if (place(size, size)) {
+			return true;
+		}
+		if (size * 2 <= mMaxSize && place(size * 2, size)) {
+			return true;
+		}
+	}
+
+	mWidth = mHeight = 0;
+	return false;
+}
+
+bool TextureAtlas::place(int width, int height) {
+
+	struct Segment {
+		int mX, mY, mWidth;
+	};
+	std::vector<Segment> skyline{ { 0, 0, width } };
+
+	// Tallest first leaves the flattest skyline
+	std::vector<int> order(mRects.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return mRects[a].mHeight > mRects[b].mHeight; });
+
+	for (int id : order) {
+
+		int w = mRects[id].mWidth + 2 * mPadding;
+		int h = mRects[id].mHeight + 2 * mPadding;
+
+		// 1 Lowest, then leftmost position starting at a segment
+		int bestY = height, bestX = 0;
+		size_t bestSegment = skyline.size();
+		for (size_t i = 0; i < skyline.size(); i++) {
+
+			int x = skyline[i].mX;
+			if (x + w > width) {
+				break;
+			}
+
+			int y = 0;
+			for (size_t j = i; j < skyline.size() && skyline[j].mX < x + w; j++) {
+				y = std::max(y, skyline[j].mY);
+			}
+
+			if (y + h <= height && y < bestY) {
+				bestY = y;
+				bestX = x;
+				bestSegment = i;
+			}
+		}
+
+		if (bestSegment == skyline.size()) {
+			return false;
+		}
+
+		mRects[id].mX = bestX + mPadding;
+		mRects[id].mY = bestY + mPadding;
+
+		// 2 The new top replaces the segments it covers, a partly covered one keeps its right side
+		Segment top{ bestX, bestY + h, w };
+		size_t end = bestSegment;
+		while (end < skyline.size() && skyline[end].mX + skyline[end].mWidth <= bestX + w) {
+			end++;
+		}
+		if (end < skyline.size() && skyline[end].mX < bestX + w) {
+
+			int right = skyline[end].mX + skyline[end].mWidth;
+			skyline[end].mX = bestX + w;
+			skyline[end].mWidth = right - skyline[end].mX;
+		}
+		skyline.erase(skyline.begin() + bestSegment, skyline.begin() + end);
+		skyline.insert(skyline.begin() + bestSegment, top);
+
+		// 3 Neighbours at the same height merge
+		for (size_t i = 1; i < skyline.size();) {
+
+			if (skyline[i].mY == skyline[i - 1].mY) {
+				skyline[i - 1].mWidth += skyline[i].mWidth;
+				skyline.erase(skyline.begin() + i);
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	mWidth = width;
+	mHeight = height;
+	return true;
+}
+
+glm::vec4 TextureAtlas::getUvTransform(const AtlasRect& rect, int width, int height) {
+
+	return glm::vec4(
+		(float)rect.mWidth / width,
+		(float)rect.mHeight / height,
+		(float)rect.mX / width,
+		(float)rect.mY / height);
+}
+
+void TextureAtlas::blit(const AtlasRect& rect, int padding, const unsigned char* texels, int atlasWidth, std::vector<unsigned char>& atlas) {
+
+	// Every padded row reads the clamped source row, its ends repeat the edge texels
+	for (int y = -padding; y < rect.mHeight + padding; y++) {
+
+		int sy = glm::clamp(y, 0, rect.mHeight - 1);
+		const unsigned char* source = texels + (size_t)sy * rect.mWidth * 4;
+		unsigned char* target = atlas.data() + ((size_t)(rect.mY + y) * atlasWidth + rect.mX) * 4;
+
+		std::memcpy(target, source, (size_t)rect.mWidth * 4);
+		for (int x = 1; x <= padding; x++) {
+			std::memcpy(target - x * 4, source, 4);
+			std::memcpy(target + (rect.mWidth - 1 + x) * 4, source + (rect.mWidth - 1) * 4, 4);
+		}
+	}
+}
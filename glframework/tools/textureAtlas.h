@@ -0,0 +1,48 @@
+#pragma once
+#include "../core.h"
+#include <cstdint>
+
+// Texels of one packed image inside the atlas, its padding lies outside
+struct AtlasRect {
+	int32_t mX{ 0 };
+	int32_t mY{ 0 };
+	int32_t mWidth{ 0 };	// 0 when the image is not in the atlas
+	int32_t mHeight{ 0 };
+};
+
+// Packs images of any size into one texture, skyline bottom left placement of the images
+// sorted by height. Every image is framed by padding texels that repeat its edge, so bilinear
+// taps and the first mip levels do not bleed between neighbours
+class TextureAtlas {
+public:
+	TextureAtlas(int maxSize = 4096, int padding = 4);
+	~TextureAtlas();
+
+	// Id of the image, in add order
+	int add(int width, int height);
+
+	// Smallest power of two atlas holding every image, false when it would exceed maxSize
+	bool pack();
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+	const AtlasRect& getRect(int id) const { return mRects[id]; }
+
+	// uv * xy + zw maps the unit square of an image to its rect
+	static glm::vec4 getUvTransform(const AtlasRect& rect, int width, int height);
+
+	// Copy RGBA8 texels into the rect and extrude the edges over padding texels around it,
+	// atlas holds rows of atlasWidth texels
+	static void blit(const AtlasRect& rect, int padding, const unsigned char* texels, int atlasWidth, std::vector<unsigned char>& atlas);
+
+private:
+	// Skyline placement of every image in a width x height atlas
+	bool place(int width, int height);
+
+private:
+	int mMaxSize{ 4096 };
+	int mPadding{ 4 };
+	int mWidth{ 0 };
+	int mHeight{ 0 };
+	std::vector<AtlasRect> mRects{};
+};
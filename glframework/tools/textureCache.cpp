@@ -0,0 +1,237 @@
+#include "textureCache.h"
+#include "mappedFile.h"
+#include "../../application/stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+static const char TextureCacheMagic[8] = { 'G', 'R', 'T', 'C', 'A', 'C', 'H', 'E' };
+
+static uint32_t encodeMipmaps(bool mipmaps, MipmapFilter filter) {
+
+	return mipmaps ? 1u + (uint32_t)filter : 0u;
+}
+
+uint64_t TextureCache::hashFile(const std::string& path, bool& found) {
+
+	uint64_t hash = 14695981039346656037ull;
+
+	MappedFile source;
+	found = source.open(path);
+	if (!found) {
+		return hash;
+	}
+
+	const uint8_t* data = source.getData();
+	size_t size = source.getSize();
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool TextureCache::read(
+	const std::string& cachePath,
+	uint64_t sourceHash,
+	TextureFormat format,
+	bool mipmaps,
+	MipmapFilter filter,
+	std::vector<CompressedLevel>& levels) {
+
+	MappedFile file;
+	if (!file.open(cachePath) || file.getSize() < sizeof(TextureCacheHeader)) {
+		return false;
+	}
+
+	const uint8_t* data = file.getData();
+	size_t size = file.getSize();
+
+	// 1 Same format, source and chain
+	const TextureCacheHeader* header = reinterpret_cast<const TextureCacheHeader*>(data);
+	if (std::memcmp(header->mMagic, TextureCacheMagic, sizeof(TextureCacheMagic)) != 0 ||
+		header->mVersion != TextureCacheVersion ||
+		header->mFormat != (uint32_t)format ||
+		header->mMipmaps != encodeMipmaps(mipmaps, filter) ||
+		header->mSourceHash != sourceHash ||
+		header->mFileSize != size ||
+		header->mLevelCount == 0 ||
+		header->mLevelCount > (size - sizeof(TextureCacheHeader)) / sizeof(CachedTextureLevel)) {
+		return false;
+	}
+
+	// 2 Every level inside the file and as large as its blocks, a truncated write fails here
+	const CachedTextureLevel* table = reinterpret_cast<const CachedTextureLevel*>(data + sizeof(TextureCacheHeader));
+	for (uint32_t i = 0; i < header->mLevelCount; i++) {
+
+		const CachedTextureLevel& level = table[i];
+		if (level.mWidth <= 0 || level.mHeight <= 0 ||
+			level.mSize != BlockCompressor::getSize(format, level.mWidth, level.mHeight) ||
+			level.mOffset > size || level.mSize > size - level.mOffset) {
+			return false;
+		}
+	}
+
+	// 3 Copied out, the mapping closes with this call
+	levels.resize(header->mLevelCount);
+	for (uint32_t i = 0; i < header->mLevelCount; i++) {
+
+		levels[i].mWidth = table[i].mWidth;
+		levels[i].mHeight = table[i].mHeight;
+		levels[i].mBlocks.assign(data + table[i].mOffset, data + table[i].mOffset + table[i].mSize);
+	}
+
+	return true;
+}
+
+bool TextureCache::write(
+	const std::string& cachePath,
+	uint64_t sourceHash,
+	TextureFormat format,
+	bool mipmaps,
+	MipmapFilter filter,
+	const std::vector<CompressedLevel>& levels) {
+
+	if (levels.empty()) {
+		return false;
+	}
+
+	// 1 Header and level table, blocks follow in level order
+	TextureCacheHeader header;
+	std::memcpy(header.mMagic, TextureCacheMagic, sizeof(TextureCacheMagic));
+	header.mVersion = TextureCacheVersion;
+	header.mFormat = (uint32_t)format;
+	header.mMipmaps = encodeMipmaps(mipmaps, filter);
+	header.mLevelCount = (uint32_t)levels.size();
+	header.mSourceHash = sourceHash;
+	header.mWidth = levels[0].mWidth;
+	header.mHeight = levels[0].mHeight;
+
+	std::vector<CachedTextureLevel> table(levels.size());
+	uint64_t offset = sizeof(TextureCacheHeader) + table.size() * sizeof(CachedTextureLevel);
+	for (size_t i = 0; i < levels.size(); i++) {
+
+		table[i].mWidth = levels[i].mWidth;
+		table[i].mHeight = levels[i].mHeight;
+		table[i].mOffset = offset;
+		table[i].mSize = levels[i].mBlocks.size();
+		offset += table[i].mSize;
+	}
+	header.mFileSize = offset;
+
+	// 2 A read only folder only costs the next encode
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), (std::streamsize)(table.size() * sizeof(CachedTextureLevel)));
+	for (const auto& level : levels) {
+		file.write(reinterpret_cast<const char*>(level.mBlocks.data()), (std::streamsize)level.mBlocks.size());
+	}
+
+	if (!file.good()) {
+		std::cout << "Warning: Texture cache " << cachePath << " could not be written" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void TextureCache::encode(
+	const unsigned char* texels,
+	int width,
+	int height,
+	TextureFormat format,
+	bool mipmaps,
+	MipmapFilter filter,
+	std::vector<CompressedLevel>& levels) {
+
+	// 1 Filter in RGBA8, compression error must not feed the next level
+	std::vector<MipLevel> chain;
+	if (mipmaps) {
+		MipmapGenerator::generate(texels, width, height, filter, chain);
+	}
+
+	// 2 Compress every level
+	levels.resize(chain.size() + 1);
+	for (size_t i = 0; i < levels.size(); i++) {
+
+		const unsigned char* source = i == 0 ? texels : chain[i - 1].mTexels.data();
+		levels[i].mWidth = i == 0 ? width : chain[i - 1].mWidth;
+		levels[i].mHeight = i == 0 ? height : chain[i - 1].mHeight;
+		BlockCompressor::compress(source, levels[i].mWidth, levels[i].mHeight, format, levels[i].mBlocks);
+	}
+}
+
+bool TextureCache::load(
+	const std::string& path,
+	TextureFormat format,
+	bool mipmaps,
+	MipmapFilter filter,
+	std::vector<CompressedLevel>& levels) {
+
+	bool found = false;
+	uint64_t sourceHash = hashFile(path, found);
+	if (!found) {
+		return false;
+	}
+
+	bool cached = format != TextureFormat::Rgba8;
+	if (cached && read(getCachePath(path), sourceHash, format, mipmaps, filter, levels)) {
+		return true;
+	}
+
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* texels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (texels == nullptr) {
+		return false;
+	}
+
+	encode(texels, width, height, format, mipmaps, filter, levels);
+	stbi_image_free(texels);
+
+	if (cached) {
+		write(getCachePath(path), sourceHash, format, mipmaps, filter, levels);
+	}
+	return true;
+}
+
+bool TextureCache::transcode(const std::string& path, TextureFormat format, bool mipmaps, MipmapFilter filter) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	bool found = false;
+	uint64_t sourceHash = hashFile(path, found);
+
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* texels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!found || texels == nullptr) {
+
+		std::cout << "Error: Texture failed to load at path - " << path << std::endl;
+		return false;
+	}
+
+	std::vector<CompressedLevel> levels;
+	encode(texels, width, height, format, mipmaps, filter, levels);
+	stbi_image_free(texels);
+
+	std::string cachePath = getCachePath(path);
+	if (!write(cachePath, sourceHash, format, mipmaps, filter, levels)) {
+		return false;
+	}
+
+	// 1 Sizes against the RGBA8 chain the cache replaces
+	size_t compressed = 0, rgba = 0;
+	for (const auto& level : levels) {
+		compressed += level.mBlocks.size();
+		rgba += BlockCompressor::getSize(TextureFormat::Rgba8, level.mWidth, level.mHeight);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "TextureCache " << cachePath << ": " << width << "x" << height << ", " << levels.size() << " levels, "
+		<< compressed / 1024 << " KB (RGBA8 " << rgba / 1024 << " KB) in "
+		<< std::chrono::duration<float, std::milli>(end - start).count() << " ms" << std::endl;
+
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "../core.h"
+#include "blockCompressor.h"
+#include "mipmapGenerator.h"
+
+#include <cstdint>
+#include <string>
+
+// Block compressed mip chain of an image, written next to the source as <source>.texcache:
+//   header | level table | blocks of every level, largest first
+static const uint32_t TextureCacheVersion = 1;
+
+struct TextureCacheHeader {
+	char mMagic[8]{};
+	uint32_t mVersion{ 0 };
+	uint32_t mFormat{ 0 };			// TextureFormat
+	uint32_t mMipmaps{ 0 };			// 0 base level only, else 1 + MipmapFilter
+	uint32_t mLevelCount{ 0 };
+	uint64_t mSourceHash{ 0 };
+	uint64_t mFileSize{ 0 };
+	int32_t mWidth{ 0 };
+	int32_t mHeight{ 0 };
+};
+
+struct CachedTextureLevel {
+	int32_t mWidth{ 0 };
+	int32_t mHeight{ 0 };
+	uint64_t mOffset{ 0 };			// bytes from the file start
+	uint64_t mSize{ 0 };
+};
+
+static_assert(sizeof(TextureCacheHeader) == 48, "TextureCacheHeader layout");
+static_assert(sizeof(CachedTextureLevel) == 24, "CachedTextureLevel layout");
+
+struct CompressedLevel {
+	int mWidth{ 0 };
+	int mHeight{ 0 };
+	std::vector<uint8_t> mBlocks{};
+};
+
+class TextureCache {
+public:
+	static std::string getCachePath(const std::string& path) { return path + ".texcache"; }
+
+	// FNV-1a 64 over the source bytes
+	static uint64_t hashFile(const std::string& path, bool& found);
+
+	// The chain stored for this exact source, format and filter, false when it has to be encoded again
+	static bool read(
+		const std::string& cachePath,
+		uint64_t sourceHash,
+		TextureFormat format,
+		bool mipmaps,
+		MipmapFilter filter,
+		std::vector<CompressedLevel>& levels);
+
+	static bool write(
+		const std::string& cachePath,
+		uint64_t sourceHash,
+		TextureFormat format,
+		bool mipmaps,
+		MipmapFilter filter,
+		const std::vector<CompressedLevel>& levels);
+
+	// Filter the mip chain of an RGBA8 image and compress every level, base first.
+	// Rgba8 levels keep their texels
+	static void encode(
+		const unsigned char* texels,
+		int width,
+		int height,
+		TextureFormat format,
+		bool mipmaps,
+		MipmapFilter filter,
+		std::vector<CompressedLevel>& levels);
+
+	// Chain of path from its cache, or decoded, encoded and cached. Rgba8 chains are never cached.
+	// Rows are flipped like the loader flips them, false when path cannot be decoded
+	static bool load(
+		const std::string& path,
+		TextureFormat format,
+		bool mipmaps,
+		MipmapFilter filter,
+		std::vector<CompressedLevel>& levels);
+
+	// Offline transcoder: decode path, encode its chain and write the cache the loader reads.
+	// Rows are flipped like the loader flips them
+	static bool transcode(const std::string& path, TextureFormat format, bool mipmaps, MipmapFilter filter);
+};
@@ -0,0 +1,259 @@
+#include "transformSystem.h"
+#include <chrono>
+
+TransformSystem::TransformSystem() {}
+
+TransformSystem::~TransformSystem() {}
+
+TransformSystem& TransformSystem::getDefault() {
+
+	static TransformSystem system;
+	return system;
+}
+
+TransformSystem::Handle TransformSystem::create() {
+
+	Handle handle;
+	if (!mFreeHandles.empty()) {
+
+		// Released nodes stay in the arrays, the cached local matrix is still the old node's
+		handle = mFreeHandles.back();
+		mFreeHandles.pop_back();
+
+		uint32_t index = mIndices[handle];
+		mPositions[index] = glm::vec3(0.0f);
+		mAngles[index] = glm::vec3(0.0f);
+		mScales[index] = glm::vec3(1.0f);
+		mParents[index] = -1;
+		mLocalMatrices[index] = glm::mat4(1.0f);
+		mLocalDirty[index] = 0;
+		markDirty(index);
+		return handle;
+	}
+
+	handle = (Handle)mIndices.size();
+	mIndices.push_back((uint32_t)mPositions.size());
+
+	mPositions.push_back(glm::vec3(0.0f));
+	mAngles.push_back(glm::vec3(0.0f));
+	mScales.push_back(glm::vec3(1.0f));
+	mParents.push_back(-1);
+	mLocalMatrices.push_back(glm::mat4(1.0f));
+	mWorldMatrices.push_back(glm::mat4(1.0f));
+	mLocalDirty.push_back(0);
+	mWorldDirty.push_back(0);
+	mChanged.push_back(0);
+	mHandles.push_back(handle);
+
+	return handle;
+}
+
+void TransformSystem::release(Handle handle) {
+
+	uint32_t index = mIndices[handle];
+	mParents[index] = -1;
+	mFreeHandles.push_back(handle);
+}
+
+void TransformSystem::setParent(Handle child, Handle parent) {
+
+	uint32_t childIndex = mIndices[child];
+	int32_t parentIndex = parent == InvalidHandle ? -1 : (int32_t)mIndices[parent];
+
+	mParents[childIndex] = parentIndex;
+	if (parentIndex > (int32_t)childIndex) {
+		mOrderDirty = true;
+	}
+
+	markDirty(childIndex);
+}
+
+void TransformSystem::setPosition(Handle handle, const glm::vec3& position) {
+
+	uint32_t index = mIndices[handle];
+	mPositions[index] = position;
+	mLocalDirty[index] = 1;
+	markDirty(index);
+}
+
+void TransformSystem::setAngles(Handle handle, const glm::vec3& angles) {
+
+	uint32_t index = mIndices[handle];
+	mAngles[index] = angles;
+	mLocalDirty[index] = 1;
+	markDirty(index);
+}
+
+void TransformSystem::setScale(Handle handle, const glm::vec3& scale) {
+
+	uint32_t index = mIndices[handle];
+	mScales[index] = scale;
+	mLocalDirty[index] = 1;
+	markDirty(index);
+}
+
+void TransformSystem::markDirty(uint32_t index) {
+
+	if (!mWorldDirty[index]) {
+		mWorldDirty[index] = 1;
+		mPendingEdits++;
+	}
+}
+
+void TransformSystem::buildLocalMatrix(uint32_t index) {
+
+	// 1 Scale (local coordinate)
+	glm::mat4 transform{ 1.0f };
+
+	// 2 Rotate (local coordinate)
+	transform = glm::scale(transform, mScales[index]);
+
+	transform = glm::rotate(transform, glm::radians(mAngles[index].x), glm::vec3(1.0f, 0.0f, 0.0f));
+
+	transform = glm::rotate(transform, glm::radians(mAngles[index].y), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	transform = glm::rotate(transform, glm::radians(mAngles[index].z), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	// 3 Translate (parent coordinate)
+	mLocalMatrices[index] = glm::translate(glm::mat4(1.0f), mPositions[index]) * transform;
+	mLocalDirty[index] = 0;
+}
+
+void TransformSystem::resolve(uint32_t index) {
+
+	int32_t parent = mParents[index];
+	if (parent >= 0) {
+		resolve((uint32_t)parent);
+	}
+
+	if (mLocalDirty[index]) {
+		buildLocalMatrix(index);
+	}
+
+	// World dirty flags stay set, update() still has to reach the children
+	mWorldMatrices[index] = parent >= 0 ? mWorldMatrices[parent] * mLocalMatrices[index] : mLocalMatrices[index];
+}
+
+const glm::mat4& TransformSystem::getWorldMatrix(Handle handle) {
+
+	uint32_t index = mIndices[handle];
+	if (mPendingEdits > 0) {
+		resolve(index);
+	}
+
+	return mWorldMatrices[index];
+}
+
+void TransformSystem::update() {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (mOrderDirty) {
+		reorder();
+	}
+
+	mStats.mNodeCount = (unsigned int)mPositions.size();
+	mStats.mUpdatedNodes = 0;
+
+	if (mPendingEdits > 0) {
+
+		// One forward pass, a parent is final before any of its children is read
+		size_t count = mPositions.size();
+		for (size_t i = 0; i < count; i++) {
+
+			int32_t parent = mParents[i];
+			bool changed = mWorldDirty[i] || (parent >= 0 && mChanged[parent]);
+			mChanged[i] = changed;
+
+			if (!changed) {
+				continue;
+			}
+
+			if (mLocalDirty[i]) {
+				buildLocalMatrix((uint32_t)i);
+			}
+
+			mWorldMatrices[i] = parent >= 0 ? mWorldMatrices[parent] * mLocalMatrices[i] : mLocalMatrices[i];
+			mWorldDirty[i] = 0;
+			mStats.mUpdatedNodes++;
+		}
+
+		mPendingEdits = 0;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.mUpdateTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void TransformSystem::reorder() {
+
+	size_t count = mPositions.size();
+
+	// 1 Depth of every node
+	std::vector<int32_t> depths(count, -1);
+	int32_t maxDepth = 0;
+	for (size_t i = 0; i < count; i++) {
+
+		int32_t depth = 0;
+		int32_t node = mParents[i];
+		while (node >= 0 && depths[node] < 0) {
+			depth++;
+			node = mParents[node];
+		}
+		depth += node >= 0 ? depths[node] + 1 : 0;
+
+		// Fill the walked chain on the way down
+		int32_t value = depth;
+		node = (int32_t)i;
+		while (node >= 0 && depths[node] < 0) {
+			depths[node] = value--;
+			node = mParents[node];
+		}
+
+		maxDepth = std::max(maxDepth, depth);
+	}
+
+	// 2 Counting sort by depth, stable inside one level
+	std::vector<uint32_t> offsets(maxDepth + 2, 0);
+	for (size_t i = 0; i < count; i++) {
+		offsets[depths[i] + 1]++;
+	}
+	for (size_t i = 1; i < offsets.size(); i++) {
+		offsets[i] += offsets[i - 1];
+	}
+
+	std::vector<uint32_t> newIndices(count);
+	for (size_t i = 0; i < count; i++) {
+		newIndices[i] = offsets[depths[i]]++;
+	}
+
+	// 3 Move every array
+	auto permute = [&](auto& values) {
+
+		auto sorted = values;
+		for (size_t i = 0; i < count; i++) {
+			sorted[newIndices[i]] = values[i];
+		}
+		values.swap(sorted);
+	};
+
+	permute(mPositions);
+	permute(mAngles);
+	permute(mScales);
+	permute(mParents);
+	permute(mLocalMatrices);
+	permute(mWorldMatrices);
+	permute(mLocalDirty);
+	permute(mWorldDirty);
+	permute(mHandles);
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (mParents[i] >= 0) {
+			mParents[i] = (int32_t)newIndices[mParents[i]];
+		}
+		mIndices[mHandles[i]] = (uint32_t)i;
+	}
+
+	mOrderDirty = false;
+}
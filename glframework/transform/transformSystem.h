@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../core.h"
+#include <cstdint>
+
+struct TransformStats {
+	unsigned int mNodeCount{ 0 };
+	unsigned int mUpdatedNodes{ 0 };	// world matrices rebuilt by the last update
+	float mUpdateTime{ 0.0f };			// ms
+};
+
+// Local TRS, local and world matrices of every scene node in flat arrays.
+// Parents are stored before their children, so update() is a single forward pass.
+// Handles stay valid when nodes are reordered
+class TransformSystem {
+
+public:
+	using Handle = uint32_t;
+	static constexpr Handle InvalidHandle = 0xFFFFFFFF;
+
+	TransformSystem();
+	~TransformSystem();
+
+	// Shared by every Object
+	static TransformSystem& getDefault();
+
+	Handle create();
+
+	// Children of the node have to be detached first
+	void release(Handle handle);
+
+	void setParent(Handle child, Handle parent);
+
+	void setPosition(Handle handle, const glm::vec3& position);
+	void setAngles(Handle handle, const glm::vec3& angles); // degrees
+	void setScale(Handle handle, const glm::vec3& scale);
+
+	const glm::vec3& getPosition(Handle handle) const { return mPositions[mIndices[handle]]; }
+	const glm::vec3& getAngles(Handle handle) const { return mAngles[mIndices[handle]]; }
+	const glm::vec3& getScale(Handle handle) const { return mScales[mIndices[handle]]; }
+
+	// Up to date even between updates, a pending edit costs one walk up the parent chain
+	const glm::mat4& getWorldMatrix(Handle handle);
+
+	// Rebuild every world matrix below an edit, parents first
+	void update();
+
+	const TransformStats& getStats() const { return mStats; }
+
+private:
+	void markDirty(uint32_t index);
+	void buildLocalMatrix(uint32_t index);
+	void resolve(uint32_t index);
+
+	// Stable sort by depth, restores parent before child after a reparent
+	void reorder();
+
+private:
+	// Per node, indexed by position in the parent before child order
+	std::vector<glm::vec3> mPositions{};
+	std::vector<glm::vec3> mAngles{};
+	std::vector<glm::vec3> mScales{};
+	std::vector<int32_t> mParents{};
+	std::vector<glm::mat4> mLocalMatrices{};
+	std::vector<glm::mat4> mWorldMatrices{};
+	std::vector<uint8_t> mLocalDirty{};
+	std::vector<uint8_t> mWorldDirty{};
+	std::vector<uint8_t> mChanged{};	// scratch of update(), world rebuilt this pass
+	std::vector<Handle> mHandles{};		// index to handle
+
+	// Per handle
+	std::vector<uint32_t> mIndices{};	// handle to index
+	std::vector<Handle> mFreeHandles{};
+
+	unsigned int mPendingEdits{ 0 };
+	bool mOrderDirty{ false };
+
+	TransformStats mStats{};
+};
@@ -0,0 +1,204 @@
+#include "vertexLayout.h"
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+// Largest magnitudes kept in half floats
+static const float HalfPositionLimit = 2.0f;
+static const float HalfUvLimit = 1.0f;
+
+uint32_t VertexLayout::getUvOffset() const {
+
+	return mPosition == PositionFormat::Half4 ? 8 : 12;
+}
+
+uint32_t VertexLayout::getNormalOffset() const {
+
+	return getUvOffset() + (mUv == UvFormat::Half2 ? 4 : 8);
+}
+
+uint32_t VertexLayout::getColorOffset() const {
+
+	return getNormalOffset() + 4;
+}
+
+uint32_t VertexLayout::getStride() const {
+
+	return getColorOffset() + (mColor == ColorFormat::Unorm8 ? 4 : 0);
+}
+
+VertexLayout VertexLayout::choose(const VertexStreams& streams) {
+
+	float maxPosition = 0.0f;
+	for (size_t i = 0; i < (size_t)streams.mVertexCount * streams.mPositionComponents; i++) {
+		maxPosition = glm::max(maxPosition, glm::abs(streams.mPositions[i]));
+	}
+
+	float maxUv = 0.0f;
+	if (streams.mUvs != nullptr) {
+		for (size_t i = 0; i < (size_t)streams.mVertexCount * 2; i++) {
+			maxUv = glm::max(maxUv, glm::abs(streams.mUvs[i]));
+		}
+	}
+
+	VertexLayout layout;
+	layout.mPosition = maxPosition <= HalfPositionLimit ? PositionFormat::Half4 : PositionFormat::Float3;
+	layout.mUv = maxUv <= HalfUvLimit ? UvFormat::Half2 : UvFormat::Float2;
+	layout.mColor = streams.mColors != nullptr ? ColorFormat::Unorm8 : ColorFormat::None;
+
+	return layout;
+}
+
+glm::vec2 VertexLayout::encodeOctahedral(const glm::vec3& normal) {
+
+	float sum = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+	if (sum <= 0.0f) {
+		return glm::vec2(0.0f);
+	}
+
+	glm::vec2 p = glm::vec2(normal.x, normal.y) / sum;
+
+	// Lower hemisphere folds over the diagonals
+	if (normal.z < 0.0f) {
+		glm::vec2 sign{ p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f };
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+	}
+
+	return p;
+}
+
+glm::vec3 VertexLayout::decodeOctahedral(const glm::vec2& octahedral) {
+
+	glm::vec3 n{ octahedral.x, octahedral.y, 1.0f - glm::abs(octahedral.x) - glm::abs(octahedral.y) };
+	float t = glm::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	return glm::normalize(n);
+}
+
+void VertexLayout::pack(const VertexStreams& streams, uint8_t* out) const {
+
+	uint32_t stride = getStride();
+	uint32_t uvOffset = getUvOffset();
+	uint32_t normalOffset = getNormalOffset();
+	uint32_t colorOffset = getColorOffset();
+
+	for (uint32_t i = 0; i < streams.mVertexCount; i++) {
+
+		uint8_t* vertex = out + (size_t)i * stride;
+
+		// 1 Position
+		glm::vec3 position{ 0.0f };
+		for (int c = 0; c < streams.mPositionComponents; c++) {
+			position[c] = streams.mPositions[(size_t)i * streams.mPositionComponents + c];
+		}
+
+		if (mPosition == PositionFormat::Half4) {
+			uint16_t half[4] = { glm::packHalf1x16(position.x), glm::packHalf1x16(position.y), glm::packHalf1x16(position.z), 0 };
+			std::memcpy(vertex, half, sizeof(half));
+		}
+		else {
+			std::memcpy(vertex, &position, sizeof(float) * 3);
+		}
+
+		// 2 Uv
+		glm::vec2 uv{ 0.0f };
+		if (streams.mUvs != nullptr) {
+			uv = glm::vec2(streams.mUvs[(size_t)i * 2], streams.mUvs[(size_t)i * 2 + 1]);
+		}
+
+		if (mUv == UvFormat::Half2) {
+			uint32_t half = glm::packHalf2x16(uv);
+			std::memcpy(vertex + uvOffset, &half, sizeof(half));
+		}
+		else {
+			std::memcpy(vertex + uvOffset, &uv, sizeof(float) * 2);
+		}
+
+		// 3 Normal, 2x snorm16 of the octahedral coordinates
+		glm::vec3 normal{ 0.0f, 0.0f, 1.0f };
+		if (streams.mNormals != nullptr) {
+			normal = glm::vec3(streams.mNormals[(size_t)i * 3], streams.mNormals[(size_t)i * 3 + 1], streams.mNormals[(size_t)i * 3 + 2]);
+		}
+
+		uint32_t octahedral = glm::packSnorm2x16(encodeOctahedral(normal));
+		std::memcpy(vertex + normalOffset, &octahedral, sizeof(octahedral));
+
+		// 4 Color
+		if (mColor == ColorFormat::Unorm8) {
+			glm::vec4 color{ streams.mColors[(size_t)i * 3], streams.mColors[(size_t)i * 3 + 1], streams.mColors[(size_t)i * 3 + 2], 1.0f };
+			uint32_t packed = glm::packUnorm4x8(color);
+			std::memcpy(vertex + colorOffset, &packed, sizeof(packed));
+		}
+	}
+}
+
+void VertexLayout::apply() const {
+
+	GLsizei stride = (GLsizei)getStride();
+
+	glEnableVertexAttribArray(0);
+	if (mPosition == PositionFormat::Half4) {
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)0);
+	}
+	else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	}
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, mUv == UvFormat::Half2 ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)(size_t)getUvOffset());
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, (void*)(size_t)getNormalOffset());
+
+	if (mColor == ColorFormat::Unorm8) {
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 3, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)getColorOffset());
+	}
+	else {
+		glDisableVertexAttribArray(3);
+	}
+}
+
+uint32_t VertexLayout::encode() const {
+
+	return (uint32_t)mPosition | ((uint32_t)mUv << 8) | ((uint32_t)mColor << 16);
+}
+
+bool VertexLayout::decode(uint32_t value, VertexLayout& layout) {
+
+	uint32_t position = value & 0xFF;
+	uint32_t uv = (value >> 8) & 0xFF;
+	uint32_t color = (value >> 16) & 0xFF;
+	if (position > 1 || uv > 1 || color > 1 || (value >> 24) != 0) {
+		return false;
+	}
+
+	layout.mPosition = (PositionFormat)position;
+	layout.mUv = (UvFormat)uv;
+	layout.mColor = (ColorFormat)color;
+	return true;
+}
+
+GLenum IndexLayout::choose(uint32_t vertexCount) {
+
+	return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+uint32_t IndexLayout::getSize(GLenum type) {
+
+	return type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+void IndexLayout::pack(const uint32_t* indices, uint32_t count, GLenum type, uint8_t* out) {
+
+	if (type == GL_UNSIGNED_INT) {
+		std::memcpy(out, indices, (size_t)count * sizeof(uint32_t));
+		return;
+	}
+
+	uint16_t* shorts = reinterpret_cast<uint16_t*>(out);
+	for (uint32_t i = 0; i < count; i++) {
+		shorts[i] = (uint16_t)indices[i];
+	}
+}
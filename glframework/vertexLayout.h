@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core.h"
+#include <cstdint>
+
+enum class PositionFormat : uint8_t {
+	Float3 = 0,
+	Half4 = 1		// w is padding, keeps the next attribute 4 byte aligned
+};
+
+enum class UvFormat : uint8_t {
+	Float2 = 0,
+	Half2 = 1
+};
+
+enum class ColorFormat : uint8_t {
+	None = 0,
+	Unorm8 = 1		// rgb plus padding alpha
+};
+
+// Float attributes of a vertex range as loaders and factories build them
+struct VertexStreams {
+	const float* mPositions{ nullptr };
+	int mPositionComponents{ 3 };		// 2 for screen space quads, z is 0
+	const float* mNormals{ nullptr };	// 3 per vertex, optional
+	const float* mUvs{ nullptr };		// 2 per vertex, optional
+	const float* mColors{ nullptr };	// 3 per vertex, optional
+	uint32_t mVertexCount{ 0 };
+};
+
+// One interleaved vertex: position, uv, octahedral normal (2x snorm16), color.
+// Locations stay 0 position, 1 uv, 2 normal, 3 color, instance data starts at 4
+struct VertexLayout {
+	PositionFormat mPosition{ PositionFormat::Float3 };
+	UvFormat mUv{ UvFormat::Float2 };
+	ColorFormat mColor{ ColorFormat::None };
+
+	uint32_t getStride() const;
+	uint32_t getUvOffset() const;
+	uint32_t getNormalOffset() const;
+	uint32_t getColorOffset() const;
+
+	// Half precision only where its rounding stays under 1 mm and a quarter texel at 1024
+	static VertexLayout choose(const VertexStreams& streams);
+
+	// Writes streams.mVertexCount * getStride() bytes
+	void pack(const VertexStreams& streams, uint8_t* out) const;
+
+	// Attribute pointers of the bound VAO, reading the bound GL_ARRAY_BUFFER
+	void apply() const;
+
+	// Compact form stored by the mesh cache
+	uint32_t encode() const;
+	static bool decode(uint32_t value, VertexLayout& layout);
+
+	// Unit vector to the octahedron, folded into [-1, 1]^2
+	static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+	static glm::vec3 decodeOctahedral(const glm::vec2& octahedral);
+};
+
+// 16 bit indices whenever every vertex can be addressed with them
+class IndexLayout {
+public:
+
+	static GLenum choose(uint32_t vertexCount);
+	static uint32_t getSize(GLenum type);
+	static void pack(const uint32_t* indices, uint32_t count, GLenum type, uint8_t* out);
+};
@@ -1,11 +1,21 @@
 #include <iostream>
 #include "glframework/core.h"
 #include "glframework/shader.h"
+#include "glframework/glStateCache.h"
+#include "glframework/tools/allocationCounter.h"
 #include <string>
 #include <assert.h>
 #include "wrapper/checkError.h"
 #include "application/Application.h"
 #include "glframework/texture.h"
+#include "glframework/textureLoader.h"
+#include "glframework/textureArray.h"
+#include "glframework/bindlessTextures.h"
+#include "glframework/tools/textureCache.h"
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <random>
 
 #include "application/camera/perspectiveCamera.h"
 #include "application/camera/orthographicCamera.h"
@@ -23,10 +33,12 @@
 #include "glframework/material/phongEnvMaterial.h"
 #include "glframework/material/phongInstanceMaterial.h"
 #include "glframework/material/grassInstanceMaterial.h"
+#include "glframework/material/proceduralGrassMaterial.h"
 
 #include "glframework/mesh/mesh.h"
 #include "glframework/mesh/instancedMesh.h"
 #include "glframework/renderer/renderer.h"
+#include "glframework/grass/grassFieldBuilder.h"
 #include "glframework/light/pointLight.h"
 #include "glframework/light/spotLight.h"
 #include "glframework/light/directionalLight.h"
@@ -38,6 +50,7 @@
 #include "glframework/scene.h"
 #include "application/assimpLoader.h"
 #include "application/assimpInstanceLoader.h"
+#include "application/benchmark/benchmark.h"
 
 #include "glframework/framebuffer/framebuffer.h"
 
@@ -50,6 +63,52 @@ int WIDTH = 2560;
 int HEIGHT = 1440;
 
 GrassInstanceMaterial* grassMaterial = nullptr;
+Object* grassModel = nullptr;
+
+bool proceduralGrass = false;
+bool gpuCulling = true;
+bool verifyCulling = false;
+bool chunkCulling = true;
+bool occlusionCulling = false;
+bool grassLod = true;
+float lodDistances[3] = { 10.0f, 30.0f, 120.0f };
+
+// Triangle ratios of the LODs simplified at import, part of the mesh cache key
+std::vector<float> grassLodRatios = { 0.4f };
+std::vector<float> houseLodRatios = { 0.5f, 0.25f };
+bool persistentMapping = false;
+bool compactInstances = false;
+
+// Heap allocations inside the last Renderer::render, 0 once the frame is warm
+size_t renderAllocations = 0;
+
+// grassRendering --cull-check compares one GPU cull pass against the CPU reference and exits
+bool cullCheck = false;
+
+// Frames the render queue, pool and tables need to reach their steady capacity
+const unsigned int allocationWarmupFrames = 120;
+unsigned int allocatingFrames = 0;
+
+// grassRendering --allocation-check renders this many frames, then fails if a warm frame allocated
+const unsigned int allocationCheckFrames = 600;
+bool allocationCheck = false;
+
+// Startup, ms since main() was entered
+std::chrono::high_resolution_clock::time_point startupBegin{};
+float firstFrameTime = 0.0f;
+float texturesReadyTime = 0.0f;
+float textureUploadBudget = 4.0f; // MB per frame
+
+// Shared by the world mapped grass textures
+Sampler* grassSampler = nullptr;
+float grassArrayBuildTime = 0.0f; // ms
+int grassFilter = (int)TextureFilter::Trilinear;
+float grassAnisotropy = 8.0f;
+
+// GPU time of the scene pass, read one frame late so the query never stalls
+GLuint frameQueries[2] = { 0, 0 };
+unsigned int frameIndex = 0;
+float gpuFrameTime = 0.0f; // ms
 
 DirectionalLight* dirLight = nullptr;
 AmbientLight* ambLight = nullptr;
@@ -89,70 +148,215 @@ void OnScroll(double offset) {
 
 void setModelBlend(Object* obj, bool blend, float opacity) {
 
-    if (obj->getType() == ObjectType::Mesh) {
+    obj->forEachDescendant<Mesh>(ObjectType::Mesh, [&](Mesh* mesh) {
 
-        Mesh* mesh = (Mesh*)obj;
         Material* mat = mesh->mMaterial;
         mat->mBlend = blend;
         mat->mOpacity = opacity;
         mat->mDepthWrite = false;
-    }
+    });
+}
 
-    auto children = obj->getChildren();
+void setInstancePersistentMapping(Object* obj, bool enable) {
 
-    for (int i = 0; i < children.size(); i++) {
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
 
-        setModelBlend(children[i], blend, opacity);
-    }
+        im->setPersistentMapping(enable);
+    });
+}
 
+void setInstanceFormat(Object* obj, InstanceFormat format) {
+
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
+
+        im->setInstanceFormat(format);
+    });
 }
 
-void setInstanceMatrix(Object* obj, int index, glm::mat4 matrix) {
+void setInstanceMaterial(Object* obj, Material* material) {
 
-    if (obj->getType() == ObjectType::InstancedMesh) {
+    obj->forEachDescendant([&](Object* node) {
 
-        InstancedMesh* im = (InstancedMesh*)obj;
-        im->mInstanceMatrices[index] = matrix;
+        // Procedural grass draws plain meshes
+        if (node->getType() == ObjectType::InstancedMesh || node->getType() == ObjectType::Mesh) {
 
-    }
+            Mesh* mesh = (Mesh*)node;
+            mesh->mMaterial = material;
+        }
+    });
+}
 
-    auto children = obj->getChildren();
-    for (int i = 0; i < children.size(); i++) {
+void setInstanceCulling(Object* obj, bool enable) {
 
-        setInstanceMatrix(children[i], index, matrix);
-    }
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
+
+        im->setGpuCulling(enable);
+    });
+}
+
+void setInstanceChunking(Object* obj, bool enable) {
+
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
+
+        im->setChunkCulling(enable);
+    });
 }
 
-void updateInstanceMatrix(Object* obj) {
+// Full blade, simplified blade (crossed quad pair without one) and single card
+void setInstanceLods(Object* obj, bool enable) {
 
-    if (obj->getType() == ObjectType::InstancedMesh) {
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
 
-        InstancedMesh* im = (InstancedMesh*)obj;
-        im->updateMatrices();
+        if (enable && im->mLods.empty()) {
 
-    }
+            glm::vec3 boundsMin = im->mGeometry->getBoundingMin();
+            glm::vec3 boundsMax = im->mGeometry->getBoundingMax();
 
-    auto children = obj->getChildren();
-    for (int i = 0; i < children.size(); i++) {
+            Geometry* middle = im->mGeometryLods.empty() ?
+                Geometry::createGrassCards(boundsMin, boundsMax, 2) : im->mGeometryLods[0].mGeometry;
 
-        updateInstanceMatrix(children[i]);
-    }
+            im->setLods(
+                { im->mGeometry, middle, Geometry::createGrassCards(boundsMin, boundsMax, 1) },
+                { lodDistances[0], lodDistances[1], lodDistances[2] });
+        }
+        im->setLodDistances({ lodDistances[0], lodDistances[1], lodDistances[2] });
+        im->setLodEnabled(enable);
+    });
 }
 
-void setInstanceMaterial(Object* obj, Material* material) {
+void collectLodStats(Object* obj, unsigned int instances[3], unsigned int& vertices) {
+
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
+
+        if (im->getLodEnabled() && !im->getGpuCulling()) {
+
+            for (size_t i = 0; i < im->mLods.size() && i < 3; i++) {
+
+                instances[i] += im->mLods[i].mInstanceCount;
+                vertices += im->mLods[i].mInstanceCount * im->mLods[i].mGeometry->getIndicesCount();
+            }
+        }
+    });
+}
 
-    if (obj->getType() == ObjectType::InstancedMesh) {
+void collectChunkStats(Object* obj, GrassCullStats& total) {
 
-        InstancedMesh* im = (InstancedMesh*)obj;
-        im->mMaterial = material;
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
 
+        if (im->getChunkCulling() && !im->getGpuCulling()) {
+
+            const GrassCullStats& stats = im->getGrassField()->getStats();
+            total.mVisibleChunks += stats.mVisibleChunks;
+            total.mDrawnInstances += stats.mDrawnInstances;
+            total.mCulledInstances += stats.mCulledInstances;
+            total.mOccludedChunks += stats.mOccludedChunks;
+            total.mOccludedInstances += stats.mOccludedInstances;
+            total.mCullTime += stats.mCullTime;
+        }
+    });
+}
+
+// Compare the GPU written instance count against the CPU reference
+void verifyInstanceCulling(Object* obj, unsigned int& gpuCount, unsigned int& cpuCount) {
+
+    obj->forEachDescendant<InstancedMesh>(ObjectType::InstancedMesh, [&](InstancedMesh* im) {
+
+        if (im->getGpuCulling()) {
+
+            std::vector<glm::mat4> visible;
+            gpuCount += InstanceCuller::readVisibleCount(im);
+            cpuCount += InstanceCuller::cullCPU(
+                im,
+                renderer->getFrustum(),
+                grassMaterial->mWindScale,
+                visible,
+                renderer->getOcclusionCulling() ? &renderer->getDepthPyramid() : nullptr,
+                renderer->getViewProjectionMatrix());
+        }
+    });
+}
+
+// Cull a fixed field from a fixed camera on the GPU, read the indirect count and the compacted
+// matrices back and compare them against InstanceCuller::cullCPU. Needs a current context
+bool checkInstanceCulling() {
+
+    // 1 Field, 200 x 200 jittered instances, yawed and scaled like the grass
+    const int rows = 200;
+    const int columns = 200;
+    const float spacing = 0.25f;
+
+    auto geometry = Geometry::createBox(0.2f);
+    auto material = new PhongInstanceMaterial();
+    auto mesh = new InstancedMesh(geometry, material, rows * columns);
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+
+            glm::vec3 position(
+                (c - columns * 0.5f + unit(random)) * spacing,
+                0.0f,
+                (r - rows * 0.5f + unit(random)) * spacing);
+            glm::mat4 matrix = glm::translate(glm::mat4(1.0f), position);
+            matrix = glm::rotate(matrix, unit(random) * glm::two_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f));
+            matrix = glm::scale(matrix, glm::vec3(0.5f + unit(random)));
+
+            mesh->setInstanceMatrix(r * columns + c, matrix);
+        }
+    }
+    mesh->updateMatrices();
+    mesh->setGpuCulling(true);
+
+    // 2 Camera inside the field looking across it, the frustum cuts through the instances
+    glm::mat4 view = glm::lookAt(glm::vec3(-5.0f, 1.5f, 8.0f), glm::vec3(4.0f, 0.0f, -6.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 20.0f);
+    Frustum frustum;
+    frustum.setFromMatrix(projection * view);
+    const float boundsMargin = 0.05f;
+
+    // 3 GPU pass, count and compacted matrices back
+    InstanceCuller culler;
+    culler.cull(mesh, frustum, boundsMargin);
+
+    unsigned int gpuCount = InstanceCuller::readVisibleCount(mesh);
+    std::vector<glm::mat4> gpuMatrices(std::min(gpuCount, mesh->mInstanceCount));
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh->mCulledMatrixVbo);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::mat4) * gpuMatrices.size(), gpuMatrices.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 4 CPU reference, the compute pass appends in any order so both sides are sorted
+    std::vector<glm::mat4> cpuMatrices;
+    unsigned int cpuCount = InstanceCuller::cullCPU(mesh, frustum, boundsMargin, cpuMatrices);
+
+    auto less = [](const glm::mat4& a, const glm::mat4& b) {
+        return std::memcmp(&a, &b, sizeof(glm::mat4)) < 0;
+    };
+    std::sort(gpuMatrices.begin(), gpuMatrices.end(), less);
+    std::sort(cpuMatrices.begin(), cpuMatrices.end(), less);
+
+    unsigned int mismatches = 0;
+    if (gpuCount == cpuCount) {
+        for (size_t i = 0; i < cpuMatrices.size(); i++) {
+            if (std::memcmp(&gpuMatrices[i], &cpuMatrices[i], sizeof(glm::mat4)) != 0) {
+                mismatches++;
+            }
+        }
     }
 
-    auto children = obj->getChildren();
-    for (int i = 0; i < children.size(); i++) {
+    std::cout << "Instance culling: " << gpuCount << " GPU, " << cpuCount << " CPU of " << mesh->mInstanceCount
+        << ", " << mismatches << " mismatching matrices" << std::endl;
 
-        setInstanceMaterial(children[i], material);
+    bool passed = gpuCount == cpuCount && mismatches == 0 && cpuCount > 0 && cpuCount < mesh->mInstanceCount;
+    if (!passed) {
+        std::cout << "Error: GPU instance culling differs from cullCPU" << std::endl;
     }
+
+    delete mesh;
+    delete material;
+    delete geometry;
+    return passed;
 }
 
 void prepare() {
@@ -163,7 +367,7 @@ void prepare() {
     // 1 Cubemap
     auto sphereGeo = Geometry::createSphere(1.0f);
     auto sphereMat = new CubeMaterial();
-    sphereMat->mDiffuse = new Texture("assets/textures/bk.jpg", 0);
+    sphereMat->mDiffuse = Texture::createTexture("assets/textures/bk.jpg", 0);
     auto sphereMesh = new Mesh(sphereGeo, sphereMat);
     scene->addChild(sphereMesh);
 
@@ -171,43 +375,53 @@ void prepare() {
     int rNum = 300;
     int cNum = 300;
 
-    auto grassModel = AssimpInstanceLoader::load("assets/fbx/grassNew.obj", rNum * cNum);
-
-    glm::mat4 translate;
-    glm::mat4 rotate;
-    glm::mat4 transform;
-
+    if (proceduralGrass) {
 
-    srand(glfwGetTime());
-    for (int r = 0; r < rNum; r++) {
+        // 2.1 Blades placed in the vertex shader, no instance buffer
+        auto proceduralMaterial = new ProceduralGrassMaterial();
+        proceduralMaterial->mRows = rNum;
+        proceduralMaterial->mColumns = cNum;
+        proceduralMaterial->mSpacing = 0.2f;
+        grassMaterial = proceduralMaterial;
 
-        for (int c = 0; c < cNum; c++) {
-            
-            // 1 translate
-            translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.2f * r, 0.0f, 0.2f * c));
-
-            // 2 rotate
-            rotate = glm::rotate(glm::radians((float)(rand() % 90)), glm::vec3(0.0, 1.0, 0.0));
+        grassModel = AssimpLoader::load("assets/fbx/grassNew.obj", grassLodRatios);
+    }
+    else {
 
-            transform = translate * rotate;
+        grassModel = AssimpInstanceLoader::load("assets/fbx/grassNew.obj", rNum * cNum, grassLodRatios);
 
-            setInstanceMatrix(grassModel, r * cNum + c, transform);
+        // 2.2 Same seed gives the same field as the procedural path
+        GrassFieldBuilder builder(rNum, cNum, 0.2f, 0);
+        builder.build(grassModel);
 
-        }
+        grassMaterial = new GrassInstanceMaterial();
     }
-    updateInstanceMatrix(grassModel);
 
-    grassMaterial = new GrassInstanceMaterial();
-    grassMaterial->mDiffuse = new Texture("assets/textures/GRASS.png", 0);
-    grassMaterial->mOpacityMask = new Texture("assets/textures/grassMask.png", 1);
-    grassMaterial->mCloudMask = new Texture("assets/textures/CLOUD.png", 2);
+    // 2.3 Diffuse in a BC7 array, both masks in a BC4 array that keeps the opacity zeros exact.
+    // Diffuse and clouds are mapped by world XZ and minified hard at grazing angles,
+    // the shader reads the opacity mask at level 0
+    grassSampler = new Sampler((TextureFilter)grassFilter, grassAnisotropy);
+    TextureArray grassArray(MipmapMode::Kaiser, TextureFormat::Bc7);
+    grassMaterial->mDiffuseLayer = grassArray.add("assets/textures/GRASS.png");
+    grassMaterial->mTextures = grassArray.build(0);
+    grassMaterial->mTextures->setSampler(grassSampler);
+
+    TextureArray maskArray(MipmapMode::Kaiser, GrassInstanceMaterial::MaskFormat);
+    grassMaterial->mOpacityLayer = maskArray.add("assets/textures/grassMask.png");
+    grassMaterial->mCloudLayer = maskArray.add("assets/textures/CLOUD.png");
+    grassMaterial->mMasks = maskArray.build(1);
+    grassMaterial->mMasks->setSampler(grassSampler);
+    grassArrayBuildTime = grassArray.getBuildTime() + maskArray.getBuildTime();
     //grassMaterial->mBlend = true;
     //grassMaterial->mDepthWrite = false;
     setInstanceMaterial(grassModel, grassMaterial);
+    setInstanceCulling(grassModel, gpuCulling);
+    setInstanceChunking(grassModel, chunkCulling);
+    setInstanceLods(grassModel, grassLod);
     scene->addChild(grassModel);
     
     // 3 House
-    auto house = AssimpLoader::load("assets/fbx/house.fbx");
+    auto house = AssimpLoader::load("assets/fbx/house.fbx", houseLodRatios);
     house->setScale(glm::vec3(0.5f));
     house->setPosition(glm::vec3(rNum * 0.2f / 2.0f, 0.4, cNum * 0.2f / 2.0f));
     scene->addChild(house);
@@ -278,6 +492,161 @@ void renderIMGUI() {
     ImGui::Text("Light");
     ImGui::InputFloat("Intensity", &dirLight->mIntensity);
 
+    // 2.5 Procedural placement
+    if (proceduralGrass) {
+
+        ProceduralGrassMaterial* proceduralMaterial = (ProceduralGrassMaterial*)grassMaterial;
+        ImGui::Text("Procedural");
+        ImGui::InputScalar("Seed", ImGuiDataType_U32, &proceduralMaterial->mSeed);
+        ImGui::SliderFloat("Spacing", &proceduralMaterial->mSpacing, 0.05f, 1.0f);
+        ImGui::SliderFloat("MaxYaw", &proceduralMaterial->mMaxYaw, 0.0f, 360.0f);
+        ImGui::Text("Blades: %u", proceduralMaterial->getInstanceCount());
+    }
+
+    // 2.6 Culling
+    ImGui::Text("Culling");
+    if (ImGui::Checkbox("GPUCulling", &gpuCulling)) {
+        setInstanceCulling(grassModel, gpuCulling);
+    }
+    ImGui::Checkbox("VerifyCulling", &verifyCulling);
+    if (gpuCulling && verifyCulling) {
+
+        unsigned int gpuCount = 0, cpuCount = 0;
+        verifyInstanceCulling(grassModel, gpuCount, cpuCount);
+        ImGui::Text("Visible GPU: %u CPU: %u", gpuCount, cpuCount);
+    }
+    if (ImGui::Checkbox("ChunkCulling", &chunkCulling)) {
+        setInstanceChunking(grassModel, chunkCulling);
+    }
+    if (chunkCulling && !gpuCulling) {
+
+        GrassCullStats stats;
+        collectChunkStats(grassModel, stats);
+        ImGui::Text("Chunks: %u Drawn: %u Culled: %u", stats.mVisibleChunks, stats.mDrawnInstances, stats.mCulledInstances);
+        ImGui::Text("Chunk cull: %.3f ms", stats.mCullTime);
+        if (occlusionCulling) {
+            ImGui::Text("Occluded chunks: %u Instances: %u", stats.mOccludedChunks, stats.mOccludedInstances);
+        }
+    }
+
+    // 2.6.1 Occlusion, the pooled static meshes hide what is behind them
+    if (ImGui::Checkbox("OcclusionCulling", &occlusionCulling)) {
+        renderer->setOcclusionCulling(occlusionCulling);
+    }
+    if (occlusionCulling) {
+
+        const DepthPyramidStats& pyramid = renderer->getDepthPyramid().getStats();
+        ImGui::Text("Occluded meshes: %u GPU instances: %u", renderer->getOccludedMeshes(), renderer->getHiZCuller()->getOccludedInstances());
+        ImGui::Text("Occluder tris: %u Raster: %.3f ms Build: %.3f ms", pyramid.mTriangles, pyramid.mRasterTime, pyramid.mBuildTime);
+    }
+
+    // 2.7 LOD
+    ImGui::Text("LOD");
+    bool lodChanged = ImGui::Checkbox("GrassLOD", &grassLod);
+    lodChanged |= ImGui::SliderFloat3("LODDistances", lodDistances, 0.0f, 300.0f);
+    if (lodChanged) {
+        setInstanceLods(grassModel, grassLod);
+    }
+    if (grassLod && !gpuCulling) {
+
+        unsigned int instances[3] = { 0, 0, 0 };
+        unsigned int vertices = 0;
+        collectLodStats(grassModel, instances, vertices);
+        ImGui::Text("LOD0: %u LOD1: %u LOD2: %u", instances[0], instances[1], instances[2]);
+        ImGui::Text("Vertices: %u", vertices);
+    }
+
+    // 2.8 Instance upload
+    ImGui::Text("Upload");
+    if (ImGui::Checkbox("PersistentMapping", &persistentMapping)) {
+        setInstancePersistentMapping(grassModel, persistentMapping);
+    }
+    if (ImGui::Checkbox("CompactInstances", &compactInstances)) {
+        setInstanceFormat(grassModel, compactInstances ? InstanceFormat::Compact : InstanceFormat::Matrix);
+    }
+    ImGui::Text("Instance stride: %u B", compactInstances ? (unsigned int)sizeof(CompactInstance) : (unsigned int)sizeof(glm::mat4));
+    ImGui::Text("Instance upload: %.1f KB/frame", InstancedMesh::getUploadBytes() / 1024.0f);
+
+    // 2.9 Uniforms
+    const UniformStats& uniformStats = Shader::getUniformStats();
+    ImGui::Text("Uniforms by name: %u by handle: %u", uniformStats.mHashedLookups, uniformStats.mHandleSets);
+    ImGui::Text("glGetUniformLocation: %u", uniformStats.mDriverLookups);
+
+    // 2.10 GL state
+    const GLStateStats& stateStats = GLStateCache::getStats();
+    ImGui::Text("GL state calls issued: %u skipped: %u", stateStats.mIssuedCalls, stateStats.mSkippedCalls);
+
+    // 2.11 Render queue
+    const RenderQueueStats& queueStats = renderer->getRenderQueueStats();
+    ImGui::Text("Draws opaque: %u ordered: %u transparent: %u", queueStats.mOpaqueDraws, queueStats.mOrderedDraws, queueStats.mTransparentDraws);
+    ImGui::Text("Program switches: %u texture switches: %u", queueStats.mProgramSwitches, queueStats.mTextureSwitches);
+    ImGui::Text("Queue sort: %.3f ms", queueStats.mSortTime);
+    const MeshPoolStats& poolStats = renderer->getMeshPoolStats();
+    ImGui::Text("Pooled meshes: %u in %u multi draws, %u arenas", poolStats.mDraws, poolStats.mBatches, poolStats.mArenas);
+    ImGui::Text("Pool buffers: %.1f KB vertices %.1f KB indices, built in %.2f ms", poolStats.mVertexBytes / 1024.0f,
+        poolStats.mIndexBytes / 1024.0f, poolStats.mBuildTime);
+
+    // 2.12 Transforms
+    const TransformStats& transformStats = TransformSystem::getDefault().getStats();
+    ImGui::Text("Transforms updated: %u / %u in %.3f ms", transformStats.mUpdatedNodes, transformStats.mNodeCount, transformStats.mUpdateTime);
+    ImGui::Text("Heap allocations in render: %zu, warm frames allocating: %u", renderAllocations, allocatingFrames);
+
+    // 2.13 Startup
+    ImGui::Text("Model loads");
+    for (const auto& report : MeshCache::getReports()) {
+        ImGui::Text("%s: %s %.1f ms (import %.1f ms)", report.mPath.c_str(),
+            report.mCacheHit ? "cached" : "imported", report.mLoadTime, report.mImportTime);
+        ImGui::Text("  ACMR %.2f -> %.2f ATVR %.2f -> %.2f", report.mSourceCache.mAcmr, report.mOptimizedCache.mAcmr,
+            report.mSourceCache.mAtvr, report.mOptimizedCache.mAtvr);
+
+        // Distance where the error shrinks below one pixel, in model units at scale 1
+        for (const auto& lod : report.mLods) {
+            float pixelDistance = lod.mError * HEIGHT / (2.0f * tanf(glm::radians(60.0f) * 0.5f));
+            ImGui::Text("  LOD %.0f%%: %u / %u tris error %.4f, 1 px at %.1f", lod.mRatio * 100.0f,
+                lod.mTriangles, report.mTriangles, lod.mError, pixelDistance);
+        }
+    }
+
+    // 2.14 Texture streaming
+    const TextureLoaderStats& textureStats = TextureLoader::getDefault().getStats();
+    ImGui::Text("First frame: %.1f ms, textures ready: %.1f ms", firstFrameTime, texturesReadyTime);
+    ImGui::Text("Textures pending: %u loaded: %u decode: %.1f ms", textureStats.mPending, textureStats.mCompleted, textureStats.mDecodeTime);
+    ImGui::Text("Texture upload: %.1f KB/frame", textureStats.mUploadedBytes / 1024.0f);
+    ImGui::Text("Texture memory: %.2f MB (RGBA8 %.2f MB) encode: %.1f ms cached: %u", textureStats.mGpuBytes / 1048576.0f,
+        textureStats.mRgbaBytes / 1048576.0f, textureStats.mEncodeTime, textureStats.mCacheHits);
+    ImGui::Text("Grass texture arrays: %d + %d mask layers, built in %.1f ms",
+        grassMaterial->mTextures->getLayers(), grassMaterial->mMasks->getLayers(), grassArrayBuildTime);
+    if (ImGui::SliderFloat("UploadBudgetMB", &textureUploadBudget, 0.25f, 64.0f)) {
+        TextureLoader::getDefault().setUploadBudget((size_t)(textureUploadBudget * 1024.0f * 1024.0f));
+    }
+    if (renderer->isBindless()) {
+        const TextureTableStats& tableStats = renderer->getTextureTableStats();
+        ImGui::Text("Bindless: %u draw entries (%.1f KB), %u resident handles", tableStats.mEntries,
+            tableStats.mUploadBytes / 1024.0f, BindlessTextures::getResidentCount());
+    }
+    else {
+        ImGui::Text("Bindless: unsupported, textures bound per draw");
+    }
+
+    // 2.15 Texture filtering
+    ImGui::Text("Texture filtering");
+    const char* filters[] = { "Nearest", "Bilinear", "Trilinear" };
+    if (ImGui::Combo("GrassFilter", &grassFilter, filters, 3)) {
+        grassSampler->setFilter((TextureFilter)grassFilter);
+    }
+    if (ImGui::SliderFloat("Anisotropy", &grassAnisotropy, 1.0f, Sampler::getMaxAnisotropy())) {
+        grassSampler->setAnisotropy(grassAnisotropy);
+    }
+    ImGui::Text("GPU scene: %.2f ms, mip levels: %d", gpuFrameTime, grassMaterial->mTextures->getLevels());
+    if (ImGui::Button("GrazingView")) {
+
+        // Eye height over the field edge, looking across it 4 degrees down
+        float pitch = glm::radians(4.0f);
+        camera->mPosition = glm::vec3(30.0f, 1.0f, 62.0f);
+        camera->mRight = glm::vec3(1.0f, 0.0f, 0.0f);
+        camera->mUp = glm::vec3(0.0f, cosf(pitch), -sinf(pitch));
+    }
+
     ImGui::End();
 
     // 3 Render
@@ -288,13 +657,47 @@ void renderIMGUI() {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
-int main() {
+int main(int argc, char** argv) {
+
+    // 0 Headless benchmarks: grassRendering --benchmark <name>
+    if (argc > 2 && std::string(argv[1]) == "--benchmark") {
+        return Benchmark::run(argv[2]) ? 0 : -1;
+    }
+
+    // Offline transcoder: grassRendering --transcode <image> <bc1|bc3|bc4|bc7> [kaiser|box|none]
+    // writes <image>.texcache, the chain has to match the MipmapMode the texture is created with
+    if (argc > 3 && std::string(argv[1]) == "--transcode") {
+        TextureFormat format;
+        if (!BlockCompressor::parseFormat(argv[3], format)) {
+            std::cout << "Error: Unknown texture format " << argv[3] << std::endl;
+            return -1;
+        }
+        std::string mipmaps = argc > 4 ? argv[4] : "kaiser";
+        MipmapFilter filter = mipmaps == "box" ? MipmapFilter::Box : MipmapFilter::Kaiser;
+        return TextureCache::transcode(argv[2], format, mipmaps != "none", filter) ? 0 : -1;
+    }
+
+    startupBegin = std::chrono::high_resolution_clock::now();
+
+    // grassRendering --procedural places the blades in the vertex shader
+    for (int i = 1; i < argc; i++) {
+        proceduralGrass |= std::string(argv[i]) == "--procedural";
+        allocationCheck |= std::string(argv[i]) == "--allocation-check";
+        cullCheck |= std::string(argv[i]) == "--cull-check";
+    }
 
     // 1 Initial the window
     if (!glApp->init(WIDTH, HEIGHT)) {
         return -1;
     }
 
+    // 1.1 grassRendering --cull-check, GPU against CPU culling without opening the scene
+    if (cullCheck) {
+        bool passed = checkInstanceCulling();
+        glApp->destroy();
+        return passed ? 0 : -1;
+    }
+
     // 2 Size and keyboard callback
     glApp->setResizeCallback(OnResize);
     glApp->setKeyBoardCallback(OnKey);
@@ -310,19 +713,65 @@ int main() {
     prepare();
     initIMGUI();
 
+    glGenQueries(2, frameQueries);
+
     // 4 Set window loop
     while (glApp->update()) {
 
         cameraControl->update();
         renderer->setClearColor(clearColor);
 
+        // Decoded textures reach the GPU a budget per frame
+        TextureLoader::getDefault().update();
+
         // Pass 1
+        size_t allocations = AllocationCounter::getCount();
+        glBeginQuery(GL_TIME_ELAPSED, frameQueries[frameIndex & 1]);
         renderer->render(scene, camera, dirLight, ambLight);
+        glEndQuery(GL_TIME_ELAPSED);
+        renderAllocations = AllocationCounter::getCount() - allocations;
+
+        // A warm frame has to stay off the heap
+        if (frameIndex >= allocationWarmupFrames && renderAllocations != 0) {
+
+            if (allocatingFrames == 0) {
+                std::cout << "Error: Renderer::render allocated " << renderAllocations << " times in frame " << frameIndex << std::endl;
+            }
+            allocatingFrames++;
+        }
+
+        if (frameIndex > 0) {
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(frameQueries[(frameIndex - 1) & 1], GL_QUERY_RESULT, &elapsed);
+            gpuFrameTime = elapsed / 1000000.0f;
+        }
+        frameIndex++;
 
         renderIMGUI();
+
+        float sinceStart = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startupBegin).count();
+        if (firstFrameTime == 0.0f) {
+            firstFrameTime = sinceStart;
+            std::cout << "First frame after " << firstFrameTime << " ms" << std::endl;
+        }
+        if (texturesReadyTime == 0.0f && TextureLoader::getDefault().getStats().mPending == 0) {
+            texturesReadyTime = sinceStart;
+            std::cout << "Textures ready after " << texturesReadyTime << " ms" << std::endl;
+        }
+
+        if (allocationCheck && frameIndex >= allocationCheckFrames) {
+            break;
+        }
     }
 
     glApp->destroy();
 
+    if (allocationCheck) {
+        unsigned int warmFrames = frameIndex > allocationWarmupFrames ? frameIndex - allocationWarmupFrames : 0;
+        std::cout << "Warm frames allocating in render: " << allocatingFrames << " of " << warmFrames << std::endl;
+        return allocatingFrames == 0 ? 0 : -1;
+    }
+
     return 0;
 }
\ No newline at end of file